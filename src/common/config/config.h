@@ -187,6 +187,10 @@ enum ConfigKey
 	KEY_PARALLEL_WORKERS,
 	KEY_MAX_PARALLEL_WORKERS,
 	KEY_OPTIMIZE_FOR_FIRST_ROWS,
+	KEY_SORT_RUN_COMPRESSION,
+	KEY_GROUP_COMMIT_WAIT,
+	KEY_REDO_LOG_SIZE,
+	KEY_SEQUENCE_CACHE_SIZE,
 	MAX_CONFIG_KEY		// keep it last
 };
 
@@ -300,7 +304,11 @@ constexpr ConfigEntry entries[MAX_CONFIG_KEY] =
 	{TYPE_INTEGER,	"MaxStatementCacheSize",	false,	2 * 1048576},	// bytes
 	{TYPE_INTEGER,	"ParallelWorkers",			true,	1},
 	{TYPE_INTEGER,	"MaxParallelWorkers",		true,	1},
-	{TYPE_BOOLEAN,	"OptimizeForFirstRows",		false,	false}
+	{TYPE_BOOLEAN,	"OptimizeForFirstRows",		false,	false},
+	{TYPE_BOOLEAN,	"SortRunCompression",		false,	true},
+	{TYPE_INTEGER,	"GroupCommitWait",			false,	0},			// milliseconds
+	{TYPE_INTEGER,	"RedoLogSize",				false,	0},			// bytes
+	{TYPE_INTEGER,	"SequenceCacheSize",		false,	0}			// values
 };
 
 
@@ -624,6 +632,14 @@ public:
 	CONFIG_GET_GLOBAL_INT(getMaxParallelWorkers, KEY_MAX_PARALLEL_WORKERS);
 
 	CONFIG_GET_PER_DB_BOOL(getOptimizeForFirstRows, KEY_OPTIMIZE_FOR_FIRST_ROWS);
+
+	CONFIG_GET_PER_DB_BOOL(getSortRunCompression, KEY_SORT_RUN_COMPRESSION);
+
+	CONFIG_GET_PER_DB_INT(getGroupCommitWait, KEY_GROUP_COMMIT_WAIT);
+
+	CONFIG_GET_PER_DB_INT(getRedoLogSize, KEY_REDO_LOG_SIZE);
+
+	CONFIG_GET_PER_DB_INT(getSequenceCacheSize, KEY_SEQUENCE_CACHE_SIZE);
 };
 
 // Implementation of interface to access master configuration file
@@ -435,6 +435,23 @@ bool AggNode::aggPass(thread_db* tdbb, Request* request) const
 	return true;
 }
 
+// Remove the value of the current row from the aggregation.
+bool AggNode::aggUnpass(thread_db* tdbb, Request* request) const
+{
+	fb_assert(!distinct);
+
+	dsc* desc = NULL;
+
+	if (arg)
+	{
+		desc = EVL_expr(tdbb, request, arg);
+		if (request->req_flags & req_null)
+			return true;
+	}
+
+	return aggUnpass(tdbb, request, desc);
+}
+
 void AggNode::aggFinish(thread_db* /*tdbb*/, Request* request) const
 {
 	if (asb)
@@ -806,6 +823,22 @@ void AvgAggNode::aggPass(thread_db* tdbb, Request* request, dsc* desc) const
 		ArithmeticNode::add2(tdbb, desc, impure, this, blr_add);
 }
 
+bool AvgAggNode::aggUnpass(thread_db* tdbb, Request* request, dsc* desc) const
+{
+	if (nodFlags & (FLAG_DOUBLE | FLAG_DECFLOAT))
+		return false;
+
+	impure_value_ex* impure = request->getImpure<impure_value_ex>(impureOffset);
+	--impure->vlux_count;
+
+	if (dialect1)
+		ArithmeticNode::add(tdbb, desc, impure, this, blr_subtract);
+	else
+		ArithmeticNode::add2(tdbb, desc, impure, this, blr_subtract);
+
+	return true;
+}
+
 dsc* AvgAggNode::aggExecute(thread_db* tdbb, Request* request) const
 {
 	impure_value_ex* impure = request->getImpure<impure_value_ex>(impureOffset);
@@ -1104,6 +1137,18 @@ void CountAggNode::aggPass(thread_db* /*tdbb*/, Request* request, dsc* /*desc*/)
 		++impure->vlu_misc.vlu_int64;
 }
 
+bool CountAggNode::aggUnpass(thread_db* /*tdbb*/, Request* request, dsc* /*desc*/) const
+{
+	impure_value_ex* impure = request->getImpure<impure_value_ex>(impureOffset);
+
+	if (dialect1)
+		--impure->vlu_misc.vlu_long;
+	else
+		--impure->vlu_misc.vlu_int64;
+
+	return true;
+}
+
 dsc* CountAggNode::aggExecute(thread_db* /*tdbb*/, Request* request) const
 {
 	impure_value_ex* impure = request->getImpure<impure_value_ex>(impureOffset);
@@ -1366,6 +1411,22 @@ void SumAggNode::aggPass(thread_db* tdbb, Request* request, dsc* desc) const
 		ArithmeticNode::add2(tdbb, desc, impure, this, blr_add);
 }
 
+bool SumAggNode::aggUnpass(thread_db* tdbb, Request* request, dsc* desc) const
+{
+	if (nodFlags & (FLAG_DOUBLE | FLAG_DECFLOAT))
+		return false;
+
+	impure_value_ex* impure = request->getImpure<impure_value_ex>(impureOffset);
+	--impure->vlux_count;
+
+	if (dialect1)
+		ArithmeticNode::add(tdbb, desc, impure, this, blr_subtract);
+	else
+		ArithmeticNode::add2(tdbb, desc, impure, this, blr_subtract);
+
+	return true;
+}
+
 dsc* SumAggNode::aggExecute(thread_db* /*tdbb*/, Request* request) const
 {
 	impure_value_ex* impure = request->getImpure<impure_value_ex>(impureOffset);
@@ -1456,6 +1517,23 @@ void MaxMinAggNode::aggPass(thread_db* tdbb, Request* request, dsc* desc) const
 		EVL_make_value(tdbb, desc, impure);
 }
 
+bool MaxMinAggNode::aggUnpass(thread_db* tdbb, Request* request, dsc* desc) const
+{
+	impure_value_ex* impure = request->getImpure<impure_value_ex>(impureOffset);
+	fb_assert(impure->vlux_count > 0);
+
+	// Other rows may hold the same value, but we don't know that.
+	// So the extremum itself cannot be removed.
+
+	if (impure->vlux_count > 1 && MOV_compare(tdbb, desc, &impure->vlu_desc) == 0)
+		return false;
+
+	if (--impure->vlux_count == 0)
+		impure->vlu_desc.dsc_dtype = 0;
+
+	return true;
+}
+
 dsc* MaxMinAggNode::aggExecute(thread_db* /*tdbb*/, Request* request) const
 {
 	impure_value_ex* impure = request->getImpure<impure_value_ex>(impureOffset);
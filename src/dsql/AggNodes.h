@@ -71,7 +71,9 @@ public:
 
 	virtual unsigned getCapabilities() const
 	{
-		return CAP_RESPECTS_WINDOW_FRAME | CAP_WANTS_AGG_CALLS;
+		// Approximate sums cannot be reverted exactly
+		return CAP_RESPECTS_WINDOW_FRAME | CAP_WANTS_AGG_CALLS |
+			(distinct || (nodFlags & (FLAG_DOUBLE | FLAG_DECFLOAT)) ? 0 : CAP_SUPPORTS_AGG_UNPASS);
 	}
 
 	virtual Firebird::string internalPrint(NodePrinter& printer) const;
@@ -83,6 +85,7 @@ public:
 	virtual void aggInit(thread_db* tdbb, Request* request) const;
 	virtual void aggPass(thread_db* tdbb, Request* request, dsc* desc) const;
 	virtual dsc* aggExecute(thread_db* tdbb, Request* request) const;
+	virtual bool aggUnpass(thread_db* tdbb, Request* request, dsc* desc) const;
 
 protected:
 	virtual AggNode* dsqlCopy(DsqlCompilerScratch* dsqlScratch) /*const*/;
@@ -138,7 +141,8 @@ public:
 
 	virtual unsigned getCapabilities() const
 	{
-		return CAP_RESPECTS_WINDOW_FRAME | CAP_WANTS_AGG_CALLS;
+		return CAP_RESPECTS_WINDOW_FRAME | CAP_WANTS_AGG_CALLS |
+			(distinct ? 0 : CAP_SUPPORTS_AGG_UNPASS);
 	}
 
 	virtual Firebird::string internalPrint(NodePrinter& printer) const;
@@ -150,6 +154,7 @@ public:
 	virtual void aggInit(thread_db* tdbb, Request* request) const;
 	virtual void aggPass(thread_db* tdbb, Request* request, dsc* desc) const;
 	virtual dsc* aggExecute(thread_db* tdbb, Request* request) const;
+	virtual bool aggUnpass(thread_db* tdbb, Request* request, dsc* desc) const;
 
 protected:
 	virtual AggNode* dsqlCopy(DsqlCompilerScratch* dsqlScratch) /*const*/;
@@ -169,7 +174,9 @@ public:
 
 	virtual unsigned getCapabilities() const
 	{
-		return CAP_RESPECTS_WINDOW_FRAME | CAP_WANTS_AGG_CALLS;
+		// Approximate sums cannot be reverted exactly
+		return CAP_RESPECTS_WINDOW_FRAME | CAP_WANTS_AGG_CALLS |
+			(distinct || (nodFlags & (FLAG_DOUBLE | FLAG_DECFLOAT)) ? 0 : CAP_SUPPORTS_AGG_UNPASS);
 	}
 
 	virtual Firebird::string internalPrint(NodePrinter& printer) const;
@@ -180,6 +187,7 @@ public:
 	virtual void aggInit(thread_db* tdbb, Request* request) const;
 	virtual void aggPass(thread_db* tdbb, Request* request, dsc* desc) const;
 	virtual dsc* aggExecute(thread_db* tdbb, Request* request) const;
+	virtual bool aggUnpass(thread_db* tdbb, Request* request, dsc* desc) const;
 
 protected:
 	virtual AggNode* dsqlCopy(DsqlCompilerScratch* dsqlScratch) /*const*/;
@@ -200,7 +208,7 @@ public:
 
 	virtual unsigned getCapabilities() const
 	{
-		return CAP_RESPECTS_WINDOW_FRAME | CAP_WANTS_AGG_CALLS;
+		return CAP_RESPECTS_WINDOW_FRAME | CAP_WANTS_AGG_CALLS | CAP_SUPPORTS_AGG_UNPASS;
 	}
 
 	virtual Firebird::string internalPrint(NodePrinter& printer) const;
@@ -211,6 +219,7 @@ public:
 	virtual void aggInit(thread_db* tdbb, Request* request) const;
 	virtual void aggPass(thread_db* tdbb, Request* request, dsc* desc) const;
 	virtual dsc* aggExecute(thread_db* tdbb, Request* request) const;
+	virtual bool aggUnpass(thread_db* tdbb, Request* request, dsc* desc) const;
 
 protected:
 	virtual AggNode* dsqlCopy(DsqlCompilerScratch* dsqlScratch) /*const*/;
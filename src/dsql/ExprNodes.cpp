@@ -617,7 +617,8 @@ ArithmeticNode::ArithmeticNode(MemoryPool& pool, UCHAR aBlrOp, bool aDialect1,
 	  arg1(aArg1),
 	  arg2(aArg2),
 	  blrOp(aBlrOp),
-	  dialect1(aDialect1)
+	  dialect1(aDialect1),
+	  program(pool)
 {
 	label = getCompatDialectVerb();
 	label.upper();
@@ -1984,6 +1985,187 @@ bool ArithmeticNode::sameAs(const ExprNode* other, bool ignoreStreams) const
 	return false;
 }
 
+namespace
+{
+	// Opcodes of the arithmetic code. Specialized ones handle the common native types
+	// and fall back to the generic ArithmeticNode::compute() for everything else.
+	enum ArithmeticOpcode : UCHAR
+	{
+		OP_LOAD,				// evaluate the leaf node
+		OP_COMPUTE,				// generic computation
+		OP_ADD_INT64,
+		OP_SUBTRACT_INT64,
+		OP_MULTIPLY_INT64,
+		OP_ADD_DOUBLE,
+		OP_SUBTRACT_DOUBLE,
+		OP_MULTIPLY_DOUBLE,
+		OP_DIVIDE_DOUBLE
+	};
+
+	const unsigned MAX_ARITHMETIC_PROGRAM = 1024;
+
+	UCHAR getOpcode(const ArithmeticNode* node)
+	{
+		if (node->dialect1 ||
+			(node->nodFlags & (ExprNode::FLAG_DATE | ExprNode::FLAG_DECFLOAT | ExprNode::FLAG_INT128)))
+		{
+			return OP_COMPUTE;
+		}
+
+		const bool isDouble = (node->nodFlags & ExprNode::FLAG_DOUBLE);
+
+		switch (node->blrOp)
+		{
+			case blr_add:
+				return isDouble ? OP_ADD_DOUBLE : OP_ADD_INT64;
+
+			case blr_subtract:
+				return isDouble ? OP_SUBTRACT_DOUBLE : OP_SUBTRACT_INT64;
+
+			case blr_multiply:
+				return isDouble ? OP_MULTIPLY_DOUBLE : OP_MULTIPLY_INT64;
+
+			case blr_divide:
+				return isDouble ? OP_DIVIDE_DOUBLE : OP_COMPUTE;
+		}
+
+		return OP_COMPUTE;
+	}
+
+	// Get the value of a native integer with the given scale
+	inline bool getInteger(const dsc* desc, SSHORT scale, SINT64& value)
+	{
+		if (desc->dsc_scale != scale)
+			return false;
+
+		switch (desc->dsc_dtype)
+		{
+			case dtype_short:
+				value = *(SSHORT*) desc->dsc_address;
+				return true;
+
+			case dtype_long:
+				value = *(SLONG*) desc->dsc_address;
+				return true;
+
+			case dtype_int64:
+				value = *(SINT64*) desc->dsc_address;
+				return true;
+		}
+
+		return false;
+	}
+
+	// Dialect 3 addition and subtraction of native integers, see ArithmeticNode::add2()
+	dsc* addInt64(const dsc* desc1, const dsc* desc2, impure_value* value,
+		SSHORT scale, bool subtract)
+	{
+		SINT64 i1, i2;
+
+		if (!getInteger(desc2, scale, i1) || !getInteger(desc1, scale, i2))
+			return NULL;
+
+		dsc* const result = &value->vlu_desc;
+		*result = *desc1;
+		result->dsc_dtype = dtype_int64;
+		result->dsc_length = sizeof(SINT64);
+		result->dsc_scale = scale;
+		result->dsc_sub_type = MAX(desc1->dsc_sub_type, desc2->dsc_sub_type);
+		result->dsc_address = (UCHAR*) &value->vlu_misc.vlu_int64;
+		value->vlu_misc.vlu_int64 = subtract ? i2 - i1 : i1 + i2;
+
+		if (subtract)
+			i1 ^= MIN_SINT64;		// invert the sign bit
+
+		if ((i1 ^ i2) >= 0 && (i1 ^ value->vlu_misc.vlu_int64) < 0)
+			ERR_post(Arg::Gds(isc_exception_integer_overflow));
+
+		return result;
+	}
+
+	// Dialect 3 multiplication of native integers, see ArithmeticNode::multiply2()
+	dsc* multiplyInt64(const dsc* desc1, const dsc* desc2, impure_value* value, SSHORT scale)
+	{
+		SINT64 i1, i2;
+
+		if (!getInteger(desc2, scale - desc1->dsc_scale, i1) ||
+			!getInteger(desc1, desc1->dsc_scale, i2))
+		{
+			return NULL;
+		}
+
+		const FB_UINT64 u1 = (i1 >= 0) ? i1 : -i1;	// abs(i1)
+		const FB_UINT64 u2 = (i2 >= 0) ? i2 : -i2;	// abs(i2)
+		// largest product
+		const FB_UINT64 u_limit = ((i1 ^ i2) >= 0) ? MAX_SINT64 : (FB_UINT64) MAX_SINT64 + 1;
+
+		if ((u1 != 0) && ((u_limit / u1) < u2))
+			ERR_post(Arg::Gds(isc_exception_integer_overflow));
+
+		dsc* const result = &value->vlu_desc;
+		*result = *desc1;
+		result->dsc_dtype = dtype_int64;
+		result->dsc_length = sizeof(SINT64);
+		result->dsc_scale = scale;
+		value->vlu_misc.vlu_int64 = i1 * i2;
+		result->dsc_address = (UCHAR*) &value->vlu_misc.vlu_int64;
+
+		return result;
+	}
+
+	// Dialect 3 arithmetic of doubles, see ArithmeticNode::add2(), multiply2() and divide2()
+	dsc* computeDouble(const dsc* desc1, const dsc* desc2, impure_value* value, UCHAR opcode)
+	{
+		if (desc1->dsc_dtype != dtype_double || desc2->dsc_dtype != dtype_double)
+			return NULL;
+
+		const double d1 = *(double*) desc1->dsc_address;
+		const double d2 = *(double*) desc2->dsc_address;
+
+		dsc* const result = &value->vlu_desc;
+		*result = *desc1;
+
+		switch (opcode)
+		{
+			case OP_ADD_DOUBLE:
+				value->vlu_misc.vlu_double = d1 + d2;
+				result->dsc_sub_type = 0;
+				break;
+
+			case OP_SUBTRACT_DOUBLE:
+				value->vlu_misc.vlu_double = d1 - d2;
+				result->dsc_sub_type = 0;
+				break;
+
+			case OP_MULTIPLY_DOUBLE:
+				value->vlu_misc.vlu_double = d1 * d2;
+				break;
+
+			case OP_DIVIDE_DOUBLE:
+				if (d2 == 0.0)
+				{
+					ERR_post(Arg::Gds(isc_arith_except) <<
+							 Arg::Gds(isc_exception_float_divide_by_zero));
+				}
+				value->vlu_misc.vlu_double = d1 / d2;
+				break;
+		}
+
+		if (std::isinf(value->vlu_misc.vlu_double))
+		{
+			ERR_post(Arg::Gds(isc_arith_except) <<
+					 Arg::Gds(isc_exception_float_overflow));
+		}
+
+		result->dsc_dtype = DEFAULT_DOUBLE;
+		result->dsc_length = sizeof(double);
+		result->dsc_scale = 0;
+		result->dsc_address = (UCHAR*) &value->vlu_misc.vlu_double;
+
+		return result;
+	}
+}
+
 ValueExprNode* ArithmeticNode::pass2(thread_db* tdbb, CompilerScratch* csb)
 {
 	ValueExprNode::pass2(tdbb, csb);
@@ -1992,11 +2174,110 @@ ValueExprNode* ArithmeticNode::pass2(thread_db* tdbb, CompilerScratch* csb)
 	getDesc(tdbb, csb, &desc);
 	impureOffset = csb->allocImpure<impure_value>();
 
+	// Lower the arithmetic tree into the register based code, so it can be executed
+	// without the recursive evaluation of every node. The enclosing arithmetic node,
+	// if any, takes this code over when it's lowered itself.
+
+	program.clear();
+	lower(this);
+	registersOffset = csb->allocImpure(alignof(dsc*), sizeof(dsc*) * program.getCount());
+
 	return this;
 }
 
+// Append the code evaluating the node into its own register and return that register.
+USHORT ArithmeticNode::lower(ValueExprNode* node)
+{
+	ArithmeticNode* const arithmeticNode = nodeAs<ArithmeticNode>(node);
+
+	Instruction instruction;
+	instruction.node = node;
+	instruction.arg1 = instruction.arg2 = 0;
+
+	if (arithmeticNode && program.getCount() < MAX_ARITHMETIC_PROGRAM)
+	{
+		instruction.arg1 = lower(arithmeticNode->arg1);
+		instruction.arg2 = lower(arithmeticNode->arg2);
+		instruction.opcode = getOpcode(arithmeticNode);
+
+		if (arithmeticNode != this)
+			arithmeticNode->program.free();
+	}
+	else
+		instruction.opcode = OP_LOAD;
+
+	instruction.result = (USHORT) program.getCount();
+	program.add(instruction);
+
+	return instruction.result;
+}
+
+// Execute the lowered arithmetic tree. Both arguments of every node are evaluated even
+// if one of them is NULL, like the recursive evaluation does.
+dsc* ArithmeticNode::executeProgram(thread_db* tdbb, Request* request) const
+{
+	const dsc** const registers = request->getImpure<const dsc*>(registersOffset);
+
+	for (const Instruction* instruction = program.begin(); instruction != program.end(); ++instruction)
+	{
+		if (instruction->opcode == OP_LOAD)
+		{
+			registers[instruction->result] = EVL_expr(tdbb, request, instruction->node);
+			continue;
+		}
+
+		const dsc* const desc1 = registers[instruction->arg1];
+		const dsc* const desc2 = registers[instruction->arg2];
+
+		if (!desc1 || !desc2)
+		{
+			registers[instruction->result] = NULL;
+			continue;
+		}
+
+		const ArithmeticNode* const node = static_cast<const ArithmeticNode*>(instruction->node);
+		impure_value* const impure = request->getImpure<impure_value>(node->impureOffset);
+		dsc* result = NULL;
+
+		switch (instruction->opcode)
+		{
+			case OP_ADD_INT64:
+			case OP_SUBTRACT_INT64:
+				result = addInt64(desc1, desc2, impure, node->nodScale,
+					instruction->opcode == OP_SUBTRACT_INT64);
+				break;
+
+			case OP_MULTIPLY_INT64:
+				result = multiplyInt64(desc1, desc2, impure, node->nodScale);
+				break;
+
+			case OP_ADD_DOUBLE:
+			case OP_SUBTRACT_DOUBLE:
+			case OP_MULTIPLY_DOUBLE:
+			case OP_DIVIDE_DOUBLE:
+				result = computeDouble(desc1, desc2, impure, instruction->opcode);
+				break;
+		}
+
+		registers[instruction->result] = result ? result :
+			node->compute(tdbb, desc1, desc2, impure);
+	}
+
+	dsc* const result = const_cast<dsc*>(registers[program.back().result]);
+
+	if (result)
+		request->req_flags &= ~req_null;
+	else
+		request->req_flags |= req_null;
+
+	return result;
+}
+
 dsc* ArithmeticNode::execute(thread_db* tdbb, Request* request) const
 {
+	if (program.hasData())
+		return executeProgram(tdbb, request);
+
 	impure_value* const impure = request->getImpure<impure_value>(impureOffset);
 
 	request->req_flags &= ~req_null;
@@ -2019,6 +2300,13 @@ dsc* ArithmeticNode::execute(thread_db* tdbb, Request* request) const
 	if (request->req_flags & req_null)
 		return NULL;
 
+	return compute(tdbb, desc1, desc2, impure);
+}
+
+// Compute the result of the operation on the evaluated arguments.
+dsc* ArithmeticNode::compute(thread_db* tdbb, const dsc* desc1, const dsc* desc2,
+	impure_value* impure) const
+{
 	EVL_make_value(tdbb, desc1, impure);
 
 	if (dialect1)	// dialect-1 semantics
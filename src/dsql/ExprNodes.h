@@ -102,6 +102,20 @@ public:
 		const UCHAR blrOp);
 
 private:
+	// Instruction of the register based code the arithmetic tree is lowered to.
+	// Every instruction puts its result into its own register.
+	struct Instruction
+	{
+		UCHAR opcode;
+		USHORT result;
+		USHORT arg1, arg2;
+		const ValueExprNode* node;	// leaf to evaluate or arithmetic node to compute
+	};
+
+	USHORT lower(ValueExprNode* node);
+	dsc* executeProgram(thread_db* tdbb, Request* request) const;
+	dsc* compute(thread_db* tdbb, const dsc* desc1, const dsc* desc2, impure_value* impure) const;
+
 	dsc* multiply(const dsc* desc, impure_value* value) const;
 	dsc* multiply2(const dsc* desc, impure_value* value) const;
 	dsc* divide2(const dsc* desc, impure_value* value) const;
@@ -123,6 +137,10 @@ public:
 	NestConst<ValueExprNode> arg2;
 	const UCHAR blrOp;
 	bool dialect1;
+
+private:
+	Firebird::Array<Instruction> program;
+	ULONG registersOffset = 0;
 };
 
 
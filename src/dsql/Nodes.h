@@ -922,6 +922,8 @@ public:
 	static const unsigned CAP_WANTS_AGG_CALLS		= 0x04;
 	// wants winPass call in a window
 	static const unsigned CAP_WANTS_WIN_PASS_CALL	= 0x08;
+	// may remove rows from the aggregation with aggUnpass calls
+	static const unsigned CAP_SUPPORTS_AGG_UNPASS	= 0x10;
 
 protected:
 	struct AggInfo
@@ -1074,12 +1076,19 @@ public:
 	virtual void aggInit(thread_db* tdbb, Request* request) const = 0;	// pure, but defined
 	virtual void aggFinish(thread_db* tdbb, Request* request) const;
 	virtual bool aggPass(thread_db* tdbb, Request* request) const;
+	bool aggUnpass(thread_db* tdbb, Request* request) const;
 	virtual dsc* execute(thread_db* tdbb, Request* request) const;
 
 	virtual unsigned getCapabilities() const = 0;
 	virtual void aggPass(thread_db* tdbb, Request* request, dsc* desc) const = 0;
 	virtual dsc* aggExecute(thread_db* tdbb, Request* request) const = 0;
 
+	// Returns false if the value cannot be removed and the aggregation should be restarted.
+	virtual bool aggUnpass(thread_db* /*tdbb*/, Request* /*request*/, dsc* /*desc*/) const
+	{
+		return false;
+	}
+
 	virtual AggNode* dsqlPass(DsqlCompilerScratch* dsqlScratch);
 
 protected:
@@ -695,6 +695,13 @@ namespace Jrd {
 					"Cannot crypt: please wait for nbackup completion").raise();
 			}
 
+			// Redo log keeps plain page images, it can't be used with encrypted database
+			if (dbb.dbb_redo_log)
+			{
+				(Arg::Gds(isc_wish_list) << Arg::Gds(isc_random) <<
+					"Cannot crypt: redo log is enabled, set RedoLogSize to 0").raise();
+			}
+
 			// Check header page for flags
 			if (hdr->hdr_flags & Ods::hdr_crypt_process)
 			{
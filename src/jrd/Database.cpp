@@ -38,6 +38,7 @@
 #include "../jrd/tpc_proto.h"
 #include "../jrd/lck_proto.h"
 #include "../jrd/CryptoManager.h"
+#include "../jrd/RedoLog.h"
 #include "../jrd/os/pio_proto.h"
 #include "../common/os/os_utils.h"
 //#include "../dsql/Parser.h"
@@ -172,6 +173,8 @@ namespace Jrd
 		delete dbb_tip_cache;
 		delete dbb_monitoring_data;
 		delete dbb_backup_manager;
+		delete dbb_redo_log;
+		delete dbb_local_locks;
 		delete dbb_crypto_manager;
 	}
 
@@ -92,6 +92,7 @@ class MonitoringData;
 class GarbageCollector;
 class CryptoManager;
 class KeywordsMap;
+class RedoLog;
 
 // general purpose vector
 template <class T, BlockType TYPE = type_vec>
@@ -524,6 +525,19 @@ public:
 
 	TipCache*		dbb_tip_cache;		// cache of latest known state of all transactions in system
 	BackupManager*	dbb_backup_manager;						// physical backup manager
+	RedoLog*		dbb_redo_log;							// log of pages changed by committed transactions
+	LocalLockTable*	dbb_local_locks;						// locks granted in process memory (SuperServer)
+
+	// Sequence values reserved on the generator pages, see DPM_gen_id()
+	struct CachedSequence
+	{
+		SINT64 current;		// last value handed out
+		SINT64 limit;		// value stored on the generator page
+	};
+
+	Firebird::Mutex dbb_seq_cache_mutex;
+	Firebird::NonPooledMap<SLONG, CachedSequence> dbb_seq_cache;
+
 	ISC_TIMESTAMP_TZ dbb_creation_date; 					// creation timestamp in GMT
 	ExternalFileDirectoryList* dbb_external_file_directory_list;
 	Firebird::RefPtr<const Firebird::Config> dbb_config;
@@ -617,6 +631,9 @@ private:
 		dbb_stats(*p),
 		dbb_lock_owner_id(getLockOwnerId()),
 		dbb_tip_cache(NULL),
+		dbb_redo_log(NULL),
+		dbb_local_locks(shared ? FB_NEW_POOL(*p) LocalLockTable : NULL),
+		dbb_seq_cache(*p),
 		dbb_creation_date(Firebird::TimeZoneUtil::getCurrentGmtTimeStamp()),
 		dbb_external_file_directory_list(NULL),
 		dbb_init_fini(FB_NEW_POOL(*getDefaultMemoryPool()) ExistenceRefMutex()),
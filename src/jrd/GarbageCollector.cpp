@@ -23,6 +23,7 @@
 #include "../common/classes/alloc.h"
 #include "../jrd/GarbageCollector.h"
 #include "../jrd/tra.h"
+#include <algorithm>
 
 using namespace Jrd;
 using namespace Firebird;
@@ -33,6 +34,7 @@ namespace Jrd {
 void GarbageCollector::RelationData::clear()
 {
 	m_pages.clear();
+	m_hits.setValue(0);
 }
 
 
@@ -48,6 +50,12 @@ TraNumber GarbageCollector::RelationData::findPage(const ULONG pageno, const Tra
 	if (pages.current().tranid > tranid)
 		pages.current().tranid = tranid;
 
+	// The same is true for the page hits, they are used as a hint only.
+	// Lost increments make m_hits drift from the pages, thus it's recounted
+	// by swept() and getPages() which run under exclusive sync.
+	pages.current().hits++;
+	++m_hits;
+
 	return pages.current().tranid;
 }
 
@@ -58,28 +66,81 @@ TraNumber GarbageCollector::RelationData::addPage(const ULONG pageno, const TraN
 		return findTran;
 
 	m_pages.add(PageTran(pageno, tranid));
+	++m_hits;
 	return tranid;
 }
 
 
-void GarbageCollector::RelationData::swept(const TraNumber oldest_snapshot, PageBitmap** bm)
+void GarbageCollector::RelationData::swept(const TraNumber oldest_snapshot)
 {
 	PageTranMap::Accessor pages(&m_pages);
+	IPTR hits = 0;
 
 	bool next = pages.getFirst();
 	while (next)
 	{
 		if (pages.current().tranid < oldest_snapshot)
-		{
-			if (bm)
-			{
-				PBM_SET(&m_pool, bm, pages.current().pageno);
-			}
 			next = pages.fastRemove();
-		}
 		else
+		{
+			hits += pages.current().hits;
 			next = pages.getNext();
+		}
+	}
+
+	m_hits.setValue(hits);
+}
+
+
+PageBitmap* GarbageCollector::RelationData::getPages(const TraNumber oldest_snapshot)
+{
+	// Collect the pages with garbage visible to nobody. If there are too many
+	// of them, return the most often hit ones and leave the rest for later.
+
+	HalfStaticArray<PageTran, MAX_BATCH_PAGES> candidates;
+
+	PageTranMap::Accessor pages(&m_pages);
+	IPTR hits = 0;
+
+	for (bool next = pages.getFirst(); next; next = pages.getNext())
+	{
+		hits += pages.current().hits;
+
+		if (pages.current().tranid < oldest_snapshot)
+			candidates.add(pages.current());
+	}
+
+	if (candidates.isEmpty())
+	{
+		m_hits.setValue(hits);
+		return NULL;
+	}
+
+	if (candidates.getCount() > MAX_BATCH_PAGES)
+	{
+		std::nth_element(candidates.begin(), candidates.begin() + MAX_BATCH_PAGES - 1,
+			candidates.end(),
+			[](const PageTran& a, const PageTran& b) { return a.hits > b.hits; });
+
+		candidates.shrink(MAX_BATCH_PAGES);
+	}
+
+	PageBitmap* bm = NULL;
+
+	for (const PageTran* item = candidates.begin(); item < candidates.end(); item++)
+	{
+		if (pages.locate(item->pageno))
+		{
+			hits -= pages.current().hits;
+			pages.fastRemove();
+		}
+
+		PBM_SET(&m_pool, &bm, item->pageno);
 	}
+
+	m_hits.setValue(hits);
+
+	return bm;
 }
 
 
@@ -123,36 +184,73 @@ TraNumber GarbageCollector::addPage(const USHORT relID, const ULONG pageno, cons
 
 PageBitmap* GarbageCollector::getPages(const TraNumber oldest_snapshot, USHORT &relID)
 {
+	// Relations are processed in order of their priority, i.e. the number of
+	// garbage notifications not handled yet. Relation passed over MAX_SKIPPED
+	// times in a row goes first, so the small ones are not starved by the hot
+	// ones. Note, m_skipped is changed here only, i.e. by the single garbage
+	// collector thread, thus shared sync is enough for it.
+
+	struct Candidate
+	{
+		RelationData* relData;
+		IPTR priority;
+		bool starving;
+	};
+
 	SyncLockGuard shGuard(&m_sync, SYNC_SHARED, "GarbageCollector::getPages");
 
-	if (m_relations.isEmpty())
+	HalfStaticArray<Candidate, 16> candidates;
+
+	for (FB_SIZE_T pos = 0; pos < m_relations.getCount(); pos++)
 	{
-		m_nextRelID = 0;
-		return NULL;
+		RelationData* const relData = m_relations[pos];
+		const IPTR priority = relData->getPriority();
+
+		if (priority > 0)
+		{
+			const Candidate candidate = {relData, priority, relData->m_skipped >= MAX_SKIPPED};
+			candidates.add(candidate);
+		}
 	}
 
-	FB_SIZE_T pos;
-	if (!m_relations.find(m_nextRelID, pos) && (pos == m_relations.getCount()))
-		pos = 0;
+	std::sort(candidates.begin(), candidates.end(),
+		[](const Candidate& a, const Candidate& b)
+		{
+			if (a.starving != b.starving)
+				return a.starving;
 
-	for (; pos < m_relations.getCount(); pos++)
+			return a.priority > b.priority;
+		});
+
+	PageBitmap* bm = NULL;
+	RelationData* found = NULL;
+
+	for (const Candidate* item = candidates.begin(); item < candidates.end(); item++)
 	{
-		RelationData* relData = m_relations[pos];
+		RelationData* const relData = item->relData;
 		SyncLockGuard syncData(&relData->m_sync, SYNC_EXCLUSIVE, "GarbageCollector::getPages");
 
-		PageBitmap* bm = NULL;
-		relData->swept(oldest_snapshot, &bm);
-
+		bm = relData->getPages(oldest_snapshot);
 		if (bm)
 		{
-			relID = relData->getRelID();
-			m_nextRelID = relID + 1;
-			return bm;
+			found = relData;
+			break;
 		}
 	}
 
-	m_nextRelID = 0;
-	return NULL;
+	if (!found)
+		return NULL;
+
+	for (const Candidate* item = candidates.begin(); item < candidates.end(); item++)
+	{
+		if (item->relData == found)
+			item->relData->m_skipped = 0;
+		else
+			item->relData->m_skipped++;
+	}
+
+	relID = found->getRelID();
+	return bm;
 }
 
 
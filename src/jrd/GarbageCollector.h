@@ -25,6 +25,7 @@
 
 #include "firebird.h"
 #include "../common/classes/array.h"
+#include "../common/classes/fb_atomic.h"
 #include "../common/classes/GenericMap.h"
 #include "../common/classes/SyncObject.h"
 #include "../jrd/sbm.h"
@@ -39,7 +40,7 @@ class GarbageCollector
 {
 public:
 	GarbageCollector(MemoryPool& p, Database* dbb)
-	  : m_pool(p), m_relations(m_pool), m_nextRelID(0)
+	  : m_pool(p), m_relations(m_pool)
 	{}
 
 	~GarbageCollector();
@@ -50,20 +51,31 @@ public:
 	void sweptRelation(const TraNumber oldest_snapshot, const USHORT relID);
 
 private:
+	// Max number of pages handed out by getPages() at once, so relations
+	// getting garbage faster are reconsidered often enough
+	static const ULONG MAX_BATCH_PAGES = 128;
+
+	// Number of times a relation with collectable garbage could be passed
+	// over in favor of the ones with more garbage
+	static const ULONG MAX_SKIPPED = 16;
+
 	struct PageTran
 	{
 		PageTran() :
 			pageno(0),
-			tranid(0)
+			tranid(0),
+			hits(0)
 		{}
 
 		PageTran(const ULONG _pageno, const TraNumber _tranid) :
 			pageno(_pageno),
-			tranid(_tranid)
+			tranid(_tranid),
+			hits(1)
 		{}
 
 		ULONG pageno;
 		TraNumber tranid;
+		ULONG hits;			// number of garbage notifications for the page
 
 		static const ULONG& generate(const void*, const PageTran& item)
 		{
@@ -77,7 +89,7 @@ private:
 	{
 	public:
 		explicit RelationData(MemoryPool& p, USHORT relID)
-			: m_pool(p), m_pages(p), m_relID(relID)
+			: m_pool(p), m_pages(p), m_relID(relID), m_skipped(0)
 		{}
 
 		~RelationData()
@@ -87,7 +99,14 @@ private:
 
 		TraNumber addPage(const ULONG pageno, const TraNumber tranid);
 		TraNumber findPage(const ULONG pageno, const TraNumber tranid);
-		void swept(const TraNumber oldest_snapshot, PageBitmap** bm = NULL);
+		void swept(const TraNumber oldest_snapshot);
+		PageBitmap* getPages(const TraNumber oldest_snapshot);
+
+		// Relations read often and getting garbage fast have more notifications
+		IPTR getPriority() const
+		{
+			return m_hits.value();
+		}
 
 		USHORT getRelID() const
 		{
@@ -105,6 +124,8 @@ private:
 		Firebird::SyncObject m_sync;
 		PageTranMap m_pages;
 		USHORT m_relID;
+		Firebird::AtomicCounter m_hits;		// notifications for the pages in the map
+		ULONG m_skipped;					// passed over by getPages() in a row
 	};
 
 	typedef	Firebird::SortedArray<
@@ -118,7 +139,6 @@ private:
 	Firebird::MemoryPool& m_pool;
 	Firebird::SyncObject m_sync;
 	RelGarbageArray m_relations;
-	USHORT m_nextRelID;
 };
 
 } // namespace Jrd
@@ -1857,12 +1857,43 @@ RecordSource* AggregateSourceNode::compile(thread_db* tdbb, Optimizer* opt, bool
 		rse->firstRows = true;
 	}
 
+	// Let the optimizer choose between sorting and hashing the groups,
+	// unless their order is expected by the parent or fixed by the plan
+
+	if (group && !ordered && !rse->rse_aggregate && !rse->rse_plan &&
+		HashAggregatedStream::isSupported(tdbb, csb, &group->expressions, map))
+	{
+		rse->flags |= RseNode::FLAG_HASH_GROUPING;
+	}
+	else
+		rse->flags &= ~RseNode::FLAG_HASH_GROUPING;
+
 	RecordSource* const nextRsb = opt->compile(rse, &deliverStack);
 
 	// allocate and optimize the record source block
 
-	AggregatedStream* const rsb = FB_NEW_POOL(*tdbb->getDefaultPool()) AggregatedStream(tdbb, csb,
-		stream, (group ? &group->expressions : NULL), map, nextRsb);
+	RecordSource* rsb;
+
+	if (rse->flags & RseNode::FLAG_HASH_GROUPING)
+	{
+		rsb = FB_NEW_POOL(*tdbb->getDefaultPool()) HashAggregatedStream(tdbb, csb,
+			stream, &group->expressions, map, nextRsb);
+	}
+	else
+	{
+		rsb = FB_NEW_POOL(*tdbb->getDefaultPool()) AggregatedStream(tdbb, csb,
+			stream, (group ? &group->expressions : NULL), map, nextRsb);
+	}
+
+	// Let the parallel workers aggregate the table if they can do it on their own.
+	// Their groups are returned unordered, the same way the hashed ones are.
+
+	if ((!group || (rse->flags & RseNode::FLAG_HASH_GROUPING)) && deliverStack.isEmpty() &&
+		ParallelAggregatedStream::isSupported(tdbb, csb, rse, group, map))
+	{
+		rsb = FB_NEW_POOL(*tdbb->getDefaultPool()) ParallelAggregatedStream(tdbb, csb,
+			stream, rse, group, map, rsb);
+	}
 
 	if (rse->rse_aggregate)
 	{
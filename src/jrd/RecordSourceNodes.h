@@ -532,7 +532,8 @@ public:
 		  group(NULL),
 		  map(NULL),
 		  rse(NULL),
-		  dsqlWindow(false)
+		  dsqlWindow(false),
+		  ordered(false)
 	{
 	}
 
@@ -582,6 +583,7 @@ private:
 
 public:
 	bool dsqlWindow;
+	bool ordered;	// the parent relies on the groups being returned in order
 };
 
 class UnionSourceNode final : public TypedNode<RecordSourceNode, RecordSourceNode::TYPE_UNION>
@@ -725,7 +727,8 @@ public:
 		FLAG_DSQL_COMPARATIVE	= 0x10,	// transformed from DSQL ComparativeBoolNode
 		FLAG_LATERAL			= 0x20,	// lateral derived table
 		FLAG_SKIP_LOCKED		= 0x40,	// skip locked
-		FLAG_SUB_QUERY			= 0x80	// sub-query
+		FLAG_SUB_QUERY			= 0x80,	// sub-query
+		FLAG_HASH_GROUPING		= 0x100	// grouping may be done via hashing, without a sort
 	};
 
 	bool isInvariant() const
@@ -0,0 +1,492 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.ibphoenix.com/main.nfs?a=ibphoenix&page=ibp_idpl.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created for the Firebird Open Source RDBMS project.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "firebird.h"
+#include "../common/os/os_utils.h"
+#include "../common/os/path_utils.h"
+#include "../jrd/jrd.h"
+#include "../jrd/ods.h"
+#include "../jrd/pag.h"
+#include "../jrd/sqz.h"
+#include "../jrd/RedoLog.h"
+#include "../jrd/cch_proto.h"
+#include "../jrd/os/pio_proto.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef WIN_NT
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY	0
+#endif
+
+using namespace Firebird;
+using namespace Jrd;
+using namespace Ods;
+
+namespace
+{
+	const ULONG REDO_FILE_MAGIC = 0x474F4C52;	// "RLOG"
+	const USHORT REDO_FILE_VERSION = 1;
+	const ULONG REDO_BATCH_MAGIC = 0x4F444552;	// "REDO"
+
+	const char* const REDO_FILE_SUFFIX = ".redo";
+	const char* const REDO_OLD_FILE_SUFFIX = ".redo.old";
+
+	class LogFile
+	{
+	public:
+		explicit LogFile(int handle)
+			: m_handle(handle)
+		{}
+
+		~LogFile()
+		{
+			if (m_handle >= 0)
+				::close(m_handle);
+		}
+
+		operator int() const
+		{
+			return m_handle;
+		}
+
+	private:
+		const int m_handle;
+	};
+
+	bool flushFile(int handle)
+	{
+#ifdef WIN_NT
+		return FlushFileBuffers((HANDLE) _get_osfhandle(handle)) != 0;
+#else
+		return fsync(handle) == 0;
+#endif
+	}
+
+	void raiseIOError(const char* syscall, const PathName& fileName, ISC_STATUS errcode)
+	{
+		(Arg::Gds(isc_io_error) << Arg::Str(syscall) << Arg::Str(fileName) <<
+			SYS_ERR(errcode)).raise();
+	}
+
+	void flushDirectory(const PathName& fileName)
+	{
+		// Make the directory entry of a created or renamed file durable,
+		// else the file could be missing after a crash. Windows keeps
+		// directory entries durable on its own.
+
+#ifndef WIN_NT
+		PathName dirName, name;
+		PathUtils::splitLastComponent(dirName, name, fileName);
+
+		if (dirName.isEmpty())
+			dirName = ".";
+
+		const LogFile dir(os_utils::open(dirName.c_str(), O_RDONLY));
+
+		if (dir < 0)
+			raiseIOError("open", dirName, ERRNO);
+
+		if (fsync(dir) != 0)
+			raiseIOError("fsync", dirName, ERRNO);
+#endif
+	}
+
+	ULONG checksum(const UCHAR* data, ULONG length)
+	{
+		// FNV-1a is enough to detect the torn tail of the log
+
+		ULONG hash = 2166136261U;
+
+		for (const UCHAR* const end = data + length; data < end; data++)
+			hash = (hash ^ *data) * 16777619U;
+
+		return hash;
+	}
+}
+
+
+// RedoLog::Batch class implementation
+
+void RedoLog::Batch::addPage(ULONG pageNum, const pag* page, ULONG pageSize)
+{
+	const UCHAR* const image = reinterpret_cast<const UCHAR*>(page);
+	const Compressor dcc(m_pool, true, true, pageSize, image);
+
+	PageHeader header;
+	header.ph_page = pageNum;
+	header.ph_length = (dcc.isPacked() && dcc.getPackedLength() < pageSize) ?
+		dcc.getPackedLength() : pageSize;
+
+	const FB_SIZE_T offset = m_data.getCount();
+	UCHAR* const ptr = m_data.getBuffer(offset + sizeof(header) + header.ph_length) + offset;
+	memcpy(ptr, &header, sizeof(header));
+
+	if (header.ph_length < pageSize)
+		dcc.pack(image, ptr + sizeof(header));
+	else
+		memcpy(ptr + sizeof(header), image, pageSize);
+
+	m_pages.add(pageNum);
+}
+
+
+// RedoLog class implementation
+
+RedoLog::RedoLog(MemoryPool& pool, Database* dbb)
+	: m_pool(pool),
+	  m_database(dbb),
+	  m_fileName(pool, getFileName(dbb, false)),
+	  m_oldFileName(pool, getFileName(dbb, true)),
+	  m_handle(-1),
+	  m_length(0),
+	  m_synced(0),
+	  m_threshold(dbb->dbb_config->getRedoLogSize()),
+	  m_switching(false),
+	  m_pages(FB_NEW_POOL(pool) PageBitmap(pool)),
+	  m_oldPages(NULL)
+{
+	openFile();
+}
+
+RedoLog::~RedoLog()
+{
+	if (m_handle != -1)
+		::close(m_handle);
+
+	delete m_pages;
+	delete m_oldPages;
+}
+
+PathName RedoLog::getFileName(const Database* dbb, bool old)
+{
+	return dbb->dbb_filename + (old ? REDO_OLD_FILE_SUFFIX : REDO_FILE_SUFFIX);
+}
+
+bool RedoLog::exists(const Database* dbb)
+{
+	return PathUtils::canAccess(getFileName(dbb, false), 0) ||
+		PathUtils::canAccess(getFileName(dbb, true), 0);
+}
+
+void RedoLog::makeHeader(const Database* dbb, FileHeader& header)
+{
+	memset(&header, 0, sizeof(header));
+
+	header.fh_magic = REDO_FILE_MAGIC;
+	header.fh_version = REDO_FILE_VERSION;
+	header.fh_page_size = dbb->dbb_page_size;
+
+	static_assert(sizeof(header.fh_guid) == Guid::SIZE, "Wrong size of GUID in redo log header");
+	if (dbb->dbb_guid.has_value())
+		memcpy(header.fh_guid, dbb->dbb_guid.value().getData(), Guid::SIZE);
+
+	header.fh_creation_date = dbb->dbb_creation_date.utc_timestamp;
+}
+
+void RedoLog::openFile()
+{
+	m_handle = os_utils::openCreateSharedFile(m_fileName.c_str(), O_TRUNC | O_BINARY);
+
+	// Header is synced together with the first batch
+
+	FileHeader header;
+	makeHeader(m_database, header);
+
+	if (::write(m_handle, &header, sizeof(header)) != sizeof(header))
+		raiseIOError("write", m_fileName, ERRNO);
+
+	m_length = sizeof(header);
+	m_synced = 0;
+
+	// The file is just created or the previous one is renamed,
+	// commits can't rely on it until its directory entry is on disk
+
+	flushDirectory(m_fileName);
+}
+
+void RedoLog::remove()
+{
+	MutexLockGuard guard(m_mutex, FB_FUNCTION);
+
+	if (m_handle != -1)
+	{
+		::close(m_handle);
+		m_handle = -1;
+	}
+
+	unlink(m_oldFileName.c_str());
+	unlink(m_fileName.c_str());
+
+	m_pages->clear();
+
+	delete m_oldPages;
+	m_oldPages = NULL;
+}
+
+bool RedoLog::isLogged(ULONG pageNum)
+{
+	MutexLockGuard guard(m_mutex, FB_FUNCTION);
+
+	return m_pages->test(pageNum) || (m_oldPages && m_oldPages->test(pageNum));
+}
+
+bool RedoLog::isOldPage(ULONG pageNum)
+{
+	MutexLockGuard guard(m_mutex, FB_FUNCTION);
+
+	return m_oldPages && m_oldPages->test(pageNum);
+}
+
+bool RedoLog::write(const Batch& batch)
+{
+/**************************************
+ *
+ * Append the batch of page images to the log and make sure that it is
+ * on disk together with everything appended before. Returns true if the
+ * caller should switch the log to a new file.
+ *
+ **************************************/
+	MutexLockGuard guard(m_mutex, FB_FUNCTION);
+
+	if (!batch.isEmpty())
+	{
+		BatchHeader header;
+		header.bh_magic = REDO_BATCH_MAGIC;
+		header.bh_pages = batch.m_pages.getCount();
+		header.bh_length = batch.m_data.getCount();
+		header.bh_checksum = checksum(batch.m_data.begin(), header.bh_length);
+
+		if (os_utils::lseek(m_handle, m_length, SEEK_SET) != (SINT64) m_length)
+			raiseIOError("lseek", m_fileName, ERRNO);
+
+		if (::write(m_handle, &header, sizeof(header)) != sizeof(header) ||
+			::write(m_handle, batch.m_data.begin(), header.bh_length) != (SINT64) header.bh_length)
+		{
+			raiseIOError("write", m_fileName, ERRNO);
+		}
+
+		m_length += sizeof(header) + header.bh_length;
+
+		for (const auto pageNum : batch.m_pages)
+			m_pages->set(pageNum);
+	}
+
+	if (m_synced < m_length)
+	{
+		// Commit is reported as durable only if the log is really on disk
+
+		if (!flushFile(m_handle))
+			raiseIOError("fsync", m_fileName, ERRNO);
+
+		m_synced = m_length;
+	}
+
+	if (m_switching || m_length < m_threshold)
+		return false;
+
+	m_switching = true;
+	return true;
+}
+
+void RedoLog::switchFile()
+{
+/**************************************
+ *
+ * Start appending to the new file. The current file becomes the old one and
+ * must be kept until the pages it contains are logged again into the new file.
+ * If the previous switch failed to complete, the old file is still there and
+ * the current file is kept as well.
+ *
+ **************************************/
+	MutexLockGuard guard(m_mutex, FB_FUNCTION);
+
+	if (m_oldPages)
+		return;
+
+	::close(m_handle);
+	m_handle = -1;
+
+	if (rename(m_fileName.c_str(), m_oldFileName.c_str()) != 0)
+	{
+		const ISC_STATUS errcode = ERRNO;
+		m_handle = os_utils::openCreateSharedFile(m_fileName.c_str(), O_BINARY);
+		m_switching = false;
+		raiseIOError("rename", m_fileName, errcode);
+	}
+
+	m_oldPages = m_pages;
+	m_pages = FB_NEW_POOL(m_pool) PageBitmap(m_pool);
+
+	openFile();
+}
+
+void RedoLog::removeOldFile()
+{
+	MutexLockGuard guard(m_mutex, FB_FUNCTION);
+
+	if (m_oldPages)
+	{
+		unlink(m_oldFileName.c_str());
+
+		delete m_oldPages;
+		m_oldPages = NULL;
+	}
+
+	// Don't switch again until the log grows well beyond
+	// the pages logged to release the old file
+
+	m_threshold = MAX((FB_UINT64) m_database->dbb_config->getRedoLogSize(), 2 * m_length);
+	m_switching = false;
+}
+
+void RedoLog::cancelSwitch()
+{
+	MutexLockGuard guard(m_mutex, FB_FUNCTION);
+
+	// The old file, if any, is kept and the switch will be retried later
+	m_switching = false;
+}
+
+void RedoLog::recover(thread_db* tdbb)
+{
+/**************************************
+ *
+ * Replay the log left by the previous run, if any, writing the last image
+ * of every logged page into the database. Then the log is removed.
+ *
+ **************************************/
+	SET_TDBB(tdbb);
+	Database* const dbb = tdbb->getDatabase();
+
+	const PathName oldFileName = getFileName(dbb, true);
+	const PathName fileName = getFileName(dbb, false);
+
+	const bool oldExists = PathUtils::canAccess(oldFileName, 0);
+	const bool exists = PathUtils::canAccess(fileName, 0);
+
+	if (!oldExists && !exists)
+		return;
+
+	if (oldExists)
+		replay(tdbb, oldFileName);
+
+	if (exists)
+		replay(tdbb, fileName);
+
+	const PageSpace* const pageSpace = dbb->dbb_page_manager.findPageSpace(DB_PAGE_SPACE);
+	PIO_flush(tdbb, pageSpace->file);
+
+	unlink(oldFileName.c_str());
+	unlink(fileName.c_str());
+}
+
+void RedoLog::replay(thread_db* tdbb, const PathName& fileName)
+{
+	Database* const dbb = tdbb->getDatabase();
+	const ULONG pageSize = dbb->dbb_page_size;
+
+	LogFile file(os_utils::open(fileName.c_str(), O_RDONLY | O_BINARY));
+
+	if (file < 0)
+		raiseIOError("open", fileName, ERRNO);
+
+	// Never replay the log written for another database
+
+	FileHeader expected, header;
+	makeHeader(dbb, expected);
+
+	if (::read(file, &header, sizeof(header)) != sizeof(header) ||
+		memcmp(&header, &expected, sizeof(header)) != 0)
+	{
+		gds__log("Database: %s\n\tredo log %s does not belong to the database, ignored",
+			dbb->dbb_filename.c_str(), fileName.c_str());
+		return;
+	}
+
+	UCharBuffer data;
+	ULONG batches = 0;
+
+	while (true)
+	{
+		// The tail of the log could be left incomplete by the crash,
+		// replay stops at the first batch not written entirely
+
+		BatchHeader header;
+		if (::read(file, &header, sizeof(header)) != sizeof(header) ||
+			header.bh_magic != REDO_BATCH_MAGIC)
+		{
+			break;
+		}
+
+		UCHAR* const buffer = data.getBuffer(header.bh_length);
+		if (::read(file, buffer, header.bh_length) != (SINT64) header.bh_length ||
+			checksum(buffer, header.bh_length) != header.bh_checksum)
+		{
+			break;
+		}
+
+		const UCHAR* ptr = buffer;
+		const UCHAR* const end = buffer + header.bh_length;
+
+		for (ULONG i = 0; i < header.bh_pages; i++)
+		{
+			PageHeader pageHeader;
+
+			if (end - ptr < (SINT64) sizeof(pageHeader))
+				BUGCHECK(179);	// msg 179 decompression overran buffer
+
+			memcpy(&pageHeader, ptr, sizeof(pageHeader));
+			ptr += sizeof(pageHeader);
+
+			if (pageHeader.ph_length > pageSize || end - ptr < (SINT64) pageHeader.ph_length)
+				BUGCHECK(179);	// msg 179 decompression overran buffer
+
+			WIN window(DB_PAGE_SPACE, pageHeader.ph_page);
+			UCHAR* const page = reinterpret_cast<UCHAR*>(CCH_fake(tdbb, &window, 1));
+
+			if (pageHeader.ph_length == pageSize)
+				memcpy(page, ptr, pageSize);
+			else if (Compressor::unpack(pageHeader.ph_length, ptr, pageSize, page) != page + pageSize)
+				BUGCHECK(179);	// msg 179 decompression overran buffer
+
+			CCH_MARK_MUST_WRITE(tdbb, &window);
+			CCH_RELEASE(tdbb, &window);
+
+			ptr += pageHeader.ph_length;
+		}
+
+		batches++;
+	}
+
+	if (batches)
+	{
+		gds__log("Database: %s\n\tredo log %s replayed, %" ULONGFORMAT " batch(es) applied",
+			dbb->dbb_filename.c_str(), fileName.c_str(), batches);
+	}
+}
@@ -0,0 +1,151 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.ibphoenix.com/main.nfs?a=ibphoenix&page=ibp_idpl.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created for the Firebird Open Source RDBMS project.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#ifndef JRD_REDO_LOG_H
+#define JRD_REDO_LOG_H
+
+#include "../common/classes/alloc.h"
+#include "../common/classes/array.h"
+#include "../common/classes/fb_string.h"
+#include "../common/classes/locks.h"
+#include "../jrd/sbm.h"
+
+// Redo log keeps the images of the pages changed by committed transactions.
+//
+// Commit appends the pages of the transaction to the log and syncs the log file
+// only, leaving the pages to be written into the database by the cache later.
+// To allow the log to be replayed blindly, every page that has an image in the
+// log gets its current image logged again before it is written into the database.
+// Thus the last image of a page in the log is never older than the database one.
+//
+// Log is switched to a new file when it grows too large. At that time the pages
+// of the old file still dirty in the cache are logged into the new file, after
+// that the old file is not needed anymore and removed.
+//
+// Every file starts with the header identifying the database, a log left
+// by another database (e.g. recreated under the same name) is never replayed.
+// The log is removed on clean shutdown, when all pages are written.
+// Page images are not encrypted, thus the log is not used for encrypted database.
+
+namespace Ods
+{
+	struct pag;
+}
+
+namespace Jrd
+{
+	class Database;
+	class thread_db;
+
+	class RedoLog
+	{
+		struct FileHeader
+		{
+			ULONG fh_magic;				// REDO_FILE_MAGIC
+			USHORT fh_version;			// REDO_FILE_VERSION
+			USHORT fh_page_size;		// database page size
+			UCHAR fh_guid[16];			// database GUID
+			ISC_TIMESTAMP fh_creation_date;		// database creation date
+		};
+
+		struct BatchHeader
+		{
+			ULONG bh_magic;			// REDO_BATCH_MAGIC
+			ULONG bh_pages;			// number of pages in the batch
+			ULONG bh_length;		// length of the batch data following the header
+			ULONG bh_checksum;		// checksum of the batch data
+		};
+
+		struct PageHeader
+		{
+			ULONG ph_page;			// page number
+			ULONG ph_length;		// length of the page image, page size if not packed
+		};
+
+	public:
+		class Batch
+		{
+			friend class RedoLog;
+
+		public:
+			explicit Batch(MemoryPool& pool)
+				: m_pool(pool), m_data(pool), m_pages(pool)
+			{}
+
+			void addPage(ULONG pageNum, const Ods::pag* page, ULONG pageSize);
+
+			bool isEmpty() const
+			{
+				return m_pages.isEmpty();
+			}
+
+		private:
+			MemoryPool& m_pool;
+			Firebird::UCharBuffer m_data;
+			Firebird::HalfStaticArray<ULONG, 64> m_pages;
+		};
+
+		RedoLog(MemoryPool& pool, Database* dbb);
+		~RedoLog();
+
+		static void recover(thread_db* tdbb);
+		static bool exists(const Database* dbb);
+
+		// Remove the log files after all pages are written into the database
+		void remove();
+
+		bool isLogged(ULONG pageNum);
+		bool write(const Batch& batch);
+
+		bool isSwitched() const
+		{
+			return m_oldPages != NULL;
+		}
+
+		bool isOldPage(ULONG pageNum);
+
+		void switchFile();
+		void removeOldFile();
+		void cancelSwitch();
+
+	private:
+		static Firebird::PathName getFileName(const Database* dbb, bool old);
+		static void makeHeader(const Database* dbb, FileHeader& header);
+		static void replay(thread_db* tdbb, const Firebird::PathName& fileName);
+
+		void openFile();
+
+		MemoryPool& m_pool;
+		Database* const m_database;
+		const Firebird::PathName m_fileName;
+		const Firebird::PathName m_oldFileName;
+
+		Firebird::Mutex m_mutex;
+		int m_handle;
+		FB_UINT64 m_length;			// bytes appended to the current file
+		FB_UINT64 m_synced;			// bytes known to be on disk
+		FB_UINT64 m_threshold;		// length to switch the file at
+		bool m_switching;			// file switch is in progress
+
+		PageBitmap* m_pages;		// pages having an image in the current file
+		PageBitmap* m_oldPages;		// pages having an image in the old file
+	};
+
+} // namespace Jrd
+
+#endif // JRD_REDO_LOG_H
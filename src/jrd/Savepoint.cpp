@@ -160,53 +160,66 @@ void VerbAction::mergeTo(thread_db* tdbb, jrd_tra* transaction, VerbAction* next
 
 	if (vct_undo && vct_undo->getFirst())
 	{
-		do
+		// Clean out undo data of the records touched by the next savepoint.
+		// Because going version for sure has all index entries successfully set up
+		// (in contrast with undo) we can use lightweigth version of garbage collection
+		// without collection of full staying list.
+
+		UndoItemTree::Accessor undo(vct_undo);
+
+		for (bool found = undo.getFirst(); found; )
 		{
-			UndoItem& item = vct_undo->current();
+			UndoItem& item = undo.current();
+			fb_assert(item.hasData());
 
-			if (item.hasData()) // this item wasn't released yet
+			const SINT64 recordNumber = item.generate(NULL, item);
+
+			if (nextAction && !(RecordBitmap::test(nextAction->vct_records, recordNumber)))
 			{
-				const SINT64 recordNumber = item.generate(NULL, item);
+				found = undo.getNext();
+				continue;
+			}
+
+			AutoTempRecord this_ver(item.setupRecord(transaction));
+
+			garbageCollectIdxLite(tdbb, transaction, recordNumber, nextAction, this_ver);
+
+			item.release(transaction);
+			found = undo.fastRemove();
+		}
 
-				if (nextAction && !(RecordBitmap::test(nextAction->vct_records, recordNumber)))
+		// The rest of undo data now belongs to the next action
+
+		if (nextAction && vct_undo->getFirst())
+		{
+			if (!nextAction->vct_undo || nextAction->vct_undo->isEmpty())
+			{
+				// Next action has no undo data, just hand over the whole tree
+				UndoItemTree* const temp = nextAction->vct_undo;
+				nextAction->vct_undo = vct_undo;
+				vct_undo = temp;
+			}
+			else
+			{
+				do
 				{
-					if (!nextAction->vct_undo)
+					UndoItem& item = vct_undo->current();
+
+					if (nextAction->vct_undo->locate(item.generate(NULL, item)))
 					{
-						nextAction->vct_undo =
-							FB_NEW_POOL(*transaction->tra_pool) UndoItemTree(*transaction->tra_pool);
-						// We cannot just push whole current undo items list, some items still may be released
+						// It looks like something went wrong on previous loop and undo record
+						// was moved to next action but record bit in bitmap wasn't set
+						fb_assert(false);
 					}
 					else
-					{
-						if (nextAction->vct_undo->locate(recordNumber))
-						{
-							// It looks like something went wrong on previous loop and undo record
-							// was moved to next action but record bit in bitmap wasn't set
-							fb_assert(false);
-							item.clear();
-							continue;
-						}
-					}
+						nextAction->vct_undo->add(item);
 
-					nextAction->vct_undo->add(item);
 					item.clear(); // Do not release undo data, it now belongs to next action
-					continue;
-				}
-
-				// garbage cleanup and release
-				// because going version for sure has all index entries successfully set up (in contrast with undo)
-				// we can use lightweigth version of garbage collection without collection of full staying list
-
-				AutoTempRecord this_ver(item.setupRecord(transaction));
-
-				garbageCollectIdxLite(tdbb, transaction, recordNumber, nextAction, this_ver);
+				} while (vct_undo->getNext());
 
-				item.release(transaction);
+				vct_undo->clear();
 			}
-		} while (vct_undo->getNext());
-
-		delete vct_undo;
-		vct_undo = NULL;
+		}
 	}
 
 	// Now merge bitmap
@@ -353,17 +366,15 @@ void VerbAction::release(jrd_tra* transaction)
 
 	RecordBitmap::reset(vct_records);
 
-	if (vct_undo)
+	// Keep the empty undo tree (as well as the bitmap) for the next use of the action
+
+	if (vct_undo && vct_undo->getFirst())
 	{
-		if (vct_undo->getFirst())
-		{
-			do {
-				vct_undo->current().release(transaction);
-			} while (vct_undo->getNext());
-		}
+		do {
+			vct_undo->current().release(transaction);
+		} while (vct_undo->getNext());
 
-		delete vct_undo;
-		vct_undo = NULL;
+		vct_undo->clear();
 	}
 }
 
@@ -519,6 +530,18 @@ Savepoint* Savepoint::rollforward(thread_db* tdbb, Savepoint* prior)
 					m_actions = action->vct_next;
 					action->vct_next = m_next->m_actions;
 					m_next->m_actions = action;
+
+					// Take a free action of the next savepoint in exchange. Otherwise
+					// a savepoint reused in a loop would allocate a new action every
+					// time, while the next one would collect them in its free list.
+
+					if (VerbAction* const spare = m_next->m_freeActions)
+					{
+						m_next->m_freeActions = spare->vct_next;
+						spare->vct_next = m_freeActions;
+						m_freeActions = spare;
+					}
+
 					continue;
 				}
 			}
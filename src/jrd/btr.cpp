@@ -89,6 +89,9 @@ namespace
 	// of the main page.
 	const ULONG NO_SPLIT	= 0;
 
+	// Maximum number of pages per level walked by BTR_estimate_range
+	const ULONG MAX_ESTIMATE_PAGES = 4;
+
 	// Thresholds for determing of a page should be garbage collected
 	// Garbage collect if page size is below GARBAGE_COLLECTION_THRESHOLD
 #define GARBAGE_COLLECTION_BELOW_THRESHOLD	(dbb->dbb_page_size / 4)
@@ -192,6 +195,7 @@ static ULONG add_node(thread_db*, WIN*, index_insertion*, temporary_key*, Record
 static void compress(thread_db*, const dsc*, const SSHORT scale, temporary_key*,
 					 USHORT, bool, USHORT, bool*);
 static USHORT compress_root(thread_db*, index_root_page*);
+static int compare_keys(const temporary_key*, const temporary_key*);
 static void copy_key(const temporary_key*, temporary_key*);
 static contents delete_node(thread_db*, WIN*, UCHAR*);
 static void delete_tree(thread_db*, USHORT, USHORT, PageNumber, PageNumber);
@@ -1044,6 +1048,167 @@ bool BTR_description(thread_db* tdbb, jrd_rel* relation, index_root_page* root,
 }
 
 
+double BTR_estimate_range(thread_db* tdbb, jrd_rel* relation, const index_desc* idx,
+						  const dsc* lowerDesc, const dsc* upperDesc, SSHORT scale)
+{
+/**************************************
+ *
+ *	B T R _ e s t i m a t e _ r a n g e
+ *
+ **************************************
+ *
+ * Functional description
+ *	Estimate the number of index entries that lie between the given
+ *	lower and upper values (either of them may be missing), thus
+ *	reflecting the real data distribution rather than the average
+ *	selectivity. The leaf level is walked first, up to a few pages.
+ *	If the range does not fit there, the next upper level is walked
+ *	and the result is extrapolated using the observed page fill.
+ *	Only single segment ascending indices are supported.
+ *	Return a negative value if the estimation is not possible.
+ *
+ **************************************/
+	SET_TDBB(tdbb);
+
+	if (idx->idx_count != 1 || (idx->idx_flags & idx_descending))
+		return -1;
+
+	const USHORT keyType = (idx->idx_flags & idx_unique) ? INTL_KEY_UNIQUE : INTL_KEY_SORT;
+	const USHORT itype = idx->idx_rpt[0].idx_itype;
+
+	temporary_key lower, upper;
+	lower.key_flags = upper.key_flags = 0;
+	lower.key_nulls = upper.key_nulls = 0;
+	lower.key_length = upper.key_length = 0;
+
+	if (lowerDesc)
+	{
+		lower.key_flags |= key_empty;
+		compress(tdbb, lowerDesc, scale, &lower, itype, false, keyType, nullptr);
+	}
+	else
+	{
+		// Skip NULLs (stored with no data) the same way the index scan does
+		lower.key_data[0] = 0;
+		lower.key_length = 1;
+	}
+
+	if (upperDesc)
+	{
+		upper.key_flags |= key_empty;
+		compress(tdbb, upperDesc, scale, &upper, itype, false, keyType, nullptr);
+	}
+
+	RelationPages* const relPages = relation->getPages(tdbb);
+	WIN window(relPages->rel_pg_space_id, -1);
+
+	double units = 1;	// number of entries represented by a node at the current level
+
+	for (UCHAR level = 0; level < MAX_LEVELS; level++)
+	{
+		const index_root_page* const root = fetch_root(tdbb, &window, relation, relPages);
+		if (!root)
+			return -1;
+
+		ULONG number;
+		if (idx->idx_id >= root->irt_count || !(number = root->irt_rpt[idx->idx_id].getRoot()))
+		{
+			CCH_RELEASE(tdbb, &window);
+			return -1;
+		}
+
+		btree_page* page = (btree_page*) CCH_HANDOFF(tdbb, &window, number, LCK_read, pag_index);
+
+		if (page->btr_level < level)
+		{
+			CCH_RELEASE(tdbb, &window);
+			return -1;
+		}
+
+		// Search down the index to the lower bound at the requested level
+
+		while (page->btr_level > level)
+		{
+			while ((number = find_page(page, &lower, idx, NO_VALUE, 0)) == END_BUCKET)
+				page = (btree_page*) CCH_HANDOFF(tdbb, &window, page->btr_sibling, LCK_read, pag_index);
+
+			page = (btree_page*) CCH_HANDOFF(tdbb, &window, number, LCK_read, pag_index);
+		}
+
+		// Walk the level and count the nodes belonging to the range
+
+		const bool leafPage = (level == 0);
+
+		temporary_key key;
+		FB_UINT64 count = 0, total = 0;
+		ULONG pages = 0;
+		bool done = false;
+
+		while (true)
+		{
+			pages++;
+
+			const UCHAR* const endPointer = (UCHAR*) page + page->btr_length;
+			UCHAR* pointer = page->btr_nodes + page->btr_jump_size;
+			key.key_length = 0;
+
+			IndexNode node;
+			while (true)
+			{
+				pointer = node.readNode(pointer, leafPage);
+
+				// Check if pointer is still valid
+				if (pointer > endPointer)
+					BUGCHECK(204);	// msg 204 index inconsistent
+
+				if (node.isEndBucket || node.isEndLevel)
+					break;
+
+				total++;
+
+				memcpy(key.key_data + node.prefix, node.data, node.length);
+				key.key_length = node.prefix + node.length;
+
+				if (compare_keys(&key, &lower) < 0)
+					continue;
+
+				if (upperDesc && compare_keys(&key, &upper) > 0)
+				{
+					done = true;
+					break;
+				}
+
+				count++;
+			}
+
+			if (node.isEndLevel)
+				done = true;
+
+			if (done || pages >= MAX_ESTIMATE_PAGES || !page->btr_sibling)
+				break;
+
+			page = (btree_page*) CCH_HANDOFF(tdbb, &window, page->btr_sibling, LCK_read, pag_index);
+		}
+
+		CCH_RELEASE(tdbb, &window);
+
+		if (done)
+		{
+			// Non-leaf node keys are the lowest keys of their child pages,
+			// so the range always touches at least one child page
+			if (!leafPage && !count)
+				count = 1;
+
+			return count * units;
+		}
+
+		units *= (double) total / pages;
+	}
+
+	return -1;
+}
+
+
 dsc* BTR_eval_expression(thread_db* tdbb, index_desc* idx, Record* record)
 {
 	return IndexExpression(tdbb, idx).evaluate(record);
@@ -3347,6 +3512,28 @@ static USHORT compress_root(thread_db* tdbb, index_root_page* page)
 }
 
 
+static int compare_keys(const temporary_key* key1, const temporary_key* key2)
+{
+/**************************************
+ *
+ *	c o m p a r e _ k e y s
+ *
+ **************************************
+ *
+ * Functional description
+ *	Compare two index keys bytewise.
+ *	A key being a prefix of another one is the lesser one.
+ *
+ **************************************/
+	const USHORT length = MIN(key1->key_length, key2->key_length);
+
+	if (const int result = memcmp(key1->key_data, key2->key_data, length))
+		return result;
+
+	return (int) key1->key_length - (int) key2->key_length;
+}
+
+
 static void copy_key(const temporary_key* in, temporary_key* out)
 {
 /**************************************
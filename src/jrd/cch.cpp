@@ -63,6 +63,7 @@
 #include "../jrd/CryptoManager.h"
 #include "../common/utils_proto.h"
 #include "../jrd/PageToBufferMap.h"
+#include "../jrd/RedoLog.h"
 
 // Use lock-free lists in hash table implementation
 #define HASH_USE_CDS_LIST
@@ -189,6 +190,10 @@ static inline void removeDirty(BufferControl* bcb, BufferDesc* bdb)
 
 static void flushDirty(thread_db* tdbb, SLONG transaction_mask, const bool sys_only);
 static void flushAll(thread_db* tdbb, USHORT flush_flag);
+static void groupFlush(thread_db* tdbb, ULONG transaction_mask, ULONG wait);
+static bool isRedoPage(const BufferDesc* bdb);
+static bool logPages(thread_db* tdbb, BufferDesc** begin, FB_SIZE_T count, int mode);
+static void switchRedoLog(thread_db* tdbb);
 static void flushPages(thread_db* tdbb, USHORT flush_flag, BufferDesc** begin, FB_SIZE_T count);
 
 static void recentlyUsed(BufferDesc* bdb);
@@ -205,6 +210,11 @@ const int PRE_SEARCH_LIMIT	= 256;
 const int PRE_EXISTS		= -1;
 const int PRE_UNKNOWN		= -2;
 
+// logPages() modes
+const int LOG_COMMITTED		= 1;	// pages changed by committing transaction
+const int LOG_WRITTEN		= 2;	// pages logged before and going to be written
+const int LOG_SWITCHED		= 3;	// pages logged into the old redo log file
+
 namespace Jrd
 {
 
@@ -1217,7 +1227,14 @@ void CCH_flush(thread_db* tdbb, USHORT flush_flag, TraNumber tra_number)
 		}
 		else
 #endif
-			flushDirty(tdbb, transaction_mask, sys_only);
+		{
+			const int groupWait = dbb->dbb_config->getGroupCommitWait();
+
+			if (transaction_mask && groupWait > 0 && (dbb->dbb_flags & DBB_force_write))
+				groupFlush(tdbb, transaction_mask, groupWait);
+			else
+				flushDirty(tdbb, transaction_mask, sys_only);
+		}
 	}
 	else
 		flushAll(tdbb, flush_flag);
@@ -2262,6 +2279,10 @@ void CCH_shutdown(thread_db* tdbb)
 				LongJump::raise();
 
 			CCH_flush(tdbb, FLUSH_FINI, 0);
+
+			// All pages are in the database now, the redo log is not needed anymore
+			if (dbb->dbb_redo_log)
+				dbb->dbb_redo_log->remove();
 		}
 		catch (const Exception&)
 		{
@@ -2694,10 +2715,279 @@ static void flushDirty(thread_db* tdbb, SLONG transaction_mask, const bool sys_o
 		}
 	}
 
+	if (dbb->dbb_redo_log)
+	{
+		// Pages of the main database are made durable by the redo log
+		// and left dirty, the rest of pages is written as usual.
+		// Replay of the log must not restore a page pointing to the lower
+		// precedence page which is neither written nor logged, thus dirty
+		// lower pages are logged in the same batch.
+
+		{	// scope
+			Sync precSync(&bcb->bcb_syncPrecedence, FB_FUNCTION);
+			precSync.lock(SYNC_SHARED);
+
+			// Array grows while walking it, so whole closure is collected
+			for (FB_SIZE_T i = 0; i < flush.getCount(); i++)
+			{
+				const BufferDesc* const bdb = flush[i];
+
+				for (QUE que_inst = bdb->bdb_lower.que_forward; que_inst != &bdb->bdb_lower;
+					 que_inst = que_inst->que_forward)
+				{
+					const Precedence* const precedence = BLOCK(que_inst, Precedence, pre_lower);
+					BufferDesc* const low = precedence->pre_low;
+
+					if (!(precedence->pre_flags & PRE_cleared) && (low->bdb_flags & BDB_dirty) &&
+						!flush.exist(low))
+					{
+						flush.add(low);
+					}
+				}
+			}
+		}
+
+		// Pages out of the redo log are written before the logged ones could refer them
+
+		HalfStaticArray<BufferDesc*, 16> direct;
+		FB_SIZE_T count = 0;
+
+		for (FB_SIZE_T i = 0; i < flush.getCount(); i++)
+		{
+			if (isRedoPage(flush[i]))
+				flush[count++] = flush[i];
+			else
+				direct.add(flush[i]);
+		}
+
+		flushPages(tdbb, FLUSH_TRAN, direct.begin(), direct.getCount());
+
+		if (logPages(tdbb, flush.begin(), count, LOG_COMMITTED))
+			switchRedoLog(tdbb);
+
+		return;
+	}
+
 	flushPages(tdbb, FLUSH_TRAN, flush.begin(), flush.getCount());
 }
 
 
+// Flush pages modified by committing transaction together with the pages of other
+// transactions committing at the same time. The first of them becomes the leader of
+// the group: it waits given number of milliseconds for others to join and then writes
+// pages of the whole group at once, while the rest of the group waits for it.
+static void groupFlush(thread_db* tdbb, ULONG transaction_mask, ULONG wait)
+{
+	SET_TDBB(tdbb);
+	Database* dbb = tdbb->getDatabase();
+	BufferControl* bcb = dbb->dbb_bcb;
+
+	FB_UINT64 group;
+	ULONG group_mask = 0;
+	bool leader = false;
+
+	{	// scope
+		EngineCheckout cout(tdbb, FB_FUNCTION);
+		MutexLockGuard guard(bcb->bcb_commit_mutex, FB_FUNCTION);
+
+		bcb->bcb_commit_mask |= transaction_mask;
+		group = bcb->bcb_commit_group;
+
+		while (bcb->bcb_commit_done < group)
+		{
+			if (!bcb->bcb_commit_leader)
+			{
+				bcb->bcb_commit_leader = true;
+				leader = true;
+				break;
+			}
+
+			bcb->bcb_commit_cond.wait(bcb->bcb_commit_mutex);
+		}
+
+		if (leader)
+		{
+			{	// scope
+				MutexUnlockGuard unlock(bcb->bcb_commit_mutex, FB_FUNCTION);
+				Thread::sleep(wait);
+			}
+
+			// Transactions arriving from now on belong to the next group
+
+			group_mask = bcb->bcb_commit_mask;
+			bcb->bcb_commit_mask = 0;
+			bcb->bcb_commit_group++;
+		}
+		else if (bcb->bcb_commit_failed < group)
+			return;
+	}
+
+	if (!leader)
+	{
+		// Leader failed to write our pages, do it ourselves
+		flushDirty(tdbb, transaction_mask, false);
+		return;
+	}
+
+	const auto finishGroup = [bcb, group](bool failed)
+	{
+		MutexLockGuard guard(bcb->bcb_commit_mutex, FB_FUNCTION);
+
+		bcb->bcb_commit_done = group;
+		if (failed)
+			bcb->bcb_commit_failed = group;
+		bcb->bcb_commit_leader = false;
+		bcb->bcb_commit_cond.notifyAll();
+	};
+
+	try
+	{
+		flushDirty(tdbb, group_mask, false);
+	}
+	catch (const Exception&)
+	{
+		finishGroup(true);
+		throw;
+	}
+
+	finishGroup(false);
+}
+
+
+// Tell if the page in buffer could be logged into redo log. Header page is
+// always written directly as it's read before the log is replayed.
+static bool isRedoPage(const BufferDesc* bdb)
+{
+	return bdb->bdb_page.getPageSpaceID() == DB_PAGE_SPACE && bdb->bdb_page != HEADER_PAGE_NUMBER;
+}
+
+
+// Put images of the given pages into redo log and wait until they are on disk.
+// Depending on mode, pages changed since they were logged last time, pages
+// logged before and going to be written now or pages logged into the old log
+// file are put there. Returns true if redo log should be switched.
+static bool logPages(thread_db* tdbb, BufferDesc** begin, FB_SIZE_T count, int mode)
+{
+	Database* const dbb = tdbb->getDatabase();
+	RedoLog* const redo = dbb->dbb_redo_log;
+
+	RedoLog::Batch batch(*tdbb->getDefaultPool());
+	HalfStaticArray<BufferDesc*, 64> logged;
+	HalfStaticArray<ULONG, 64> incarnations;
+
+	for (BufferDesc** ptr = begin; ptr < begin + count; ptr++)
+	{
+		BufferDesc* const bdb = *ptr;
+
+		if (!isRedoPage(bdb) ||
+			(mode != LOG_SWITCHED && bdb->bdb_redo_incarnation == bdb->bdb_incarnation))
+		{
+			continue;
+		}
+
+		// Committed changes must not be skipped, so wait for the page
+		// modification in progress to be finished
+
+		const bool latch = (mode == LOG_COMMITTED);
+		if (latch)
+			bdb->addRef(tdbb, SYNC_SHARED);
+
+		bdb->lockIO(tdbb);
+
+		// Page is not dirty anymore if it was written by someone else meanwhile
+
+		bool log = isRedoPage(bdb) && (bdb->bdb_flags & BDB_dirty) && !(bdb->bdb_flags & BDB_marked);
+
+		if (log)
+		{
+			const ULONG pageNum = bdb->bdb_page.getPageNum();
+
+			switch (mode)
+			{
+			case LOG_COMMITTED:
+				log = (bdb->bdb_redo_incarnation != bdb->bdb_incarnation);
+				break;
+
+			case LOG_WRITTEN:
+				log = (bdb->bdb_redo_incarnation != bdb->bdb_incarnation) && redo->isLogged(pageNum);
+				break;
+
+			case LOG_SWITCHED:
+				log = redo->isOldPage(pageNum);
+				break;
+			}
+
+			if (log)
+			{
+				batch.addPage(pageNum, bdb->bdb_buffer, dbb->dbb_page_size);
+				logged.add(bdb);
+				incarnations.add(bdb->bdb_incarnation);
+			}
+		}
+
+		bdb->unLockIO(tdbb);
+
+		if (latch)
+			bdb->release(tdbb, false);
+	}
+
+	const bool doSwitch = redo->write(batch);
+
+	// Remember what is logged only when it's on disk, else concurrent
+	// commit could skip the page and return before it's durable
+
+	for (FB_SIZE_T i = 0; i < logged.getCount(); i++)
+	{
+		BufferDesc* const bdb = logged[i];
+
+		bdb->lockIO(tdbb);
+		if (bdb->bdb_incarnation == incarnations[i])
+			bdb->bdb_redo_incarnation = incarnations[i];
+		bdb->unLockIO(tdbb);
+	}
+
+	return doSwitch;
+}
+
+
+// Switch redo log to a new file. Pages still dirty and having an image in the
+// old file are logged once more, so the old file could be removed then.
+static void switchRedoLog(thread_db* tdbb)
+{
+	Database* const dbb = tdbb->getDatabase();
+	BufferControl* const bcb = dbb->dbb_bcb;
+	RedoLog* const redo = dbb->dbb_redo_log;
+
+	try
+	{
+		redo->switchFile();
+
+		HalfStaticArray<BufferDesc*, 1024> dirty;
+
+		{	// scope
+			Sync dirtySync(&bcb->bcb_syncDirtyBdbs, FB_FUNCTION);
+			dirtySync.lock(SYNC_SHARED);
+
+			for (QUE que_inst = bcb->bcb_dirty.que_forward; que_inst != &bcb->bcb_dirty;
+				 que_inst = que_inst->que_forward)
+			{
+				dirty.add(BLOCK(que_inst, BufferDesc, bdb_dirty));
+			}
+		}
+
+		logPages(tdbb, dirty.begin(), dirty.getCount(), LOG_SWITCHED);
+
+		redo->removeOldFile();
+	}
+	catch (const Exception& ex)
+	{
+		// Commit is durable already, just keep the old file and retry later
+		redo->cancelSwitch();
+		iscLogException("Redo log switch failed", ex);
+	}
+}
+
+
 // Collect pages modified by garbage collector or all dirty pages or release page
 // locks - depending of flush_flag, and write it to disk.
 // See also comments in flushPages.
@@ -2789,6 +3079,11 @@ static void flushPages(thread_db* tdbb, USHORT flush_flag, BufferDesc** begin, F
 
 	qsort(begin, count, sizeof(BufferDesc*), cmpBdbs);
 
+	// Log all the pages needing it at once instead of doing it page by page in write_page()
+
+	if (tdbb->getDatabase()->dbb_redo_log)
+		logPages(tdbb, begin, count, LOG_WRITTEN);
+
 	MarkIterator<BufferDesc*> iter(begin, count);
 
 	FB_SIZE_T written = 0;
@@ -4896,6 +5191,32 @@ static bool write_page(thread_db* tdbb, BufferDesc* bdb, FbStatusVector* const s
 		}
 	}
 
+	// Page having an image in redo log must not be written into the database
+	// unless its current image is logged too, otherwise replay of the log could
+	// overwrite the page with an older image
+
+	RedoLog* const redo = dbb->dbb_redo_log;
+
+	if (redo && isRedoPage(bdb) && bdb->bdb_redo_incarnation != bdb->bdb_incarnation &&
+		redo->isLogged(bdb->bdb_page.getPageNum()))
+	{
+		try
+		{
+			RedoLog::Batch batch(*tdbb->getDefaultPool());
+			batch.addPage(bdb->bdb_page.getPageNum(), page, dbb->dbb_page_size);
+			redo->write(batch);
+		}
+		catch (const Exception& ex)
+		{
+			ex.stuffException(status);
+			bdb->bdb_flags |= BDB_io_error;
+			dbb->dbb_flags |= DBB_suspend_bgio;
+			return false;
+		}
+
+		bdb->bdb_redo_incarnation = bdb->bdb_incarnation;
+	}
+
 	page->pag_generation++;
 	bool result = true;
 
@@ -27,6 +27,7 @@
 #include "../include/fb_blk.h"
 #include "../common/classes/alloc.h"
 #include "../common/classes/RefCounted.h"
+#include "../common/classes/condition.h"
 #include "../common/classes/semaphore.h"
 #include "../common/classes/SyncObject.h"
 #include "../common/ThreadStart.h"
@@ -99,6 +100,11 @@ class BufferControl : public pool_alloc<type_bcb>
 		bcb_page_size = 0;
 		bcb_page_incarnation = 0;
 		bcb_hashTable = nullptr;
+		bcb_commit_mask = 0;
+		bcb_commit_group = 1;
+		bcb_commit_done = 0;
+		bcb_commit_failed = 0;
+		bcb_commit_leader = false;
 #ifdef SUPERSERVER_V2
 		bcb_prefetch = NULL;
 #endif
@@ -151,6 +157,16 @@ public:
 	Firebird::Semaphore bcb_writer_sem;		// Wake up cache writer
 	Firebird::Semaphore bcb_writer_init;	// Cache writer initialization
 	BcbThreadSync bcb_writer_fini;			// Cache writer finalization
+
+	// Group commit: transactions committing close to each other share one flush
+	Firebird::Mutex		bcb_commit_mutex;
+	Firebird::Condition	bcb_commit_cond;	// signalled when a group is flushed
+	ULONG		bcb_commit_mask;		// transaction mask of the group being collected
+	FB_UINT64	bcb_commit_group;		// number of the group being collected
+	FB_UINT64	bcb_commit_done;		// number of the last group flushed
+	FB_UINT64	bcb_commit_failed;		// number of the last group whose flush failed
+	bool		bcb_commit_leader;		// group has a leader that will flush it
+
 #ifdef SUPERSERVER_V2
 	static void cache_reader(BufferControl* bcb);
 	// the code in cch.cpp is not tested for semaphore instead event !!!
@@ -213,6 +229,7 @@ public:
 		bdb_scan_count = 0;
 		bdb_difference_page = 0;
 		bdb_prec_walk_mark = 0;
+		bdb_redo_incarnation = 0;
 	}
 
 	bool addRef(thread_db* tdbb, Firebird::SyncType syncType, int wait = 1);
@@ -267,6 +284,7 @@ public:
 	Firebird::AtomicCounter	bdb_scan_count;		// concurrent sequential scans
 	ULONG       bdb_difference_page;			// Number of page in difference file, NBAK
 	ULONG		bdb_prec_walk_mark;				// mark value used in precedence graph walk
+	ULONG		bdb_redo_incarnation;			// incarnation of the page image put into redo log
 };
 
 // bdb_flags
@@ -71,6 +71,24 @@ static void preKmp(const CharType *x, int m, SLONG kmpNext[])
 	kmpNext[++i] = ++j;
 }
 
+// Find the first occurrence of the character, return the end of data if there is none
+template <typename CharType>
+static inline const CharType* findChar(const CharType* data, const CharType* end, CharType c)
+{
+	while (data < end && *data != c)
+		data++;
+
+	return data;
+}
+
+// Single byte characters are searched using memchr() which the runtime library
+// implements with the best vector instructions supported by the running CPU
+static inline const UCHAR* findChar(const UCHAR* data, const UCHAR* end, UCHAR c)
+{
+	const void* const found = memchr(data, c, end - data);
+	return found ? static_cast<const UCHAR*>(found) : end;
+}
+
 class StaticAllocator
 {
 public:
@@ -142,6 +160,7 @@ public:
 		if (!result || offset >= pattern_len)
 			return false;
 
+		// Only the prefix is compared, so unlike CONTAINS and LIKE there is nothing to skip
 		const SLONG comp_length = data_len < pattern_len - offset ? data_len : pattern_len - offset;
 		if (memcmp(data, pattern_str + offset, sizeof(CharType) * comp_length) != 0)
 		{
@@ -194,6 +213,14 @@ public:
 		SLONG data_pos = 0;
 		while (data_pos < data_len)
 		{
+			// While nothing is matched, skip to the first character of the pattern
+			if (offset == 0)
+			{
+				data_pos = findChar(data + data_pos, data + data_len, pattern_str[0]) - data;
+				if (data_pos >= data_len)
+					break;
+			}
+
 			while (offset > -1 && pattern_str[offset] != data[data_pos])
 				offset = kmpNext[offset];
 			offset++;
@@ -500,6 +527,20 @@ bool LikeEvaluator<CharType>::processNextChunk(const CharType* data, SLONG data_
 
 	while (data_pos < data_len)
 	{
+		// While nothing is matched by the only branch searching the string,
+		// skip to the first character of that string
+		if (branches.getCount() == 1)
+		{
+			const BranchItem& branch = branches[0];
+
+			if (branch.pattern->type == piSearch && branch.offset == 0 && branch.pattern->str.length)
+			{
+				data_pos = findChar(data + data_pos, data + data_len, branch.pattern->str.data[0]) - data;
+				if (data_pos >= data_len)
+					break;
+			}
+		}
+
 		FB_SIZE_T branch_number = 0;
 		while (branch_number < branches.getCount())
 		{
@@ -78,6 +78,7 @@
 #include "../jrd/blb_proto.h"
 #include "../jrd/cch_proto.h"
 #include "../jrd/cmp_proto.h"
+#include "../jrd/dpm_proto.h"
 #include "../jrd/err_proto.h"
 #include "../jrd/exe_proto.h"
 #include "../jrd/ext_proto.h"
@@ -132,6 +133,7 @@
 #include "../common/utils_proto.h"
 #include "../jrd/DebugInterface.h"
 #include "../jrd/CryptoManager.h"
+#include "../jrd/RedoLog.h"
 #include "../jrd/DbCreators.h"
 
 #include "../dsql/dsql.h"
@@ -1840,6 +1842,37 @@ JAttachment* JProvider::internalAttach(CheckStatusWrapper* user_status, const ch
 				// but before any real work is done
 				SDW_init(tdbb, options.dpb_activate_shadow, options.dpb_delete_shadow);
 
+				// Restore pages committed but not written by the previous run
+				// and start logging them again if asked to. Only the shared cache
+				// may defer the writes as no other process reads the database.
+				// Redo log keeps plain page images thus it's not used when the
+				// database is encrypted.
+				if (dbb->dbb_flags & DBB_shared)
+				{
+					RedoLog::recover(tdbb);
+
+					if (dbb->dbb_config->getRedoLogSize() > 0 && !dbb->readOnly())
+					{
+						if (dbb->dbb_crypto_manager->getCurrentState(tdbb))
+						{
+							gds__log("Database %s is encrypted, redo log is not used",
+								dbb->dbb_filename.c_str());
+						}
+						else
+						{
+							dbb->dbb_redo_log =
+								FB_NEW_POOL(*dbb->dbb_permanent) RedoLog(*dbb->dbb_permanent, dbb);
+						}
+					}
+				}
+				else if (RedoLog::exists(dbb))
+				{
+					// Pages in the log are newer than ones in the database,
+					// it's not safe to work without replaying them first
+					ERR_post(Arg::Gds(isc_random) <<
+						Arg::Str("Redo log of the database must be replayed by SuperServer first"));
+				}
+
 				// Initialize TIP cache. We do this late to give SDW a chance to
 				// work while we read states for all interesting transactions
 				dbb->dbb_tip_cache = TipCache::create(tdbb);
@@ -7997,6 +8030,8 @@ bool JRD_shutdown_database(Database* dbb, const unsigned flags)
 #ifdef SUPERSERVER_V2
 		TRA_header_write(tdbb, dbb, 0);	// Update transaction info on header page.
 #endif
+		DPM_flush_gen_cache(tdbb);
+
 		if (flags & SHUT_DBB_RELEASE_POOLS)
 			TRA_update_counters(tdbb, dbb);
 	}
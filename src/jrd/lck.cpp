@@ -141,10 +141,18 @@ static const bool compatibility[LCK_max][LCK_max] =
 //#define COMPATIBLE(st1, st2)	compatibility [st1 * LCK_max + st2]
 const int LOCK_HASH_SIZE	= 19;
 
+inline LocalLockTable* getLocalLocks(const Lock* lock)
+{
+	LocalLockTable* const localLocks = lock->lck_dbb->dbb_local_locks;
+	return (localLocks && LocalLockTable::isLocal(lock)) ? localLocks : NULL;
+}
+
 inline void ENQUEUE(thread_db* tdbb, CheckStatusWrapper* statusVector, Lock* lock, USHORT level, SSHORT wait)
 {
 	if (lock->lck_compatible)
 		internal_enqueue(tdbb, statusVector, lock, level, wait, false);
+	else if (LocalLockTable* const localLocks = getLocalLocks(lock))
+		localLocks->enqueue(tdbb, statusVector, lock, level, wait);
 	else
 		enqueue(tdbb, statusVector, lock, level, wait);
 }
@@ -153,6 +161,9 @@ inline bool CONVERT(thread_db* tdbb, CheckStatusWrapper* statusVector, Lock* loc
 {
 	Database* const dbb = tdbb->getDatabase();
 
+	if (LocalLockTable* const localLocks = getLocalLocks(lock))
+		localLocks->promote(tdbb, lock);
+
 	return lock->lck_compatible ?
 		internal_enqueue(tdbb, statusVector, lock, level, wait, true) :
 		dbb->lockManager()->convert(tdbb, statusVector, lock->lck_id, level, wait, lock->lck_ast,
@@ -165,6 +176,8 @@ inline void DEQUEUE(thread_db* tdbb, Lock* lock)
 
 	if (lock->lck_compatible)
 		internal_dequeue(tdbb, lock);
+	else if (LocalLockTable* const localLocks = getLocalLocks(lock))
+		localLocks->dequeue(tdbb, lock);
 	else
 		dbb->lockManager()->dequeue(lock->lck_id);
 }
@@ -173,6 +186,9 @@ inline USHORT DOWNGRADE(thread_db* tdbb, Lock* lock)
 {
 	Database* const dbb = tdbb->getDatabase();
 
+	if (LocalLockTable* const localLocks = getLocalLocks(lock))
+		localLocks->promote(tdbb, lock);
+
 	FbLocalStatus statusVector;
 
 	USHORT ret = lock->lck_compatible ?
@@ -775,6 +791,11 @@ LOCK_DATA_T LCK_read_data(thread_db* tdbb, Lock* lock)
 
 	fb_assert(LCK_CHECK_LOCK(lock));
 
+	// the lock manager knows nothing about the data of the locally granted locks
+
+	if (LocalLockTable* const localLocks = getLocalLocks(lock))
+		localLocks->promote(tdbb, lock);
+
 	const LOCK_DATA_T data =
 		dbb->lockManager()->readData2(lock->lck_type,
 									 lock->getKeyPtr(), lock->lck_length,
@@ -864,6 +885,9 @@ void LCK_write_data(thread_db* tdbb, Lock* lock, LOCK_DATA_T data)
 
 	fb_assert(LCK_CHECK_LOCK(lock));
 
+	if (LocalLockTable* const localLocks = getLocalLocks(lock))
+		localLocks->promote(tdbb, lock);
+
 	dbb->lockManager()->writeData(lock->lck_id, data);
 	lock->lck_data = data;
 
@@ -1455,6 +1479,194 @@ static bool internal_enqueue(thread_db* tdbb, CheckStatusWrapper* statusVector,
 	return lock->lck_id ? true : false;
 }
 
+// LocalLockTable class implementation
+
+bool LocalLockTable::isLocal(const Lock* lock)
+{
+	switch (lock->lck_type)
+	{
+	case LCK_record_gc:
+	case LCK_btr_dont_gc:
+		return !lock->lck_ast && !lock->lck_compatible;
+
+	default:
+		return false;
+	}
+}
+
+LocalLockTable::Stripe& LocalLockTable::getStripe(const Lock* lock)
+{
+	// record keys have the line number in the low bits and
+	// page keys have the page space ID in the high bits
+
+	const FB_UINT64 key = lock->getKey();
+	const FB_UINT64 hash = (key ^ (key >> 16) ^ (key >> 32)) * 31 + lock->lck_type;
+
+	return m_stripes[hash % STRIPES];
+}
+
+LocalLockTable::Entry* LocalLockTable::find(Stripe& stripe, const Lock* lock)
+{
+	for (auto& entry : stripe.entries)
+	{
+		if (entry.key == lock->getKey() && entry.type == lock->lck_type &&
+			entry.length == lock->lck_length)
+		{
+			return &entry;
+		}
+	}
+
+	return NULL;
+}
+
+void LocalLockTable::enqueue(thread_db* tdbb, CheckStatusWrapper* statusVector, Lock* lock,
+	USHORT level, SSHORT wait)
+{
+/**************************************
+ *
+ * Grant the lock in process memory if there are no conflicting requests.
+ * Otherwise the lock is submitted to the lock manager, promoting the
+ * locally granted requests there first, so the lock could wait for them.
+ *
+ **************************************/
+	fb_assert(LCK_CHECK_LOCK(lock));
+
+	Stripe& stripe = getStripe(lock);
+
+	{	// scope
+		MutexLockGuard guard(stripe.mutex, FB_FUNCTION);
+
+		Entry* entry = find(stripe, lock);
+		if (!entry)
+		{
+			entry = &stripe.entries.add();
+			entry->type = lock->lck_type;
+			entry->length = lock->lck_length;
+			entry->key = lock->getKey();
+		}
+
+		if (!entry->promoted)
+		{
+			bool conflict = false;
+			for (USHORT i = LCK_null; i < LCK_max && !conflict; i++)
+				conflict = entry->granted[i] && !compatibility[i][level];
+
+			if (!conflict)
+			{
+				// Set the lock levels under the mutex as promotion could happen right away
+
+				entry->users++;
+				entry->granted[level]++;
+				lock->lck_identical = entry->holders;
+				entry->holders = lock;
+
+				lock->lck_id = LOCAL_LOCK_ID;
+				lock->lck_physical = lock->lck_logical = level;
+				return;
+			}
+
+			promoteEntry(tdbb, entry);
+		}
+
+		entry->users++;
+	}
+
+	::enqueue(tdbb, statusVector, lock, level, wait);
+
+	if (!lock->lck_id)
+	{
+		MutexLockGuard guard(stripe.mutex, FB_FUNCTION);
+
+		Entry* const entry = find(stripe, lock);
+		fb_assert(entry && entry->promoted);
+
+		if (entry && !--entry->users)
+			stripe.entries.remove(entry);
+	}
+}
+
+void LocalLockTable::dequeue(thread_db* tdbb, Lock* lock)
+{
+	fb_assert(LCK_CHECK_LOCK(lock));
+
+	Stripe& stripe = getStripe(lock);
+	MutexLockGuard guard(stripe.mutex, FB_FUNCTION);
+
+	Entry* const entry = find(stripe, lock);
+	if (!entry)
+		BUGCHECK(285);			// lock not found in internal lock manager
+
+	if (lock->lck_id == LOCAL_LOCK_ID)
+	{
+		for (Lock** ptr = &entry->holders; *ptr; ptr = &(*ptr)->lck_identical)
+		{
+			if (*ptr == lock)
+			{
+				*ptr = lock->lck_identical;
+				break;
+			}
+		}
+
+		lock->lck_identical = NULL;
+		entry->granted[lock->lck_physical]--;
+	}
+	else if (!tdbb->getDatabase()->lockManager()->dequeue(lock->lck_id))
+		bug_lck("LOCK_deq() failed in LocalLockTable::dequeue");
+
+	if (!--entry->users)
+		stripe.entries.remove(entry);
+}
+
+void LocalLockTable::promote(thread_db* tdbb, Lock* lock)
+{
+	Stripe& stripe = getStripe(lock);
+	MutexLockGuard guard(stripe.mutex, FB_FUNCTION);
+
+	Entry* const entry = find(stripe, lock);
+	if (entry && !entry->promoted)
+		promoteEntry(tdbb, entry);
+}
+
+void LocalLockTable::promoteEntry(thread_db* tdbb, Entry* entry)
+{
+/**************************************
+ *
+ * Enqueue the locally granted requests in the lock manager on behalf
+ * of their owners. They are compatible with each other and nobody else
+ * has a request for the key there, so the lock manager grants them all.
+ *
+ **************************************/
+	Database* const dbb = tdbb->getDatabase();
+
+	entry->promoted = true;
+
+	Lock* next;
+	for (Lock* holder = entry->holders; holder; holder = next)
+	{
+		next = holder->lck_identical;
+
+		FbLocalStatus statusVector;
+
+		const SLONG id = dbb->lockManager()->enqueue(tdbb, &statusVector, 0,
+			holder->lck_type, holder->getKeyPtr(), holder->lck_length,
+			holder->lck_physical, NULL, NULL, holder->lck_data, LCK_NO_WAIT,
+			holder->lck_owner_handle);
+
+		if (!id)
+		{
+			if (statusVector[1] == isc_lockmanerr)
+				dbb->dbb_flags |= DBB_bugcheck;
+
+			statusVector.raise();
+		}
+
+		holder->lck_id = id;
+		holder->lck_identical = NULL;
+		entry->holders = next;
+		entry->granted[holder->lck_physical]--;
+	}
+}
+
 Lock::Lock(thread_db* tdbb, USHORT length, lck_t type, void* object, lock_ast_t ast)
 :	lck_dbb(tdbb->getDatabase()),
  	lck_attachment(NULL),
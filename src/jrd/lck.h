@@ -177,6 +177,52 @@ public:
 	}
 };
 
+// In SuperServer the database file is opened exclusively, thus nobody outside
+// of the process can request a lock. Short-living locks without blocking AST
+// (record and b-tree page GC locks) are granted in process memory while they
+// are not contended. The first conflicting request promotes the locally granted
+// requests into the lock manager and waits there as usual. The key returns to
+// the local table after all of its requests in the lock manager are released.
+
+class LocalLockTable
+{
+public:
+	static const SLONG LOCAL_LOCK_ID = -1;	// lck_id of the lock granted locally
+
+	static bool isLocal(const Lock* lock);
+
+	void enqueue(thread_db* tdbb, Firebird::CheckStatusWrapper* statusVector, Lock* lock,
+		USHORT level, SSHORT wait);
+	void dequeue(thread_db* tdbb, Lock* lock);
+	void promote(thread_db* tdbb, Lock* lock);
+
+private:
+	static const unsigned STRIPES = 64;
+
+	struct Entry
+	{
+		lck_t type;
+		USHORT length;
+		SINT64 key;
+		ULONG users;				// requests granted locally or submitted to the lock manager
+		ULONG granted[LCK_max];		// locally granted requests per level
+		Lock* holders;				// locally granted locks linked via lck_identical
+		bool promoted;				// requests for the key are handled by the lock manager
+	};
+
+	struct Stripe
+	{
+		Firebird::Mutex mutex;
+		Firebird::HalfStaticArray<Entry, 8> entries;
+	};
+
+	Stripe& getStripe(const Lock* lock);
+	static Entry* find(Stripe& stripe, const Lock* lock);
+	static void promoteEntry(thread_db* tdbb, Entry* entry);
+
+	Stripe m_stripes[STRIPES];
+};
+
 } // namespace Jrd
 
 #endif // JRD_LCK_H
@@ -33,6 +33,7 @@
 #include "../jrd/ods.h"
 #include "../jrd/RecordSourceNodes.h"
 #include "../jrd/recsrc/RecordSource.h"
+#include "../common/classes/GenericMap.h"
 #include "../dsql/BoolNodes.h"
 #include "../dsql/ExprNodes.h"
 #include "../dsql/StmtNodes.h"
@@ -308,7 +309,10 @@ bool InnerJoin::findJoinOrder()
 		}
 	}
 
-	if (bestCount == 0)
+	// Unless PLAN is enforced, try the exhaustive search first and
+	// fallback to the greedy one if the search space is too large
+
+	if (bestCount == 0 && (plan || !findOptimalOrder()))
 	{
 		IndexedRelationships indexedRelationships;
 
@@ -487,6 +491,224 @@ void InnerJoin::findBestOrder(unsigned position,
 }
 
 
+//
+// Find the best join order using dynamic programming over the connected
+// subsets of streams (only left-deep trees are considered). Every subset is
+// extended by the streams having an indexed relationship with its streams,
+// the cheapest order is kept per subset. As in the greedy search, the longest
+// found order wins. Return false if the search space exceeds the limits.
+//
+
+bool InnerJoin::findOptimalOrder()
+{
+	HalfStaticArray<StreamInfo*, OPT_STATIC_ITEMS> streams;
+
+	for (const auto innerStream : innerStreams)
+	{
+		if (!innerStream->used)
+			streams.add(innerStream);
+	}
+
+	const auto count = streams.getCount();
+
+	if (!count || count > MAX_DP_STREAMS)
+		return false;
+
+	NonPooledMap<FB_UINT64, JoinSubset> subsets(getPool());
+	HalfStaticArray<FB_UINT64, OPT_STATIC_ITEMS> current, next;
+	unsigned estimations = 0;
+
+	// Start with the single streams
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		const auto stream = streams[i];
+		const auto tail = &csb->csb_rpt[stream->number];
+
+		JoinSubset subset;
+		subset.last = i;
+		subset.cardinality = 1.0;
+
+		tail->activate();
+		joinedStreams[0].reset(stream->number);
+
+		double cost = 0, cardinality = subset.cardinality;
+		estimateCost(0, stream, cost, cardinality);
+		estimations++;
+
+		tail->deactivate();
+
+		subset.cost = cost;
+		subset.cardinality = cardinality;
+
+		const FB_UINT64 mask = FB_UINT64(1) << i;
+		subsets.put(mask, subset);
+		current.add(mask);
+	}
+
+	// Extend the subsets one stream at a time
+
+	for (unsigned position = 1; position < count; position++)
+	{
+		next.clear();
+
+		for (const auto mask : current)
+		{
+			const auto subset = *subsets.get(mask);
+
+			// Restore the join order of this subset and make its streams active
+
+			auto priorMask = mask;
+			for (auto i = position; i > 0; i--)
+			{
+				const auto prior = subsets.get(priorMask);
+				const auto priorStream = streams[prior->last]->number;
+
+				joinedStreams[i - 1].reset(priorStream);
+				csb->csb_rpt[priorStream].activate();
+
+				priorMask = prior->prior;
+			}
+
+			for (unsigned i = 0; i < count; i++)
+			{
+				const FB_UINT64 bit = FB_UINT64(1) << i;
+
+				if (mask & bit)
+					continue;
+
+				const auto stream = streams[i];
+
+				// Check whether the stream has an indexed relationship
+				// with the streams being already active
+
+				bool usable = false;
+
+				for (unsigned j = 0; j < count && !usable; j++)
+				{
+					if (!(mask & (FB_UINT64(1) << j)))
+						continue;
+
+					for (const auto& relationship : streams[j]->indexedRelationships)
+					{
+						if (relationship.stream != stream->number)
+							continue;
+
+						usable = true;
+
+						for (const auto depStream : relationship.depStreams)
+						{
+							if (!(csb->csb_rpt[depStream].csb_flags & csb_active))
+							{
+								usable = false;
+								break;
+							}
+						}
+
+						break;
+					}
+				}
+
+				if (!usable)
+					continue;
+
+				if (++estimations > MAX_DP_ESTIMATIONS)
+				{
+					for (unsigned j = 0; j < position; j++)
+						csb->csb_rpt[joinedStreams[j].number].deactivate();
+
+					return false;
+				}
+
+				const auto tail = &csb->csb_rpt[stream->number];
+
+				tail->activate();
+				joinedStreams[position].reset(stream->number);
+
+				double cost = 0, cardinality = subset.cardinality;
+				estimateCost(position, stream, cost, cardinality);
+
+				tail->deactivate();
+
+				const auto newCost = subset.cost + cost;
+				const auto newMask = mask | bit;
+
+				auto newSubset = subsets.get(newMask);
+
+				if (!newSubset)
+				{
+					newSubset = subsets.put(newMask);
+					next.add(newMask);
+				}
+				else if (newSubset->cost <= newCost)
+					continue;
+
+				newSubset->cost = newCost;
+				newSubset->cardinality = subset.cardinality * cardinality;
+				newSubset->prior = mask;
+				newSubset->last = i;
+			}
+
+			for (unsigned j = 0; j < position; j++)
+				csb->csb_rpt[joinedStreams[j].number].deactivate();
+		}
+
+		if (next.isEmpty())
+			break;
+
+		current.assign(next);
+	}
+
+	// Pick the cheapest one out of the longest join orders
+
+	auto bestMask = current.front();
+
+	for (const auto mask : current)
+	{
+		if (subsets.get(mask)->cost < subsets.get(bestMask)->cost)
+			bestMask = mask;
+	}
+
+	HalfStaticArray<StreamInfo*, OPT_STATIC_ITEMS> order;
+
+	for (auto mask = bestMask; mask;)
+	{
+		const auto subset = subsets.get(mask);
+		order.insert(0, streams[subset->last]);
+		mask = subset->prior;
+	}
+
+	// Estimate the chosen join order once again to collect the equi-join
+	// conditions and selectivities for every position
+
+	bestCount = order.getCount();
+	bestCost = 0;
+
+	double totalCardinality = 1.0;
+
+	for (unsigned position = 0; position < bestCount; position++)
+	{
+		const auto stream = order[position];
+
+		csb->csb_rpt[stream->number].activate();
+		joinedStreams[position].reset(stream->number);
+
+		double cost = 0, cardinality = totalCardinality;
+		estimateCost(position, stream, cost, cardinality);
+
+		bestCost += cost;
+		totalCardinality *= cardinality;
+	}
+
+	bestStreams.assign(joinedStreams.begin(), bestCount);
+
+	for (const auto stream : order)
+		csb->csb_rpt[stream->number].deactivate();
+
+	return true;
+}
+
+
 //
 // Form streams into rivers (combinations of streams)
 //
@@ -577,9 +799,10 @@ River* InnerJoin::formRiver()
 				std::swap(keys[0], keys[1]);
 			}
 
-			// Create a hash join
+			// Create a hash join. If the sort node was utilized,
+			// it must preserve the order of the leading stream.
 			rsb = FB_NEW_POOL(getPool())
-				HashJoin(tdbb, csb, 2, hashJoinRsbs, keys.begin(), stream.selectivity);
+				HashJoin(tdbb, csb, 2, hashJoinRsbs, keys.begin(), stream.selectivity, sortUtilized);
 
 			// Clear priorly processed rsb's, as they're already incorporated into a hash join
 			rsbs.clear();
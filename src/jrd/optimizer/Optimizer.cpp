@@ -1020,6 +1020,30 @@ RecordSource* Optimizer::compile(BoolExprNodeStack* parentStack)
 
 	checkIndices();
 
+	// Grouping may be performed via hashing instead of sorting the input stream,
+	// unless the expected number of groups is too large to fit into memory
+
+	if (rse->flags & RseNode::FLAG_HASH_GROUPING)
+	{
+		bool useHash = (sort && !project);
+
+		if (useHash)
+		{
+			auto groups = rsb->getCardinality();
+			for (auto count = sort->expressions.getCount(); count; count--)
+				groups *= REDUCE_SELECTIVITY_FACTOR_EQUALITY;
+
+			useHash = (groups <= HashAggregatedStream::maxCapacity());
+		}
+
+		if (useHash)
+			sort = nullptr;
+		else
+			rse->flags &= ~RseNode::FLAG_HASH_GROUPING;
+	}
+
+	SortedStream* sortRsb = nullptr;
+
 	if (project || sort)
 	{
 		// Eliminate any duplicate dbkey streams
@@ -1032,11 +1056,25 @@ RecordSource* Optimizer::compile(BoolExprNodeStack* parentStack)
 
 		// Handle project clause, if present
 		if (project)
-			rsb = generateSort(bedStreams, &keyStreams, rsb, project, favorFirstRows(), true);
+			rsb = sortRsb = generateSort(bedStreams, &keyStreams, rsb, project, favorFirstRows(), true);
 
 		// Handle sort clause if present
 		if (sort)
-			rsb = generateSort(bedStreams, &keyStreams, rsb, sort, favorFirstRows(), false);
+			rsb = sortRsb = generateSort(bedStreams, &keyStreams, rsb, sort, favorFirstRows(), false);
+	}
+
+	// If the number of rows to be returned from the sort is limited, let the sort know it.
+	// Only simple values are considered, as they're going to be evaluated twice.
+
+	const auto isSimpleValue = [](const ValueExprNode* node)
+	{
+		return !node || nodeIs<LiteralNode>(node) || nodeIs<ParameterNode>(node);
+	};
+
+	if (sortRsb && rse->rse_first &&
+		isSimpleValue(rse->rse_first) && isSimpleValue(rse->rse_skip))
+	{
+		sortRsb->setLimit(rse->rse_first, rse->rse_skip);
 	}
 
 	// Add invariant booleans, if any. They should be evaluated before
@@ -1765,6 +1803,7 @@ void Optimizer::checkSorts()
 			{
 				setDirection(project, group);
 				project = rse->rse_projection = nullptr;
+				aggregate->ordered = true;
 			}
 		}
 
@@ -1795,6 +1834,7 @@ void Optimizer::checkSorts()
 				setDirection(sort, group);
 				setPosition(sort, group, map);
 				sort = rse->rse_sorted = nullptr;
+				aggregate->ordered = true;
 			}
 		}
 	}
@@ -2567,6 +2607,7 @@ RecordSource* Optimizer::generateRetrieval(StreamType stream,
 
 	const string alias = makeAlias(stream);
 	tail->activate();
+	tail->csb_flags &= ~csb_full_scan;
 
 	// Time to find inversions. For each index on the relation
 	// match all unused booleans against the index looking for upper
@@ -2729,6 +2770,9 @@ RecordSource* Optimizer::generateRetrieval(StreamType stream,
 
 			if (boolean)
 				csb->csb_rpt[stream].csb_flags |= csb_unmatched;
+
+			if (dbkeyRanges.isEmpty())
+				tail->csb_flags |= csb_full_scan;
 		}
 	}
 
@@ -2765,8 +2809,15 @@ RecordSource* Optimizer::applyLocalBoolean(RecordSource* rsb,
 
 RecordSource* Optimizer::applyResidualBoolean(RecordSource* rsb)
 {
-	BoolExprNode* boolean = nullptr;
 	double selectivity = MAXIMUM_SELECTIVITY;
+	const auto boolean = composeResidualBoolean(&selectivity);
+
+	return boolean ? FB_NEW_POOL(getPool()) FilteredStream(csb, rsb, boolean, selectivity) : rsb;
+}
+
+BoolExprNode* Optimizer::composeResidualBoolean(double* selectivity)
+{
+	BoolExprNode* boolean = nullptr;
 
 	for (auto iter = getBaseConjuncts(); iter.hasData(); ++iter)
 	{
@@ -2775,12 +2826,12 @@ RecordSource* Optimizer::applyResidualBoolean(RecordSource* rsb)
 			compose(getPool(), &boolean, iter);
 			iter |= CONJUNCT_USED;
 
-			if (!(iter & (CONJUNCT_MATCHED | CONJUNCT_JOINED)))
-				selectivity *= getSelectivity(*iter);
+			if (!(iter & (CONJUNCT_MATCHED | CONJUNCT_JOINED)) && selectivity)
+				*selectivity *= getSelectivity(*iter);
 		}
 	}
 
-	return boolean ? FB_NEW_POOL(getPool()) FilteredStream(csb, rsb, boolean, selectivity) : rsb;
+	return boolean;
 }
 
 
@@ -503,6 +503,7 @@ public:
 									const StreamList& streams,
 									ConjunctIterator& iter);
 	RecordSource* applyResidualBoolean(RecordSource* rsb);
+	BoolExprNode* composeResidualBoolean(double* selectivity = nullptr);
 
 	BoolExprNode* composeBoolean(ConjunctIterator& iter,
 								 double* selectivity = nullptr);
@@ -695,6 +696,7 @@ protected:
 	bool checkIndexExpression(const index_desc* idx, ValueExprNode* node) const;
 	InversionNode* composeInversion(InversionNode* node1, InversionNode* node2,
 		InversionNode::Type node_type) const;
+	bool estimateSelectivity(const IndexScratch& indexScratch, double& selectivity) const;
 	const Firebird::string& getAlias();
 	void getInversionCandidates(InversionCandidateList& inversions,
 		IndexScratchList& indexScratches, unsigned scope) const;
@@ -861,6 +863,19 @@ class InnerJoin : private Firebird::PermanentStorage
 
 	typedef Firebird::HalfStaticArray<JoinedStreamInfo, OPT_STATIC_ITEMS> JoinedStreamList;
 
+	// Best join order found for a subset of streams (see findOptimalOrder)
+	struct JoinSubset
+	{
+		double cost = 0;			// total cost of joining the subset
+		double cardinality = 0;		// total cardinality of the subset
+		FB_UINT64 prior = 0;		// subset joined before the last stream
+		unsigned last = 0;			// last joined stream
+	};
+
+	// Exhaustive search limits, the greedy search is used beyond them
+	static const unsigned MAX_DP_STREAMS = 24;
+	static const unsigned MAX_DP_ESTIMATIONS = 10000;
+
 public:
 	InnerJoin(thread_db* tdbb, Optimizer* opt,
 			  const StreamList& streams,
@@ -880,6 +895,7 @@ protected:
 	void estimateCost(unsigned position, const StreamInfo* stream, double& cost, double& cardinality);
 	void findBestOrder(unsigned position, StreamInfo* stream,
 		IndexedRelationships& processList, double cost, double cardinality);
+	bool findOptimalOrder();
 	void getIndexedRelationships(StreamInfo* testStream);
 	StreamInfo* getStreamInfo(StreamType stream);
 #ifdef OPT_DEBUG
@@ -923,6 +939,7 @@ public:
 
 private:
 	RecordSource* process(const JoinType joinType);
+	RecordSource* generateHashJoin(const JoinType joinType, BoolExprNode* boolean, bool ordered);
 
 	thread_db* const tdbb;
 	Optimizer* const optimizer;
@@ -26,6 +26,7 @@
 #include "../jrd/jrd.h"
 #include "../jrd/cmp_proto.h"
 #include "../jrd/RecordSourceNodes.h"
+#include "../dsql/BoolNodes.h"
 
 #include "../jrd/optimizer/Optimizer.h"
 
@@ -149,6 +150,8 @@ RecordSource* OuterJoin::process(const JoinType joinType)
 	// Generate record sources for the sub-streams.
 	// For the outer sub-stream we also will get a boolean back.
 
+	const auto sortNode = sortPtr ? *sortPtr : nullptr;
+
 	if (outerStream.number != INVALID_STREAM)
 	{
 		fb_assert(!outerStream.rsb);
@@ -176,6 +179,16 @@ RecordSource* OuterJoin::process(const JoinType joinType)
 	if (innerStream.number != INVALID_STREAM)
 	{
 		fb_assert(!innerStream.rsb);
+
+		// Check whether the inner stream is better to be hash-joined
+
+		// If the sort node was utilized by the outer stream, its order must be preserved
+
+		const bool ordered = (sortNode && !*sortPtr);
+
+		if (const auto hashJoinRsb = generateHashJoin(joinType, boolean, ordered))
+			return hashJoinRsb;
+
 		// AB: the sort clause for the inner stream of an OUTER JOIN
 		//	   should never be used for the index retrieval
 		innerStream.rsb = optimizer->generateRetrieval(innerStream.number, nullptr,
@@ -194,3 +207,183 @@ RecordSource* OuterJoin::process(const JoinType joinType)
 };
 
 
+// Try generating a hash join for the given outer sub-stream and the base inner stream.
+// This is possible if the inner stream cannot be retrieved via an index lookup
+// driven by the outer sub-stream, but there are some equality conjuncts linking them.
+// The inner stream is then filtered by its local booleans and hashed once,
+// instead of being re-scanned for every outer record. Returns nullptr if the
+// nested loop join is considered to be a better option.
+
+RecordSource* OuterJoin::generateHashJoin(const JoinType joinType, BoolExprNode* boolean, bool ordered)
+{
+	auto& outerStream = joinStreams[0];
+	auto& innerStream = joinStreams[1];
+
+	fb_assert(outerStream.rsb && !innerStream.rsb);
+
+	// Hashing is useless if we need just the first rows, nested loop is better for that
+
+	if (optimizer->favorFirstRows())
+		return nullptr;
+
+	const auto stream = innerStream.number;
+	const auto tail = &csb->csb_rpt[stream];
+	const auto relation = tail->csb_relation;
+
+	if (!relation || relation->rel_file || relation->isVirtual())
+		return nullptr;
+
+	// If the table looks like empty during preparation time, we cannot be sure about
+	// its real cardinality during execution, so better avoid hash joining
+
+	const auto streamCardinality = tail->csb_cardinality;
+
+	if (streamCardinality <= MINIMUM_CARDINALITY)
+		return nullptr;
+
+	const bool innerFlag = (joinType == OUTER_JOIN);
+
+	StreamList outerStreams;
+	outerStream.rsb->findUsedStreams(outerStreams);
+
+	const auto outerCardinality = outerStream.rsb->getCardinality();
+
+	// Find the equality conjuncts where one side refers to the inner stream only
+	// while the other side refers to the outer streams only
+
+	HalfStaticArray<BoolExprNode*, OPT_STATIC_ITEMS> equiMatches;
+	double matchSelectivity = MAXIMUM_SELECTIVITY;
+
+	tail->activate();
+
+	for (auto iter = optimizer->getBaseConjuncts(); iter.hasData(); ++iter)
+	{
+		if ((iter & Optimizer::CONJUNCT_USED) ||
+			(iter->nodFlags & ExprNode::FLAG_RESIDUAL) ||
+			!iter->computable(csb, INVALID_STREAM, false) ||
+			!optimizer->checkEquiJoin(*iter))
+		{
+			continue;
+		}
+
+		const auto cmpNode = nodeAs<ComparativeBoolNode>(*iter);
+		fb_assert(cmpNode);
+
+		const auto arg1 = cmpNode->arg1;
+		const auto arg2 = cmpNode->arg2;
+
+		if ((arg1->containsStream(stream, true) &&
+				!arg2->containsStream(stream) && arg2->containsAnyStream(outerStreams)) ||
+			(arg2->containsStream(stream, true) &&
+				!arg1->containsStream(stream) && arg1->containsAnyStream(outerStreams)))
+		{
+			equiMatches.add(*iter);
+			matchSelectivity *= Optimizer::getSelectivity(*iter);
+		}
+	}
+
+	if (equiMatches.isEmpty())
+	{
+		tail->deactivate();
+		return nullptr;
+	}
+
+	// Calculate the nested loop cost. If the inner stream is retrievable
+	// via an index lookup driven by the outer streams, prefer the nested loop.
+
+	double loopCost = 0;
+
+	{	// scope
+		Retrieval retrieval(tdbb, optimizer, stream, false, innerFlag, nullptr, true);
+		const auto candidate = retrieval.getInversion();
+
+		if (candidate->dependencies || candidate->condition)
+		{
+			tail->deactivate();
+			return nullptr;
+		}
+
+		loopCost = candidate->cost * outerCardinality;
+	}
+
+	// Calculate the hashing cost. It consists of the following parts:
+	//  - inner stream retrieval (performed once, independently of the outer streams)
+	//  - copying rows into the hash table (including hash calculation)
+	//  - probing the hash table and copying the matched rows
+
+	double hashCost = 0, hashCardinality = 0;
+
+	{	// scope
+		StreamStateHolder stateHolder(csb, outerStreams);
+		stateHolder.deactivate();
+
+		Retrieval retrieval(tdbb, optimizer, stream, false, innerFlag, nullptr, true);
+		const auto candidate = retrieval.getInversion();
+
+		if (candidate->condition)
+		{
+			tail->deactivate();
+			return nullptr;
+		}
+
+		hashCardinality = streamCardinality * candidate->selectivity;
+		hashCost = candidate->cost +
+			// hashing cost
+			hashCardinality * (COST_FACTOR_MEMCOPY + COST_FACTOR_HASHING) +
+			// probing + copying cost
+			outerCardinality * (COST_FACTOR_HASHING +
+				hashCardinality * matchSelectivity * COST_FACTOR_MEMCOPY);
+	}
+
+	tail->deactivate();
+
+	if (hashCost > loopCost || hashCardinality > HashJoin::maxCapacity())
+		return nullptr;
+
+	// Generate the inner stream retrieval while the outer streams are inactive,
+	// thus applying only the booleans local to the inner stream
+
+	{	// scope
+		StreamStateHolder stateHolder(csb, outerStreams);
+		stateHolder.deactivate();
+
+		innerStream.rsb = optimizer->generateRetrieval(stream, nullptr, false, innerFlag);
+	}
+
+	// Collect the keys to join on
+
+	NestValueArray* keys[2];
+	keys[0] = FB_NEW_POOL(getPool()) NestValueArray(getPool());
+	keys[1] = FB_NEW_POOL(getPool()) NestValueArray(getPool());
+
+	for (const auto match : equiMatches)
+	{
+		NestConst<ValueExprNode> node1;
+		NestConst<ValueExprNode> node2;
+
+		if (!optimizer->getEquiJoinKeys(match, &node1, &node2))
+			fb_assert(false);
+
+		if (!node2->containsStream(stream))
+		{
+			fb_assert(node1->containsStream(stream));
+
+			// Swap the sides
+			std::swap(node1, node2);
+		}
+
+		keys[0]->add(node1);
+		keys[1]->add(node2);
+	}
+
+	// All the remaining booleans (including the equality ones, as hash values may collide)
+	// are checked for every inner record matching the hash value of the outer record
+
+	const auto residual = optimizer->composeResidualBoolean();
+	fb_assert(residual);
+
+	return FB_NEW_POOL(getPool())
+		HashJoin(tdbb, csb, joinType, outerStream.rsb, innerStream.rsb, keys, boolean, residual, ordered);
+}
+
+
@@ -232,6 +232,75 @@ InversionNode* Retrieval::composeInversion(InversionNode* node1,
 	return FB_NEW_POOL(getPool()) InversionNode(node_type, node1, node2);
 }
 
+//
+// Estimate the selectivity of a single segment index scan by looking
+// at the actual key distribution inside the index. This is possible
+// only if the bounds are known at compile time, but it catches the
+// skewed data that is not reflected by the stored (average) selectivity.
+//
+
+bool Retrieval::estimateSelectivity(const IndexScratch& indexScratch, double& selectivity) const
+{
+	const auto idx = indexScratch.index;
+
+	if (idx->idx_count != 1 || (idx->idx_flags & (idx_descending | idx_condition)) ||
+		indexScratch.usePartialKey)
+	{
+		return false;
+	}
+
+	const auto& segment = indexScratch.segments[0];
+
+	switch (segment.scanType)
+	{
+		case segmentScanEqual:
+		case segmentScanBetween:
+		case segmentScanLess:
+		case segmentScanGreater:
+			break;
+
+		default:
+			return false;
+	}
+
+	const dsc* lowerDesc = nullptr;
+	const dsc* upperDesc = nullptr;
+
+	if (segment.lowerValue)
+	{
+		const auto literal = nodeAs<LiteralNode>(segment.lowerValue);
+
+		if (!literal)
+			return false;
+
+		lowerDesc = &literal->litDesc;
+	}
+
+	if (segment.upperValue)
+	{
+		const auto literal = nodeAs<LiteralNode>(segment.upperValue);
+
+		if (!literal)
+			return false;
+
+		upperDesc = &literal->litDesc;
+	}
+
+	const double count =
+		BTR_estimate_range(tdbb, relation, idx, lowerDesc, upperDesc, segment.scale);
+
+	if (count < 0)
+		return false;
+
+	const double cardinality = csb->csb_rpt[stream].csb_cardinality;
+	fb_assert(cardinality);
+
+	selectivity = MAX(count, MINIMUM_CARDINALITY) / cardinality;
+	selectivity = MIN(selectivity, MAXIMUM_SELECTIVITY);
+
+	return true;
+}
+
 const string& Retrieval::getAlias()
 {
 	if (alias.isEmpty())
@@ -1093,6 +1162,10 @@ void Retrieval::getInversionCandidates(InversionCandidateList& inversions,
 
 			if (scratch.scopeCandidate)
 			{
+				// Prefer the actual key distribution over the average selectivity
+				if (!unique && !listCount)
+					estimateSelectivity(scratch, scratch.selectivity);
+
 				double selectivity = scratch.selectivity;
 				fb_assert(selectivity);
 
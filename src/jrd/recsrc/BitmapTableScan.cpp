@@ -110,7 +110,8 @@ bool BitmapTableScan::internalGetRecord(thread_db* tdbb) const
 		{
 			rpb->rpb_number.setValue(bitmap->current());
 
-			if (VIO_get(tdbb, rpb, request->req_transaction, request->req_pool))
+			if (VIO_get(tdbb, rpb, request->req_transaction, request->req_pool) &&
+				checkJoinFilter(tdbb))
 			{
 				rpb->rpb_number.setValid(true);
 				return true;
@@ -21,6 +21,7 @@
 #include "../jrd/jrd.h"
 #include "../jrd/req.h"
 #include "../dsql/BoolNodes.h"
+#include "../dsql/ExprNodes.h"
 #include "../jrd/cmp_proto.h"
 #include "../jrd/evl_proto.h"
 #include "../jrd/mov_proto.h"
@@ -36,12 +37,101 @@ using namespace Jrd;
 // Data access: predicate driven filter
 // ------------------------------------
 
+namespace
+{
+	// Data types which are stored inside the record exactly as FieldNode returns them
+	// and which comparison does not depend on the collation
+	bool isFastType(const dsc& desc)
+	{
+		switch (desc.dsc_dtype)
+		{
+			case dtype_short:
+			case dtype_long:
+			case dtype_int64:
+			case dtype_int128:
+			case dtype_real:
+			case dtype_double:
+			case dtype_dec64:
+			case dtype_dec128:
+			case dtype_sql_date:
+			case dtype_sql_time:
+			case dtype_timestamp:
+			case dtype_boolean:
+				return true;
+		}
+
+		return false;
+	}
+
+	bool getInteger(const dsc* desc, SINT64& value)
+	{
+		switch (desc->dsc_dtype)
+		{
+			case dtype_short:
+				value = *(SSHORT*) desc->dsc_address;
+				return true;
+
+			case dtype_long:
+				value = *(SLONG*) desc->dsc_address;
+				return true;
+
+			case dtype_int64:
+				value = *(SINT64*) desc->dsc_address;
+				return true;
+		}
+
+		return false;
+	}
+
+	// Integers and doubles of the same scale are compared natively,
+	// everything else is handled by MOV_compare()
+	int compareValues(thread_db* tdbb, const dsc* desc1, const dsc* desc2)
+	{
+		if (desc1->dsc_scale == desc2->dsc_scale)
+		{
+			SINT64 value1, value2;
+
+			if (getInteger(desc1, value1) && getInteger(desc2, value2))
+				return (value1 > value2) - (value1 < value2);
+
+			if (desc1->dsc_dtype == dtype_double && desc2->dsc_dtype == dtype_double)
+			{
+				const double double1 = *(double*) desc1->dsc_address;
+				const double double2 = *(double*) desc2->dsc_address;
+				return (double1 > double2) - (double1 < double2);
+			}
+		}
+
+		return MOV_compare(tdbb, desc1, desc2);
+	}
+
+	bool isFastValue(const ValueExprNode* node)
+	{
+		return nodeIs<LiteralNode>(node) || nodeIs<ParameterNode>(node);
+	}
+
+	void decompose(BoolExprNode* boolean, HalfStaticArray<BoolExprNode*, OPT_STATIC_ITEMS>& conjuncts)
+	{
+		const auto binaryNode = nodeAs<BinaryBoolNode>(boolean);
+
+		if (binaryNode && binaryNode->blrOp == blr_and)
+		{
+			decompose(binaryNode->arg1, conjuncts);
+			decompose(binaryNode->arg2, conjuncts);
+		}
+		else
+			conjuncts.add(boolean);
+	}
+}
+
 FilteredStream::FilteredStream(CompilerScratch* csb, RecordSource* next,
 							   BoolExprNode* boolean, double selectivity)
 	: RecordSource(csb),
 	  m_next(next),
 	  m_boolean(boolean),
 	  m_anyBoolean(NULL),
+	  m_residual(boolean),
+	  m_predicates(csb->csb_pool),
 	  m_ansiAny(false),
 	  m_ansiAll(false),
 	  m_ansiNot(false)
@@ -57,6 +147,8 @@ FilteredStream::FilteredStream(CompilerScratch* csb, RecordSource* next,
 		cardinality *= selectivity;
 	}
 	m_cardinality = cardinality;
+
+	preparePredicates(csb, boolean);
 }
 
 void FilteredStream::internalOpen(thread_db* tdbb) const
@@ -160,6 +252,29 @@ void FilteredStream::nullRecords(thread_db* tdbb) const
 	m_next->nullRecords(tdbb);
 }
 
+bool FilteredStream::pushJoinFilter(const HashJoin* join, const StreamList& keyStreams)
+{
+	// The filter is better checked below the boolean, if possible
+
+	if (m_next->pushJoinFilter(join, keyStreams))
+		return true;
+
+	if (m_joinFilter || m_anyBoolean)
+		return false;
+
+	StreamList streams;
+	m_next->findUsedStreams(streams);
+
+	for (const auto stream : keyStreams)
+	{
+		if (!streams.exist(stream))
+			return false;
+	}
+
+	m_joinFilter = join;
+	return true;
+}
+
 bool FilteredStream::evaluateBoolean(thread_db* tdbb) const
 {
 	Request* const request = tdbb->getRequest();
@@ -372,8 +487,13 @@ bool FilteredStream::evaluateBoolean(thread_db* tdbb) const
 	bool result = false;
 	while (m_next->getRecord(tdbb))
 	{
-		if (m_boolean->execute(tdbb, request))
+		if (evaluateConjuncts(tdbb, request))
 		{
+			// Skip the records which cannot be matched by the hash join above
+
+			if (m_joinFilter && !m_joinFilter->checkFilter(tdbb))
+				continue;
+
 			result = true;
 			break;
 		}
@@ -387,3 +507,218 @@ bool FilteredStream::evaluateBoolean(thread_db* tdbb) const
 
 	return result;
 }
+
+// Split the boolean into conjuncts and pick the leading ones which can be
+// evaluated without walking the expression tree
+void FilteredStream::preparePredicates(CompilerScratch* csb, BoolExprNode* boolean)
+{
+	HalfStaticArray<BoolExprNode*, OPT_STATIC_ITEMS> conjuncts;
+	decompose(boolean, conjuncts);
+
+	BoolExprNode* residual = nullptr;
+
+	// Once a conjunct needs the generic evaluation, it's done for the rest
+	// of them too, so that the conjuncts are evaluated in their original order
+	// and the same one raises an error (if any) as before
+
+	for (const auto conjunct : conjuncts)
+	{
+		if (residual)
+		{
+			residual = FB_NEW_POOL(csb->csb_pool) BinaryBoolNode(csb->csb_pool, blr_and, residual, conjunct);
+			continue;
+		}
+
+		FastPredicate predicate = {conjunct, nullptr, nullptr, nullptr, 0};
+
+		if (const auto cmpNode = nodeAs<ComparativeBoolNode>(conjunct))
+		{
+			switch (cmpNode->blrOp)
+			{
+				case blr_eql:
+				case blr_neq:
+				case blr_gtr:
+				case blr_geq:
+				case blr_lss:
+				case blr_leq:
+					if (isFastValue(cmpNode->arg2))
+					{
+						predicate.field = nodeAs<FieldNode>(cmpNode->arg1);
+						predicate.value = cmpNode->arg2;
+						predicate.blrOp = cmpNode->blrOp;
+					}
+					else if (isFastValue(cmpNode->arg1))
+					{
+						// Swap the arguments to have the field on the left side
+						static const UCHAR swappedOps[][2] =
+						{
+							{blr_eql, blr_eql}, {blr_neq, blr_neq},
+							{blr_gtr, blr_lss}, {blr_geq, blr_leq},
+							{blr_lss, blr_gtr}, {blr_leq, blr_geq}
+						};
+
+						predicate.field = nodeAs<FieldNode>(cmpNode->arg2);
+						predicate.value = cmpNode->arg1;
+
+						for (const auto& ops : swappedOps)
+						{
+							if (ops[0] == cmpNode->blrOp)
+								predicate.blrOp = ops[1];
+						}
+					}
+					break;
+
+				case blr_between:
+					if (isFastValue(cmpNode->arg2) && isFastValue(cmpNode->arg3))
+					{
+						predicate.field = nodeAs<FieldNode>(cmpNode->arg1);
+						predicate.value = cmpNode->arg2;
+						predicate.upper = cmpNode->arg3;
+						predicate.blrOp = cmpNode->blrOp;
+					}
+					break;
+			}
+		}
+		else if (const auto missingNode = nodeAs<MissingBoolNode>(conjunct))
+		{
+			predicate.field = nodeAs<FieldNode>(missingNode->arg);
+			predicate.blrOp = blr_missing;
+		}
+
+		if (predicate.field && !predicate.field->cursorNumber.has_value())
+			m_predicates.add(predicate);
+		else
+			residual = conjunct;
+	}
+
+	m_residual = residual;
+}
+
+// Evaluate the boolean, the same way BinaryBoolNode does for a chain of ANDs
+bool FilteredStream::evaluateConjuncts(thread_db* tdbb, Request* request) const
+{
+	if (m_predicates.isEmpty())
+		return m_boolean->execute(tdbb, request);
+
+	bool nullFlag = false;
+
+	for (const auto& predicate : m_predicates)
+	{
+		if (!evaluatePredicate(tdbb, request, predicate))
+		{
+			if (!(request->req_flags & req_null))
+				return false;
+
+			nullFlag = true;
+		}
+
+		request->req_flags &= ~req_null;
+	}
+
+	if (m_residual && !m_residual->execute(tdbb, request))
+	{
+		if (!(request->req_flags & req_null))
+			return false;
+
+		nullFlag = true;
+	}
+
+	if (nullFlag)
+	{
+		request->req_flags |= req_null;
+		return false;
+	}
+
+	request->req_flags &= ~req_null;
+	return true;
+}
+
+// Evaluate a single predicate against the record, returning the result the same way
+// the original node does. Whatever is not stored in its final form (old record formats,
+// missing fields) falls back to the original node.
+bool FilteredStream::evaluatePredicate(thread_db* tdbb, Request* request,
+	const FastPredicate& predicate) const
+{
+	const FieldNode* const field = predicate.field;
+	const Record* const record = request->req_rpb[field->fieldStream].rpb_record;
+	const Format* const format = record ? record->getFormat() : nullptr;
+	const USHORT id = field->fieldId;
+
+	if (!format || id >= format->fmt_count ||
+		(field->format && field->format->fmt_version != format->fmt_version))
+	{
+		return predicate.node->execute(tdbb, request);
+	}
+
+	dsc desc = format->fmt_desc[id];
+
+	if (!desc.dsc_address || !isFastType(desc))
+		return predicate.node->execute(tdbb, request);
+
+	request->req_flags &= ~req_null;
+
+	const bool isNull = record->isNull(id);
+
+	if (predicate.blrOp == blr_missing)
+		return isNull;
+
+	const dsc* const value = EVL_expr(tdbb, request, predicate.value);
+
+	if (request->req_flags & req_null)
+	{
+		// BETWEEN may be FALSE even with a NULL bound, leave it to the original node
+		if (predicate.upper && !isNull)
+			return predicate.node->execute(tdbb, request);
+
+		return false;
+	}
+
+	if (isNull)
+	{
+		request->req_flags |= req_null;
+		return false;
+	}
+
+	desc.dsc_address = const_cast<UCHAR*>(record->getData()) + (IPTR) desc.dsc_address;
+
+	const int comparison = compareValues(tdbb, &desc, value);
+
+	switch (predicate.blrOp)
+	{
+		case blr_eql:
+			return comparison == 0;
+
+		case blr_neq:
+			return comparison != 0;
+
+		case blr_gtr:
+			return comparison > 0;
+
+		case blr_geq:
+			return comparison >= 0;
+
+		case blr_lss:
+			return comparison < 0;
+
+		case blr_leq:
+			return comparison <= 0;
+
+		case blr_between:
+			if (comparison < 0)
+				return false;
+			{
+				const dsc* const upper = EVL_expr(tdbb, request, predicate.upper);
+
+				if (request->req_flags & req_null)
+				{
+					request->req_flags &= ~req_null;
+					return predicate.node->execute(tdbb, request);
+				}
+
+				return compareValues(tdbb, &desc, upper) <= 0;
+			}
+	}
+
+	fb_assert(false);
+	return false;
+}
@@ -148,10 +148,13 @@ bool FullTableScan::internalGetRecord(thread_db* tdbb) const
 
 	const RecordNumber* upper = impure->irsb_upper.isValid() ? &impure->irsb_upper : nullptr;
 
-	if (VIO_next_record(tdbb, rpb, request->req_transaction, request->req_pool, DPM_next_all, upper))
+	while (VIO_next_record(tdbb, rpb, request->req_transaction, request->req_pool, DPM_next_all, upper))
 	{
-		rpb->rpb_number.setValid(true);
-		return true;
+		if (checkJoinFilter(tdbb))
+		{
+			rpb->rpb_number.setValid(true);
+			return true;
+		}
 	}
 
 	rpb->rpb_number.setValid(false);
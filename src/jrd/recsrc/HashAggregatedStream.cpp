@@ -0,0 +1,806 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.ibphoenix.com/main.nfs?a=ibphoenix&page=ibp_idpl.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created for the Firebird Open Source RDBMS project.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "firebird.h"
+#include "../common/classes/Aligner.h"
+#include "../common/classes/Hash.h"
+#include "../jrd/jrd.h"
+#include "../jrd/req.h"
+#include "../jrd/intl.h"
+#include "../jrd/align.h"
+#include "../dsql/ExprNodes.h"
+#include "../dsql/AggNodes.h"
+#include "../jrd/evl_proto.h"
+#include "../jrd/mov_proto.h"
+#include "../jrd/intl_proto.h"
+#include "../jrd/vio_proto.h"
+#include "../jrd/optimizer/Optimizer.h"
+
+#include "RecordSource.h"
+
+using namespace Firebird;
+using namespace Jrd;
+
+// --------------------------------
+// Data access: hashed aggregation
+// --------------------------------
+
+static const char* const SCRATCH = "fb_group_";
+
+// Groups which do not fit the memory budget are not rejected, but their input
+// records are spilled into the temporary space and aggregated during the next pass
+static const ULONG MAX_GROUP_MEMORY = 32 * 1024 * 1024;	// 32MB
+static const ULONG MAX_GROUPS = 1024 * 1024;
+
+// Larger tuples make the spilling too expensive, so the sorted aggregation is used instead
+static const ULONG MAX_TUPLE_LENGTH = 8192;
+
+static const ULONG INITIAL_BUCKETS = 1024;
+
+namespace
+{
+	bool isAggregate(const AggNode* aggNode, UCHAR blr)
+	{
+		return aggNode && aggNode->aggInfo.blr == blr;
+	}
+
+	ULONG getKeyLength(thread_db* tdbb, const dsc& desc)
+	{
+		USHORT keyLength = desc.isText() ? desc.getStringLength() : desc.dsc_length;
+
+		if (IS_INTL_DATA(&desc))
+			keyLength = INTL_key_length(tdbb, INTL_INDEX_TYPE(&desc), keyLength);
+		else if (desc.isTime())
+			keyLength = sizeof(ISC_TIME);
+		else if (desc.isTimeStamp())
+			keyLength = sizeof(ISC_TIMESTAMP);
+		else if (desc.dsc_dtype == dtype_dec64)
+			keyLength = Decimal64::getKeyLength();
+		else if (desc.dsc_dtype == dtype_dec128)
+			keyLength = Decimal128::getKeyLength();
+
+		return keyLength;
+	}
+
+	// Store the value in the binary comparable form, the same way HashJoin does
+	void makeKey(thread_db* tdbb, const dsc* desc, ULONG keyLength, UCHAR* keyPtr)
+	{
+		if (desc->isText())
+		{
+			dsc to;
+			to.makeText(keyLength, desc->getTextType(), keyPtr);
+
+			if (IS_INTL_DATA(desc))
+			{
+				// Convert the INTL string into the binary comparable form
+				INTL_string_to_key(tdbb, INTL_INDEX_TYPE(desc), desc, &to, INTL_KEY_UNIQUE);
+			}
+			else
+			{
+				// This call ensures that the padding bytes are appended
+				MOV_move(tdbb, const_cast<dsc*>(desc), &to);
+			}
+		}
+		else
+		{
+			const auto data = desc->dsc_address;
+
+			if (desc->isDecFloat())
+			{
+				// Values inside the key are not aligned,
+				// so ensure we satisfy our platform's alignment rules
+				OutAligner<ULONG, MAX_DEC_KEY_LONGS> key(keyPtr, keyLength);
+
+				if (desc->dsc_dtype == dtype_dec64)
+					((Decimal64*) data)->makeKey(key);
+				else if (desc->dsc_dtype == dtype_dec128)
+					((Decimal128*) data)->makeKey(key);
+				else
+					fb_assert(false);
+			}
+			else if ((desc->dsc_dtype == dtype_real && *(float*) data == 0) ||
+				(desc->dsc_dtype == dtype_double && *(double*) data == 0))
+			{
+				memset(keyPtr, 0, keyLength); // positive zero in binary
+			}
+			else
+			{
+				// Note: for date/time with time zone, we copy only the UTC part
+				fb_assert(keyLength <= desc->dsc_length);
+				memcpy(keyPtr, data, keyLength);
+			}
+		}
+	}
+}
+
+
+// Hash table of the aggregated groups. Every group is stored as a header
+// followed by the tuple (group key plus values) and the aggregate states.
+
+class HashAggregatedStream::GroupTable : public PermanentStorage
+{
+	struct Header
+	{
+		ULONG next;
+		ULONG hash;
+	};
+
+public:
+	static const ULONG END = MAX_ULONG;
+
+	GroupTable(MemoryPool& pool, ULONG keyLength, ULONG tupleLength, ULONG groupLength)
+		: PermanentStorage(pool),
+		  m_buckets(pool), m_data(pool), m_tuple(pool),
+		  m_keyLength(keyLength), m_tupleLength(tupleLength),
+		  m_entryLength(FB_ALIGN(sizeof(Header) + groupLength, sizeof(FB_UINT64))),
+		  m_count(0), m_current(END)
+	{
+		m_capacity = MIN(MAX_GROUP_MEMORY / m_entryLength, MAX_GROUPS);
+		m_capacity = MAX(m_capacity, 1);
+
+		m_tuple.resize(FB_ALIGN(tupleLength, sizeof(FB_UINT64)) / sizeof(FB_UINT64));
+		m_buckets.resize(INITIAL_BUCKETS, END);
+	}
+
+	// Scratch buffer for the current input tuple
+	UCHAR* getScratch()
+	{
+		return reinterpret_cast<UCHAR*>(m_tuple.begin());
+	}
+
+	ULONG getCount() const
+	{
+		return m_count;
+	}
+
+	ULONG getCurrent() const
+	{
+		return m_current;
+	}
+
+	void setCurrent(ULONG group)
+	{
+		m_current = group;
+	}
+
+	UCHAR* getTuple(ULONG group)
+	{
+		fb_assert(group < m_count);
+		return getEntry(group) + sizeof(Header);
+	}
+
+	UCHAR* getStates(ULONG group)
+	{
+		return getTuple(group) + m_tupleLength;
+	}
+
+	ULONG find(ULONG hash, const UCHAR* key) const
+	{
+		const ULONG mask = m_buckets.getCount() - 1;
+
+		for (ULONG group = m_buckets[hash & mask]; group != END;)
+		{
+			const UCHAR* const entry = getEntry(group);
+			const Header* const header = reinterpret_cast<const Header*>(entry);
+
+			if (header->hash == hash && !memcmp(entry + sizeof(Header), key, m_keyLength))
+				return group;
+
+			group = header->next;
+		}
+
+		return END;
+	}
+
+	ULONG add(ULONG hash, const UCHAR* tuple)
+	{
+		if (m_count >= m_capacity)
+			return END;
+
+		const ULONG group = m_count++;
+		m_data.resize(m_count * (m_entryLength / sizeof(FB_UINT64)));
+
+		if (m_count > m_buckets.getCount())
+			rehash();
+
+		const ULONG mask = m_buckets.getCount() - 1;
+
+		UCHAR* const entry = getEntry(group);
+		Header* const header = reinterpret_cast<Header*>(entry);
+		header->hash = hash;
+		header->next = m_buckets[hash & mask];
+		m_buckets[hash & mask] = group;
+
+		memcpy(entry + sizeof(Header), tuple, m_tupleLength);
+
+		return group;
+	}
+
+	void clear()
+	{
+		m_count = 0;
+		m_current = END;
+		m_data.shrink(0);
+		m_buckets.shrink(0);
+		m_buckets.resize(INITIAL_BUCKETS, END);
+	}
+
+private:
+	UCHAR* getEntry(ULONG group)
+	{
+		return reinterpret_cast<UCHAR*>(m_data.begin()) + (FB_SIZE_T) group * m_entryLength;
+	}
+
+	const UCHAR* getEntry(ULONG group) const
+	{
+		return reinterpret_cast<const UCHAR*>(m_data.begin()) + (FB_SIZE_T) group * m_entryLength;
+	}
+
+	void rehash()
+	{
+		const ULONG size = m_buckets.getCount() * 2;
+
+		m_buckets.shrink(0);
+		m_buckets.resize(size, END);
+
+		for (ULONG group = 0; group < m_count - 1; group++)
+		{
+			Header* const header = reinterpret_cast<Header*>(getEntry(group));
+			const ULONG slot = header->hash & (size - 1);
+			header->next = m_buckets[slot];
+			m_buckets[slot] = group;
+		}
+	}
+
+	Array<ULONG> m_buckets;
+	Array<FB_UINT64> m_data;
+	Array<FB_UINT64> m_tuple;
+	const ULONG m_keyLength;
+	const ULONG m_tupleLength;
+	const ULONG m_entryLength;
+	ULONG m_capacity;
+	ULONG m_count;
+	ULONG m_current;			// group whose aggregate states are loaded into the request
+};
+
+
+HashAggregatedStream::HashAggregatedStream(thread_db* tdbb, CompilerScratch* csb, StreamType stream,
+			NestValueArray* group, MapNode* map, RecordSource* next)
+	: RecordStream(csb, stream),
+	  m_next(next),
+	  m_group(group),
+	  m_map(map),
+	  m_keyLengths(csb->csb_pool),
+	  m_items(csb->csb_pool),
+	  m_mappings(csb->csb_pool),
+	  m_aggregates(csb->csb_pool),
+	  m_keyLength(0)
+{
+	fb_assert(m_next && m_group && m_map);
+
+	m_impure = csb->allocImpure<Impure>();
+
+	m_cardinality = next->getCardinality();
+	for (auto count = group->getCount(); count; count--)
+		m_cardinality *= REDUCE_SELECTIVITY_FACTOR_EQUALITY;
+
+	// Every group key is prefixed with the null flag
+
+	for (auto& node : *group)
+	{
+		dsc desc;
+		node->getDesc(tdbb, csb, &desc);
+
+		const ULONG keyLength = getKeyLength(tdbb, desc);
+		m_keyLengths.add(keyLength);
+		m_keyLength += 1 + keyLength;
+	}
+
+	ULONG offset = m_keyLength;
+
+	NestConst<ValueExprNode>* const sourceEnd = map->sourceList.end();
+
+	for (NestConst<ValueExprNode>* source = map->sourceList.begin(),
+			*target = map->targetList.begin();
+		 source != sourceEnd;
+		 ++source, ++target)
+	{
+		AggNode* const aggNode = nodeAs<AggNode>(*source);
+
+		Mapping mapping;
+		mapping.target = *target;
+		mapping.aggNode = aggNode;
+		mapping.item = NO_ITEM;
+
+		ValueExprNode* const value = aggNode ? aggNode->arg.getObject() : source->getObject();
+
+		if (value)
+		{
+			Item item;
+			item.node = value;
+			item.desc.clear();
+
+			// COUNT needs to know only whether its argument is NULL
+			if (!isAggregate(mapping.aggNode, blr_agg_count2))
+			{
+				value->getDesc(tdbb, csb, &item.desc);
+
+				offset = FB_ALIGN(offset, type_alignments[item.desc.dsc_dtype]);
+				item.desc.dsc_address = (UCHAR*)(IPTR) offset;
+				offset += item.desc.dsc_length;
+			}
+
+			item.nullOffset = offset++;
+
+			mapping.item = m_items.getCount();
+			m_items.add(item);
+		}
+
+		if (mapping.aggNode)
+			m_aggregates.add(mapping.aggNode);
+
+		m_mappings.add(mapping);
+	}
+
+	m_tupleLength = FB_ALIGN(offset, sizeof(FB_UINT64));
+	m_groupLength = m_tupleLength + m_aggregates.getCount() * sizeof(impure_value_ex);
+}
+
+bool HashAggregatedStream::isSupported(thread_db* tdbb, CompilerScratch* csb,
+	NestValueArray* group, MapNode* map)
+{
+	if (!group || group->isEmpty() || !map)
+		return false;
+
+	const auto isStorable = [](const dsc& desc)
+	{
+		return !desc.isBlob() && desc.dsc_dtype != dtype_array &&
+			desc.dsc_dtype != dtype_cstring && desc.dsc_dtype != dtype_dbkey &&
+			desc.dsc_dtype != dtype_unknown;
+	};
+
+	ULONG length = 0;
+
+	for (auto& node : *group)
+	{
+		dsc desc;
+		node->getDesc(tdbb, csb, &desc);
+
+		if (!isStorable(desc))
+			return false;
+
+		length += 1 + getKeyLength(tdbb, desc);
+	}
+
+	for (auto& source : map->sourceList)
+	{
+		ValueExprNode* value = source;
+
+		if (const auto aggNode = nodeAs<AggNode>(source))
+		{
+			// Only the aggregates which state is kept entirely inside their impure area
+			// may be switched between groups. DISTINCT requires a sort per group.
+
+			if (aggNode->distinct || aggNode->indexed)
+				return false;
+
+			if (isAggregate(aggNode, blr_agg_count2))
+			{
+				length++;
+				continue;
+			}
+
+			const bool isMinMax = isAggregate(aggNode, blr_agg_min) || isAggregate(aggNode, blr_agg_max);
+
+			if (!isMinMax && !isAggregate(aggNode, blr_agg_total) &&
+				!isAggregate(aggNode, blr_agg_average))
+			{
+				return false;
+			}
+
+			value = aggNode->arg;
+			fb_assert(value);
+
+			length += sizeof(impure_value_ex);
+
+			// MIN/MAX of strings keep the value outside the impure area
+			if (isMinMax)
+			{
+				dsc desc;
+				value->getDesc(tdbb, csb, &desc);
+
+				if (desc.isText() || desc.dsc_dtype == dtype_cstring)
+					return false;
+			}
+		}
+
+		dsc desc;
+		value->getDesc(tdbb, csb, &desc);
+
+		if (!isStorable(desc))
+			return false;
+
+		length += desc.dsc_length + 1 + sizeof(FB_UINT64);
+	}
+
+	return length <= MAX_TUPLE_LENGTH;
+}
+
+unsigned HashAggregatedStream::maxCapacity()
+{
+	// Beyond this number of groups the input gets spilled
+	// and re-read, so the sorted aggregation is cheaper
+	return MAX_GROUPS;
+}
+
+void HashAggregatedStream::internalOpen(thread_db* tdbb) const
+{
+	Request* const request = tdbb->getRequest();
+	Impure* const impure = request->getImpure<Impure>(m_impure);
+
+	impure->irsb_flags = irsb_open;
+	impure->irsb_state = STATE_INPUT;
+	impure->irsb_position = 0;
+
+	releaseSpill(impure);
+
+	if (!impure->irsb_table)
+	{
+		MemoryPool& pool = *tdbb->getDefaultPool();
+		impure->irsb_table = FB_NEW_POOL(pool) GroupTable(pool, m_keyLength, m_tupleLength, m_groupLength);
+	}
+	else
+		impure->irsb_table->clear();
+
+	VIO_record(tdbb, &request->req_rpb[m_stream], m_format, tdbb->getDefaultPool());
+
+	m_next->open(tdbb);
+}
+
+void HashAggregatedStream::close(thread_db* tdbb) const
+{
+	Request* const request = tdbb->getRequest();
+
+	invalidateRecords(request);
+
+	Impure* const impure = request->getImpure<Impure>(m_impure);
+
+	if (impure->irsb_flags & irsb_open)
+	{
+		impure->irsb_flags &= ~irsb_open;
+
+		delete impure->irsb_table;
+		impure->irsb_table = nullptr;
+
+		releaseSpill(impure);
+
+		m_next->close(tdbb);
+	}
+}
+
+bool HashAggregatedStream::internalGetRecord(thread_db* tdbb) const
+{
+	JRD_reschedule(tdbb);
+
+	Request* const request = tdbb->getRequest();
+	record_param* const rpb = &request->req_rpb[m_stream];
+	Impure* const impure = request->getImpure<Impure>(m_impure);
+
+	if (!(impure->irsb_flags & irsb_open))
+	{
+		rpb->rpb_number.setValid(false);
+		return false;
+	}
+
+	GroupTable* const table = impure->irsb_table;
+
+	while (true)
+	{
+		switch (impure->irsb_state)
+		{
+			case STATE_INPUT:
+				while (m_next->getRecord(tdbb))
+				{
+					makeTuple(tdbb, request, table->getScratch());
+					processTuple(tdbb, request, impure, table->getScratch());
+				}
+				break;
+
+			case STATE_SPILLED:
+				for (; impure->irsb_position < impure->irsb_input_count; impure->irsb_position++)
+				{
+					JRD_reschedule(tdbb);
+
+					impure->irsb_input->read((offset_t) impure->irsb_position * m_tupleLength,
+						table->getScratch(), m_tupleLength);
+					processTuple(tdbb, request, impure, table->getScratch());
+				}
+
+				delete impure->irsb_input;
+				impure->irsb_input = nullptr;
+				impure->irsb_input_count = 0;
+				break;
+
+			case STATE_OUTPUT:
+				if (impure->irsb_position < table->getCount())
+				{
+					outputGroup(tdbb, request, impure->irsb_position++);
+					rpb->rpb_number.setValid(true);
+					return true;
+				}
+
+				table->clear();
+
+				if (impure->irsb_spill_count)
+				{
+					// Aggregate the spilled records as a brand new input
+
+					impure->irsb_input = impure->irsb_spill;
+					impure->irsb_input_count = impure->irsb_spill_count;
+					impure->irsb_spill = nullptr;
+					impure->irsb_spill_count = 0;
+					impure->irsb_position = 0;
+					impure->irsb_state = STATE_SPILLED;
+					continue;
+				}
+
+				impure->irsb_state = STATE_EOF;
+				continue;
+
+			case STATE_EOF:
+				rpb->rpb_number.setValid(false);
+				return false;
+		}
+
+		// The whole input is aggregated, start returning the groups
+
+		if (table->getCurrent() != GroupTable::END)
+		{
+			saveStates(request, table->getStates(table->getCurrent()));
+			table->setCurrent(GroupTable::END);
+		}
+
+		impure->irsb_position = 0;
+		impure->irsb_state = STATE_OUTPUT;
+	}
+}
+
+bool HashAggregatedStream::refetchRecord(thread_db* tdbb) const
+{
+	return m_next->refetchRecord(tdbb);
+}
+
+WriteLockResult HashAggregatedStream::lockRecord(thread_db* /*tdbb*/) const
+{
+	status_exception::raise(Arg::Gds(isc_record_lock_not_supp));
+}
+
+void HashAggregatedStream::getLegacyPlan(thread_db* tdbb, string& plan, unsigned level) const
+{
+	m_next->getLegacyPlan(tdbb, plan, level);
+}
+
+void HashAggregatedStream::internalGetPlan(thread_db* tdbb, PlanEntry& planEntry, unsigned level, bool recurse) const
+{
+	planEntry.className = "HashAggregatedStream";
+
+	planEntry.lines.add().text = "Hash Aggregate";
+	printOptInfo(planEntry.lines);
+
+	if (recurse)
+	{
+		++level;
+		m_next->getPlan(tdbb, planEntry.children.add(), level, recurse);
+	}
+}
+
+void HashAggregatedStream::markRecursive()
+{
+	m_next->markRecursive();
+}
+
+void HashAggregatedStream::invalidateRecords(Request* request) const
+{
+	m_next->invalidateRecords(request);
+}
+
+void HashAggregatedStream::findUsedStreams(StreamList& streams, bool expandAll) const
+{
+	RecordStream::findUsedStreams(streams);
+
+	if (expandAll)
+		m_next->findUsedStreams(streams, true);
+}
+
+// Evaluate the group key and the values of the current input record
+void HashAggregatedStream::makeTuple(thread_db* tdbb, Request* request, UCHAR* tuple) const
+{
+	memset(tuple, 0, m_tupleLength);
+
+	UCHAR* keyPtr = tuple;
+
+	for (FB_SIZE_T i = 0; i < m_group->getCount(); i++)
+	{
+		const dsc* const desc = EVL_expr(tdbb, request, (*m_group)[i]);
+		const ULONG keyLength = m_keyLengths[i];
+
+		if (desc && !(request->req_flags & req_null))
+		{
+			*keyPtr = 1;
+			makeKey(tdbb, desc, keyLength, keyPtr + 1);
+		}
+
+		keyPtr += 1 + keyLength;
+	}
+
+	fb_assert(keyPtr - tuple == m_keyLength);
+
+	for (const auto& item : m_items)
+	{
+		dsc* const desc = EVL_expr(tdbb, request, item.node);
+
+		if (!desc || (request->req_flags & req_null))
+			tuple[item.nullOffset] = 1;
+		else if (item.desc.dsc_dtype)
+		{
+			dsc to = item.desc;
+			to.dsc_address = tuple + (IPTR) item.desc.dsc_address;
+			MOV_move(tdbb, desc, &to);
+		}
+	}
+}
+
+// Accumulate the tuple into its group or spill it if the group cannot be created
+void HashAggregatedStream::processTuple(thread_db* tdbb, Request* request, Impure* impure,
+	const UCHAR* tuple) const
+{
+	GroupTable* const table = impure->irsb_table;
+
+	const ULONG hash = InternalHash::hash(m_keyLength, tuple);
+	ULONG group = table->find(hash, tuple);
+
+	if (group == GroupTable::END)
+	{
+		group = table->add(hash, tuple);
+
+		if (group == GroupTable::END)
+		{
+			// The table is full, postpone this record till the next pass
+
+			if (!impure->irsb_spill)
+			{
+				MemoryPool& pool = *getDefaultMemoryPool();
+				impure->irsb_spill = FB_NEW_POOL(pool) TempSpace(pool, SCRATCH, false);
+			}
+
+			impure->irsb_spill->write((offset_t) impure->irsb_spill_count * m_tupleLength,
+				tuple, m_tupleLength);
+			impure->irsb_spill_count++;
+			return;
+		}
+
+		if (table->getCurrent() != GroupTable::END)
+			saveStates(request, table->getStates(table->getCurrent()));
+
+		for (const auto aggNode : m_aggregates)
+			aggNode->aggInit(tdbb, request);
+
+		table->setCurrent(group);
+	}
+	else if (group != table->getCurrent())
+	{
+		if (table->getCurrent() != GroupTable::END)
+			saveStates(request, table->getStates(table->getCurrent()));
+
+		loadStates(request, table->getStates(group));
+		table->setCurrent(group);
+	}
+
+	for (const auto& mapping : m_mappings)
+	{
+		if (!mapping.aggNode)
+			continue;
+
+		if (mapping.item == NO_ITEM)
+		{
+			mapping.aggNode->aggPass(tdbb, request, nullptr);
+			continue;
+		}
+
+		const Item& item = m_items[mapping.item];
+
+		if (tuple[item.nullOffset])
+			continue;
+
+		dsc desc = item.desc;
+		desc.dsc_address = const_cast<UCHAR*>(tuple) + (IPTR) item.desc.dsc_address;
+		mapping.aggNode->aggPass(tdbb, request, item.desc.dsc_dtype ? &desc : nullptr);
+	}
+}
+
+// Copy the aggregate states from the request into the group storage.
+// AVG keeps also the argument type in its temporary impure area,
+// but it's the same for all groups, so it's not switched.
+void HashAggregatedStream::saveStates(Request* request, UCHAR* states) const
+{
+	for (const auto aggNode : m_aggregates)
+	{
+		memcpy(states, request->getImpure<impure_value_ex>(aggNode->impureOffset), sizeof(impure_value_ex));
+		states += sizeof(impure_value_ex);
+	}
+}
+
+// Copy the aggregate states from the group storage into the request
+void HashAggregatedStream::loadStates(Request* request, const UCHAR* states) const
+{
+	for (const auto aggNode : m_aggregates)
+	{
+		memcpy(request->getImpure<impure_value_ex>(aggNode->impureOffset), states, sizeof(impure_value_ex));
+		states += sizeof(impure_value_ex);
+	}
+}
+
+// Assign the aggregated values of the group to the output record
+void HashAggregatedStream::outputGroup(thread_db* tdbb, Request* request, ULONG group) const
+{
+	Impure* const impure = request->getImpure<Impure>(m_impure);
+	GroupTable* const table = impure->irsb_table;
+
+	UCHAR* const tuple = table->getTuple(group);
+	loadStates(request, table->getStates(group));
+	table->setCurrent(group);
+
+	for (const auto& mapping : m_mappings)
+	{
+		const FieldNode* const field = nodeAs<FieldNode>(mapping.target);
+		const USHORT id = field->fieldId;
+		Record* const record = request->req_rpb[field->fieldStream].rpb_record;
+
+		dsc* desc = nullptr;
+		dsc value;
+
+		if (mapping.aggNode)
+			desc = mapping.aggNode->execute(tdbb, request);
+		else if (mapping.item != NO_ITEM && !tuple[m_items[mapping.item].nullOffset])
+		{
+			const Item& item = m_items[mapping.item];
+			value = item.desc;
+			value.dsc_address = tuple + (IPTR) item.desc.dsc_address;
+			desc = &value;
+		}
+
+		if (!desc || !desc->dsc_dtype)
+			record->setNull(id);
+		else
+		{
+			MOV_move(tdbb, desc, EVL_assign_to(tdbb, mapping.target));
+			record->clearNull(id);
+		}
+	}
+}
+
+void HashAggregatedStream::releaseSpill(Impure* impure) const
+{
+	delete impure->irsb_input;
+	impure->irsb_input = nullptr;
+	impure->irsb_input_count = 0;
+
+	delete impure->irsb_spill;
+	impure->irsb_spill = nullptr;
+	impure->irsb_spill_count = 0;
+}
@@ -34,6 +34,8 @@
 
 #include "RecordSource.h"
 
+#include <algorithm>
+
 using namespace Firebird;
 using namespace Jrd;
 
@@ -41,66 +43,238 @@ using namespace Jrd;
 // Data access: hash join
 // ----------------------
 
-// NS: FIXME - Why use static hash table here??? Hash table shall support dynamic resizing
-static const ULONG HASH_SIZE = 1009;
-static const ULONG BUCKET_PREALLOCATE_SIZE = 32;	// 256 bytes per slot
+static const char* const SCRATCH = "fb_hash_";
+
+// The hash table is sized dynamically, based on the actual number of rows,
+// so that every slot contains one or two entries on average
+static const ULONG HASH_SIZES[] =
+{
+	1009, 2039, 4093, 8191, 16381, 32749, 65521, 131071, 262139, 524287,
+	1048573, 2097143, 4194301, 8388593, 16777213
+};
+
+static const ULONG HASH_LOAD_FACTOR = 2;
+
+// Every row costs 8 bytes inside the hash table plus up to 4 bytes per slot
+// and a byte of the Bloom filter.
+// Builds which do not fit the memory budget are spilled into the temporary space
+// and joined partition by partition, every partition is expected to be filled
+// by half to tolerate the uneven distribution of hash values.
+static const ULONG MAX_PASS_ENTRIES = 4 * 1024 * 1024;	// ~64MB
+static const ULONG PARTITION_ENTRIES = MAX_PASS_ENTRIES / 2;
+
+static const ULONG MAX_HASH_ENTRIES = 8 * 1024 * 1024;
+
+// Spilled entries are read back by chunks
+static const ULONG SPILL_CHUNK_ENTRIES = 8192;	// 64KB
+
+// The Bloom filter uses BLOOM_BITS_PER_ENTRY bits per row and BLOOM_PROBES bits
+// per hash value, thus giving ~3% false positive rate. If it rejects less than
+// a BLOOM_MIN_REJECTS part of the first BLOOM_SAMPLE records, checking it
+// costs more than it saves, so it's disabled.
+static const ULONG BLOOM_BITS_PER_ENTRY = 8;
+static const ULONG BLOOM_PROBES = 3;
+static const ULONG BLOOM_SAMPLE = 4096;
+static const ULONG BLOOM_MIN_REJECTS = 8;
 
 unsigned HashJoin::maxCapacity()
 {
-	// Binary search across 1000 collisions is computationally similar to
-	// linear search across 10 collisions. We use this number as a rough
-	// estimation of whether the lookup performance is likely to be acceptable.
-	return HASH_SIZE * 1000;
+	// As the hash table grows along with the number of rows, the lookup
+	// performance is not the limiting factor anymore. Larger builds are joined
+	// within the same memory budget, but every extra pass re-reads the leading
+	// stream, so the number of passes is what is actually limited here.
+	return MAX_HASH_ENTRIES;
 }
 
 
 class HashJoin::HashTable : public PermanentStorage
 {
-	class CollisionList
+	struct Entry
+	{
+		static bool lessThan(const Entry& item1, const Entry& item2)
+		{
+			return (item1.hash < item2.hash) ||
+				(item1.hash == item2.hash && item1.position < item2.position);
+		}
+
+		ULONG hash;
+		ULONG position;
+	};
+
+	class CollisionList : public PermanentStorage
 	{
 		static const FB_SIZE_T INVALID_ITERATOR = FB_SIZE_T(~0);
 
-		struct Entry
+	public:
+		explicit CollisionList(MemoryPool& pool)
+			: PermanentStorage(pool),
+			  m_entries(pool), m_slots(pool), m_filter(pool),
+			  m_filterMask(0), m_iterator(INVALID_ITERATOR),
+			  m_spill(nullptr), m_spillCount(0)
+		{}
+
+		~CollisionList()
+		{
+			delete m_spill;
+		}
+
+		FB_SIZE_T getCount() const
+		{
+			return m_entries.getCount();
+		}
+
+		ULONG getSpillCount() const
+		{
+			return m_spillCount;
+		}
+
+		void add(ULONG hash, ULONG position)
+		{
+			const Entry entry = {hash, position};
+			m_entries.add(entry);
+		}
+
+		void spill()
+		{
+			// Move the collected entries into the temporary space
+
+			if (!m_spill)
+				m_spill = FB_NEW_POOL(getPool()) TempSpace(getPool(), SCRATCH, false);
+
+			m_spill->write((offset_t) m_spillCount * sizeof(Entry),
+				m_entries.begin(), m_entries.getCount() * sizeof(Entry));
+
+			m_spillCount += m_entries.getCount();
+			m_entries.clear();
+		}
+
+		void load(ULONG partition, ULONG partitions)
 		{
-			Entry()
-				: hash(0), position(0)
-			{}
+			// Collect the spilled entries belonging to the given partition
 
-			Entry(ULONG h, ULONG pos)
-				: hash(h), position(pos)
-			{}
+			m_entries.clear();
 
-			static const ULONG generate(const Entry& item)
+			Array<Entry> chunk(getPool());
+			const auto buffer = chunk.getBuffer(SPILL_CHUNK_ENTRIES);
+
+			for (ULONG offset = 0; offset < m_spillCount; offset += SPILL_CHUNK_ENTRIES)
 			{
-				return item.hash;
-			}
+				const ULONG count = MIN(m_spillCount - offset, SPILL_CHUNK_ENTRIES);
 
-			ULONG hash;
-			ULONG position;
-		};
+				m_spill->read((offset_t) offset * sizeof(Entry), buffer, count * sizeof(Entry));
 
-	public:
-		CollisionList(MemoryPool& pool)
-			: m_collisions(pool, BUCKET_PREALLOCATE_SIZE),
-			  m_iterator(INVALID_ITERATOR)
+				for (ULONG i = 0; i < count; i++)
+				{
+					if (getPartition(buffer[i].hash, partitions) == partition)
+						m_entries.add(buffer[i]);
+				}
+			}
+		}
+
+		void distribute(ULONG tableSize)
 		{
-			m_collisions.setSortMode(FB_ARRAY_SORT_MANUAL);
+			// Group the entries by slots, slot N occupies the range [m_slots[N], m_slots[N + 1])
+
+			m_slots.clear();
+			m_slots.resize(tableSize + 1, 0);
+
+			for (const auto& entry : m_entries)
+				m_slots[entry.hash % tableSize + 1]++;
+
+			for (ULONG slot = 0; slot < tableSize; slot++)
+				m_slots[slot + 1] += m_slots[slot];
+
+			// Move the entries into their slots in place: every misplaced entry
+			// is swapped with the one occupying the next free position of its slot
+
+			Array<ULONG> cursors(getPool());
+			cursors.add(m_slots.begin(), tableSize);
+
+			const auto entries = m_entries.begin();
+
+			for (ULONG slot = 0; slot < tableSize; slot++)
+			{
+				const auto end = m_slots[slot + 1];
+				auto& cursor = cursors[slot];
+
+				while (cursor < end)
+				{
+					const ULONG target = entries[cursor].hash % tableSize;
+
+					if (target == slot)
+						cursor++;
+					else
+						std::swap(entries[cursor], entries[cursors[target]++]);
+				}
+			}
+
+			// Order every slot by hash values, so that the matching entries
+			// are located using a binary search and iterated sequentially
+
+			for (ULONG slot = 0; slot < tableSize; slot++)
+			{
+				const auto begin = entries + m_slots[slot];
+				const auto end = entries + m_slots[slot + 1];
+
+				if (end - begin > 1)
+					std::sort(begin, end, Entry::lessThan);
+			}
 		}
 
-		void sort()
+		void buildFilter()
 		{
-			m_collisions.sort();
+			ULONG bits = 64;
+			while (bits < m_entries.getCount() * BLOOM_BITS_PER_ENTRY)
+				bits <<= 1;
+
+			m_filter.clear();
+			m_filter.resize(bits / 64, 0);
+			m_filterMask = bits - 1;
+
+			for (const auto& entry : m_entries)
+			{
+				ULONG h1, h2;
+				getFilterHashes(entry.hash, h1, h2);
+
+				for (ULONG i = 0; i < BLOOM_PROBES; i++)
+				{
+					const ULONG bit = (h1 + i * h2) & m_filterMask;
+					m_filter[bit / 64] |= FB_UINT64(1) << (bit % 64);
+				}
+			}
 		}
 
-		void add(ULONG hash, ULONG position)
+		bool checkFilter(ULONG hash) const
 		{
-			m_collisions.add(Entry(hash, position));
+			// Reject the hash value if it's definitely missing in the table
+
+			ULONG h1, h2;
+			getFilterHashes(hash, h1, h2);
+
+			for (ULONG i = 0; i < BLOOM_PROBES; i++)
+			{
+				const ULONG bit = (h1 + i * h2) & m_filterMask;
+
+				if (!(m_filter[bit / 64] & (FB_UINT64(1) << (bit % 64))))
+					return false;
+			}
+
+			return true;
 		}
 
-		bool locate(ULONG hash)
+		bool locate(ULONG slot, ULONG hash)
 		{
-			if (m_collisions.find(hash, m_iterator))
+			const auto begin = m_entries.begin() + m_slots[slot];
+			const auto end = m_entries.begin() + m_slots[slot + 1];
+
+			const Entry entry = {hash, 0};
+			const auto iter = std::lower_bound(begin, end, entry, Entry::lessThan);
+
+			if (iter != end && iter->hash == hash)
+			{
+				m_iterator = iter - m_entries.begin();
 				return true;
+			}
 
 			m_iterator = INVALID_ITERATOR;
 			return false;
@@ -108,10 +282,10 @@ class HashJoin::HashTable : public PermanentStorage
 
 		bool iterate(ULONG hash, ULONG& position)
 		{
-			if (m_iterator >= m_collisions.getCount())
+			if (m_iterator >= m_entries.getCount())
 				return false;
 
-			const Entry& collision = m_collisions[m_iterator++];
+			const Entry& collision = m_entries[m_iterator++];
 
 			if (hash != collision.hash)
 			{
@@ -124,22 +298,40 @@ class HashJoin::HashTable : public PermanentStorage
 		}
 
 	private:
-		SortedArray<Entry, EmptyStorage<Entry>, ULONG, Entry> m_collisions;
+		static void getFilterHashes(ULONG hash, ULONG& h1, ULONG& h2)
+		{
+			// Scramble the hash value, as its lower bits are already utilized
+			// for the slot selection, and derive the probe positions from it
+
+			h1 = hash * 0x9E3779B1;
+			h2 = ((h1 >> 16) | (h1 << 16)) | 1;
+		}
+
+		Array<Entry> m_entries;
+		Array<ULONG> m_slots;
+		Array<FB_UINT64> m_filter;
+		ULONG m_filterMask;
 		FB_SIZE_T m_iterator;
+		TempSpace* m_spill;
+		ULONG m_spillCount;
 	};
 
 public:
-	HashTable(MemoryPool& pool, ULONG streamCount, ULONG tableSize = HASH_SIZE)
+	HashTable(MemoryPool& pool, ULONG streamCount, bool partitionable)
 		: PermanentStorage(pool), m_streamCount(streamCount),
-		  m_tableSize(tableSize), m_slot(0)
+		  m_tableSize(0), m_slot(0), m_partitionable(partitionable),
+		  m_count(0), m_spilled(false), m_partitions(1), m_partition(0),
+		  m_filtered(false), m_filterChecks(0), m_filterRejects(0)
 	{
-		m_collisions = FB_NEW_POOL(pool) CollisionList*[streamCount * tableSize];
-		memset(m_collisions, 0, streamCount * tableSize * sizeof(CollisionList*));
+		m_collisions = FB_NEW_POOL(pool) CollisionList*[streamCount];
+
+		for (ULONG i = 0; i < streamCount; i++)
+			m_collisions[i] = FB_NEW_POOL(pool) CollisionList(pool);
 	}
 
 	~HashTable()
 	{
-		for (ULONG i = 0; i < m_streamCount * m_tableSize; i++)
+		for (ULONG i = 0; i < m_streamCount; i++)
 			delete m_collisions[i];
 
 		delete[] m_collisions;
@@ -147,34 +339,31 @@ public:
 
 	void put(ULONG stream, ULONG hash, ULONG position)
 	{
-		const ULONG slot = hash % m_tableSize;
-
 		fb_assert(stream < m_streamCount);
-		fb_assert(slot < m_tableSize);
 
-		CollisionList* collisions = m_collisions[stream * m_tableSize + slot];
+		m_collisions[stream]->add(hash, position);
 
-		if (!collisions)
+		// Spill the entries once the memory budget is exhausted
+
+		if (m_partitionable && ++m_count >= MAX_PASS_ENTRIES)
 		{
-			collisions = FB_NEW_POOL(getPool()) CollisionList(getPool());
-			m_collisions[stream * m_tableSize + slot] = collisions;
-		}
+			for (ULONG i = 0; i < m_streamCount; i++)
+				m_collisions[i]->spill();
 
-		collisions->add(hash, position);
+			m_count = 0;
+			m_spilled = true;
+		}
 	}
 
 	bool setup(ULONG hash)
 	{
+		fb_assert(m_tableSize);
+
 		const ULONG slot = hash % m_tableSize;
 
 		for (ULONG i = 0; i < m_streamCount; i++)
 		{
-			CollisionList* const collisions = m_collisions[i * m_tableSize + slot];
-
-			if (!collisions)
-				return false;
-
-			if (!collisions->locate(hash))
+			if (!m_collisions[i]->locate(slot, hash))
 				return false;
 		}
 
@@ -186,42 +375,213 @@ public:
 	{
 		fb_assert(stream < m_streamCount);
 
-		CollisionList* const collisions = m_collisions[stream * m_tableSize + m_slot];
-		collisions->locate(hash);
+		m_collisions[stream]->locate(m_slot, hash);
 	}
 
 	bool iterate(ULONG stream, ULONG hash, ULONG& position)
 	{
 		fb_assert(stream < m_streamCount);
 
-		CollisionList* const collisions = m_collisions[stream * m_tableSize + m_slot];
-		return collisions->iterate(hash, position);
+		return m_collisions[stream]->iterate(hash, position);
 	}
 
-	void sort()
+	void build()
 	{
-		for (ULONG i = 0; i < m_streamCount * m_tableSize; i++)
+		if (m_spilled)
 		{
-			CollisionList* const collisions = m_collisions[i];
+			// Split the spilled entries into partitions
+			// and load the first of them into memory
+
+			ULONG count = 0;
+
+			for (ULONG i = 0; i < m_streamCount; i++)
+			{
+				m_collisions[i]->spill();
+				count += m_collisions[i]->getSpillCount();
+			}
+
+			m_partitions = count / PARTITION_ENTRIES + 1;
+			m_partition = 0;
 
-			if (collisions)
-				collisions->sort();
+			for (ULONG i = 0; i < m_streamCount; i++)
+				m_collisions[i]->load(m_partition, m_partitions);
 		}
+
+		distribute();
+	}
+
+	void buildFilter()
+	{
+		// The filter must cover all the partitions, so it's built for a single one only
+
+		if (m_partitions > 1)
+			return;
+
+		for (ULONG i = 0; i < m_streamCount; i++)
+			m_collisions[i]->buildFilter();
+
+		m_filtered = true;
+	}
+
+	bool isPartitioned() const
+	{
+		return (m_partitions > 1);
+	}
+
+	bool isFirstPartition() const
+	{
+		return (m_partition == 0);
+	}
+
+	bool checkPartition(ULONG hash) const
+	{
+		return (m_partitions == 1 || getPartition(hash, m_partitions) == m_partition);
+	}
+
+	bool checkFilter(ULONG hash)
+	{
+		if (!m_filtered)
+			return true;
+
+		bool found = true;
+
+		for (ULONG i = 0; i < m_streamCount; i++)
+		{
+			if (!m_collisions[i]->checkFilter(hash))
+			{
+				found = false;
+				break;
+			}
+		}
+
+		if (m_filterChecks < BLOOM_SAMPLE)
+		{
+			if (!found)
+				m_filterRejects++;
+
+			if (++m_filterChecks == BLOOM_SAMPLE &&
+				m_filterRejects < BLOOM_SAMPLE / BLOOM_MIN_REJECTS)
+			{
+				m_filtered = false;
+			}
+		}
+
+		return found;
+	}
+
+	bool nextPartition()
+	{
+		if (m_partition + 1 >= m_partitions)
+			return false;
+
+		m_partition++;
+
+		for (ULONG i = 0; i < m_streamCount; i++)
+			m_collisions[i]->load(m_partition, m_partitions);
+
+		distribute();
+		return true;
 	}
 
 private:
+	static ULONG getPartition(ULONG hash, ULONG partitions)
+	{
+		// Hash values are not necessarily spread over all the bits,
+		// so scramble them (multiplying by 2^32 divided by the golden ratio)
+		// and then scale to the number of partitions. This way the partitions
+		// do not correlate with the slots which use the remainder instead.
+		const ULONG scrambled = hash * 2654435769u;
+		return (ULONG) (((FB_UINT64) scrambled * partitions) >> 32);
+	}
+
+	void distribute()
+	{
+		// Choose the table size based on the largest stream
+
+		FB_SIZE_T count = 0;
+
+		for (ULONG i = 0; i < m_streamCount; i++)
+			count = MAX(count, m_collisions[i]->getCount());
+
+		const auto sizeCount = FB_NELEM(HASH_SIZES);
+
+		m_tableSize = HASH_SIZES[sizeCount - 1];
+
+		for (FB_SIZE_T i = 0; i < sizeCount; i++)
+		{
+			if (HASH_SIZES[i] * HASH_LOAD_FACTOR >= count)
+			{
+				m_tableSize = HASH_SIZES[i];
+				break;
+			}
+		}
+
+		for (ULONG i = 0; i < m_streamCount; i++)
+			m_collisions[i]->distribute(m_tableSize);
+	}
+
 	const ULONG m_streamCount;
-	const ULONG m_tableSize;
+	ULONG m_tableSize;
 	CollisionList** m_collisions;
 	ULONG m_slot;
+	const bool m_partitionable;
+	ULONG m_count;
+	bool m_spilled;
+	ULONG m_partitions;
+	ULONG m_partition;
+	bool m_filtered;
+	ULONG m_filterChecks;
+	ULONG m_filterRejects;
 };
 
 
 HashJoin::HashJoin(thread_db* tdbb, CompilerScratch* csb, FB_SIZE_T count,
 				   RecordSource* const* args, NestValueArray* const* keys,
-				   double selectivity)
+				   double selectivity, bool ordered)
+	: RecordSource(csb),
+	  m_joinType(INNER_JOIN),
+	  m_leaderBuffer(nullptr),
+	  m_filtered(false),
+	  m_args(csb->csb_pool, count - 1),
+	  m_boolean(nullptr),
+	  m_residual(nullptr)
+{
+	init(tdbb, csb, count, args, keys, selectivity, ordered);
+}
+
+HashJoin::HashJoin(thread_db* tdbb, CompilerScratch* csb, JoinType joinType,
+				   RecordSource* outer, RecordSource* inner, NestValueArray* const* keys,
+				   BoolExprNode* boolean, BoolExprNode* residual, bool ordered)
 	: RecordSource(csb),
-	  m_args(csb->csb_pool, count - 1)
+	  m_joinType(joinType),
+	  m_leaderBuffer(nullptr),
+	  m_filtered(false),
+	  m_args(csb->csb_pool, 1),
+	  m_boolean(boolean),
+	  m_residual(residual)
+{
+	// The outer stream is the probing one, while the inner stream is hashed.
+	// Hash values may collide, so the residual boolean (including the join
+	// conditions) is checked for every inner record matched by the hash value.
+
+	fb_assert(joinType == OUTER_JOIN || joinType == ANTI_JOIN);
+	fb_assert(residual);
+
+	RecordSource* const args[] = {outer, inner};
+	init(tdbb, csb, 2, args, keys, 0, ordered);
+
+	// Every outer record is returned at least once for an outer join
+	// and at most once for an anti-join
+
+	if (joinType == OUTER_JOIN)
+		m_cardinality = MAX(m_cardinality, outer->getCardinality());
+	else
+		m_cardinality = outer->getCardinality();
+}
+
+void HashJoin::init(thread_db* tdbb, CompilerScratch* csb, FB_SIZE_T count,
+					RecordSource* const* args, NestValueArray* const* keys,
+					double selectivity, bool ordered)
 {
 	fb_assert(count >= 2);
 
@@ -308,6 +668,39 @@ HashJoin::HashJoin(thread_db* tdbb, CompilerScratch* csb, FB_SIZE_T count,
 	}
 
 	m_cardinality *= selectivity;
+
+	// Partitioned builds join the leading stream once per partition, so it's buffered
+	// to be re-read. This is impossible if the leading stream order must be preserved.
+
+	if (!ordered)
+		m_leaderBuffer = FB_NEW_POOL(csb->csb_pool) BufferedStream(csb, m_leader.source);
+
+	// Push the Bloom filter of the hashed keys down into the leading stream, so that
+	// its records which cannot be matched are rejected before being joined any further.
+	// It's possible for inner joins only. The leading keys must be plain fields,
+	// then computing them earlier than usual cannot raise any errors.
+
+	if (m_joinType == INNER_JOIN)
+	{
+		StreamList keyStreams;
+
+		for (const auto key : *m_leader.keys)
+		{
+			const auto field = nodeAs<FieldNode>(key);
+
+			if (!field)
+			{
+				keyStreams.clear();
+				break;
+			}
+
+			if (!keyStreams.exist(field->fieldStream))
+				keyStreams.add(field->fieldStream);
+		}
+
+		if (keyStreams.hasData())
+			m_filtered = m_leader.source->pushJoinFilter(this, keyStreams);
+	}
 }
 
 void HashJoin::internalOpen(thread_db* tdbb) const
@@ -323,7 +716,15 @@ void HashJoin::internalOpen(thread_db* tdbb) const
 	delete[] impure->irsb_leader_buffer;
 	impure->irsb_leader_buffer = nullptr;
 
-	m_leader.source->open(tdbb);
+	// The inner streams are hashed before the leading one is opened,
+	// as the partitioned build requires the leading stream to be buffered
+
+	buildHashTable(tdbb, impure);
+
+	if (impure->irsb_hash_table->isPartitioned())
+		m_leaderBuffer->open(tdbb);
+	else
+		m_leader.source->open(tdbb);
 }
 
 void HashJoin::close(thread_db* tdbb) const
@@ -346,6 +747,9 @@ void HashJoin::close(thread_db* tdbb) const
 		for (FB_SIZE_T i = 0; i < m_args.getCount(); i++)
 			m_args[i].buffer->close(tdbb);
 
+		if (m_leaderBuffer)
+			m_leaderBuffer->close(tdbb);
+
 		m_leader.source->close(tdbb);
 	}
 }
@@ -360,52 +764,28 @@ bool HashJoin::internalGetRecord(thread_db* tdbb) const
 	if (!(impure->irsb_flags & irsb_open))
 		return false;
 
+	if (m_joinType != INNER_JOIN)
+		return getOuterRecord(tdbb, impure);
+
 	while (true)
 	{
 		if (impure->irsb_flags & irsb_mustread)
 		{
 			// Fetch the record from the leading stream
 
-			if (!m_leader.source->getRecord(tdbb))
+			if (!fetchLeader(tdbb, impure))
 				return false;
 
-			// We have something to join with, so ensure the hash table is initialized
-
-			if (!impure->irsb_hash_table && !impure->irsb_leader_buffer)
-			{
-				auto& pool = *tdbb->getDefaultPool();
-				const auto argCount = m_args.getCount();
-
-				impure->irsb_hash_table = FB_NEW_POOL(pool) HashTable(pool, argCount);
-				impure->irsb_leader_buffer = FB_NEW_POOL(pool) UCHAR[m_leader.totalKeyLength];
-
-				UCharBuffer buffer(pool);
-
-				for (FB_SIZE_T i = 0; i < argCount; i++)
-				{
-					// Read and cache the inner streams. While doing that,
-					// hash the join condition values and populate hash tables.
-
-					m_args[i].buffer->open(tdbb);
-
-					ULONG counter = 0;
-					const auto keyBuffer = buffer.getBuffer(m_args[i].totalKeyLength, false);
-
-					while (m_args[i].buffer->getRecord(tdbb))
-					{
-						const auto hash = computeHash(tdbb, request, m_args[i], keyBuffer);
-						impure->irsb_hash_table->put(i, hash, counter++);
-					}
-				}
-
-				impure->irsb_hash_table->sort();
-			}
-
 			// Compute and hash the comparison keys
 
 			impure->irsb_leader_hash =
 				computeHash(tdbb, request, m_leader, impure->irsb_leader_buffer);
 
+			// Skip the records hashed into other partitions, they're joined during other passes
+
+			if (!impure->irsb_hash_table->checkPartition(impure->irsb_leader_hash))
+				continue;
+
 			// Ensure the every inner stream having matches for this hash slot.
 			// Setup the hash table for the iteration through collisions.
 
@@ -451,6 +831,168 @@ bool HashJoin::internalGetRecord(thread_db* tdbb) const
 	return true;
 }
 
+bool HashJoin::getOuterRecord(thread_db* tdbb, Impure* impure) const
+{
+	Request* const request = tdbb->getRequest();
+
+	fb_assert(m_args.getCount() == 1);
+	const BufferedStream* const inner = m_args[0].buffer;
+
+	while (true)
+	{
+		if (impure->irsb_flags & irsb_mustread)
+		{
+			// Fetch the record from the outer stream
+
+			if (!fetchLeader(tdbb, impure))
+				return false;
+
+			if (m_boolean && !m_boolean->execute(tdbb, request))
+			{
+				// The boolean pertaining to the outer stream is false
+				// so just join it to a null valued inner stream.
+				// Do it only once if the outer stream is re-read per partition.
+
+				if (!impure->irsb_hash_table->isFirstPartition())
+					continue;
+
+				inner->nullRecords(tdbb);
+				return true;
+			}
+
+			impure->irsb_leader_hash =
+				computeHash(tdbb, request, m_leader, impure->irsb_leader_buffer);
+
+			// Skip the records hashed into other partitions, they're joined during other passes
+
+			if (!impure->irsb_hash_table->checkPartition(impure->irsb_leader_hash))
+				continue;
+
+			impure->irsb_flags &= ~(irsb_mustread | irsb_joined | irsb_first);
+
+			// Remember whether the hash slot contains any candidates
+
+			if (impure->irsb_hash_table->setup(impure->irsb_leader_hash))
+				impure->irsb_flags |= irsb_first;
+		}
+
+		// Iterate through the collisions looking for the matching inner records
+
+		bool found = false;
+
+		if (impure->irsb_flags & irsb_first)
+		{
+			ULONG position;
+			while (impure->irsb_hash_table->iterate(0, impure->irsb_leader_hash, position))
+			{
+				inner->locate(tdbb, position);
+
+				if (inner->getRecord(tdbb) && m_residual->execute(tdbb, request))
+				{
+					found = true;
+					break;
+				}
+			}
+		}
+
+		if (found)
+		{
+			impure->irsb_flags |= irsb_joined;
+
+			if (m_joinType == OUTER_JOIN)
+				return true;
+
+			// A single match is enough to reject the outer record for an anti-join
+			impure->irsb_flags |= irsb_mustread;
+			continue;
+		}
+
+		impure->irsb_flags |= irsb_mustread;
+
+		if (!(impure->irsb_flags & irsb_joined))
+		{
+			// The current outer record has not been joined to anything.
+			// Join it to a null valued inner stream.
+			inner->nullRecords(tdbb);
+			return true;
+		}
+	}
+}
+
+bool HashJoin::fetchLeader(thread_db* tdbb, Impure* impure) const
+{
+	HashTable* const hashTable = impure->irsb_hash_table;
+
+	if (!hashTable->isPartitioned())
+		return m_leader.source->getRecord(tdbb);
+
+	// Once the leading stream is exhausted, load the next partition
+	// and re-read the buffered leading stream from the beginning
+
+	while (!m_leaderBuffer->getRecord(tdbb))
+	{
+		if (!hashTable->nextPartition())
+			return false;
+
+		m_leaderBuffer->locate(tdbb, 0);
+	}
+
+	return true;
+}
+
+void HashJoin::buildHashTable(thread_db* tdbb, Impure* impure) const
+{
+	Request* const request = tdbb->getRequest();
+
+	auto& pool = *tdbb->getDefaultPool();
+	const auto argCount = m_args.getCount();
+
+	// The hash table is partitioned only if the leading stream can be buffered
+
+	impure->irsb_hash_table = FB_NEW_POOL(pool) HashTable(pool, argCount, m_leaderBuffer != nullptr);
+	impure->irsb_leader_buffer = FB_NEW_POOL(pool) UCHAR[m_leader.totalKeyLength];
+
+	UCharBuffer buffer(pool);
+
+	for (FB_SIZE_T i = 0; i < argCount; i++)
+	{
+		// Read and cache the inner streams. While doing that,
+		// hash the join condition values and populate hash tables.
+
+		m_args[i].buffer->open(tdbb);
+
+		ULONG counter = 0;
+		const auto keyBuffer = buffer.getBuffer(m_args[i].totalKeyLength, false);
+
+		while (m_args[i].buffer->getRecord(tdbb))
+		{
+			const auto hash = computeHash(tdbb, request, m_args[i], keyBuffer);
+			impure->irsb_hash_table->put(i, hash, counter++);
+		}
+	}
+
+	impure->irsb_hash_table->build();
+
+	if (m_filtered)
+		impure->irsb_hash_table->buildFilter();
+}
+
+bool HashJoin::checkFilter(thread_db* tdbb) const
+{
+	Request* const request = tdbb->getRequest();
+	Impure* const impure = request->getImpure<Impure>(m_impure);
+
+	// The filter is checked by the leading stream while this join is fetching from it,
+	// so the key buffer is not in use and the hash table is already built
+
+	if (!impure->irsb_hash_table)
+		return true;
+
+	const auto hash = computeHash(tdbb, request, m_leader, impure->irsb_leader_buffer);
+
+	return impure->irsb_hash_table->checkFilter(hash);
+}
+
 bool HashJoin::refetchRecord(thread_db* /*tdbb*/) const
 {
 	return true;
@@ -485,7 +1027,27 @@ void HashJoin::internalGetPlan(thread_db* tdbb, PlanEntry& planEntry, unsigned l
 	extras.printf(" (keys: %" ULONGFORMAT", total key length: %" ULONGFORMAT")",
 				  m_leader.keys->getCount(), m_leader.totalKeyLength);
 
-	planEntry.lines.add().text = "Hash Join (inner)" + extras;
+	planEntry.lines.add().text = "Hash Join ";
+
+	switch (m_joinType)
+	{
+		case INNER_JOIN:
+			planEntry.lines.back().text += "(inner)";
+			break;
+
+		case OUTER_JOIN:
+			planEntry.lines.back().text += "(outer)";
+			break;
+
+		case ANTI_JOIN:
+			planEntry.lines.back().text += "(anti)";
+			break;
+
+		default:
+			fb_assert(false);
+	}
+
+	planEntry.lines.back().text += extras;
 	printOptInfo(planEntry.lines);
 
 	if (recurse)
@@ -507,6 +1069,14 @@ void HashJoin::markRecursive()
 		m_args[i].source->markRecursive();
 }
 
+bool HashJoin::pushJoinFilter(const HashJoin* join, const StreamList& keyStreams)
+{
+	// Records of the hashed streams are buffered before the leading stream is fetched,
+	// so pass the filter to the leading stream only
+
+	return m_leader.source->pushJoinFilter(join, keyStreams);
+}
+
 void HashJoin::findUsedStreams(StreamList& streams, bool expandAll) const
 {
 	m_leader.source->findUsedStreams(streams, expandAll);
@@ -331,8 +331,11 @@ bool IndexTableScan::internalGetRecord(thread_db* tdbb) const
 					RBM_SET(tdbb->getDefaultPool(), &impure->irsb_nav_records_visited,
 							rpb->rpb_number.getValue());
 
-					rpb->rpb_number.setValid(true);
-					return true;
+					if (checkJoinFilter(tdbb))
+					{
+						rpb->rpb_number.setValid(true);
+						return true;
+					}
 				}
 			}
 
@@ -288,6 +288,37 @@ void NestedLoopJoin::nullRecords(thread_db* tdbb) const
 		m_args[i]->nullRecords(tdbb);
 }
 
+bool NestedLoopJoin::pushJoinFilter(const HashJoin* join, const StreamList& keyStreams)
+{
+	// Pass the filter to the sub-stream computing all the keys. Records of the inner
+	// sub-stream of an outer, semi- or anti-join cannot be rejected, as they define
+	// whether the outer record is returned.
+
+	const FB_SIZE_T count = (m_joinType == INNER_JOIN) ? m_args.getCount() : 1;
+
+	for (FB_SIZE_T i = 0; i < count; i++)
+	{
+		StreamList streams;
+		m_args[i]->findUsedStreams(streams);
+
+		bool found = true;
+
+		for (const auto stream : keyStreams)
+		{
+			if (!streams.exist(stream))
+			{
+				found = false;
+				break;
+			}
+		}
+
+		if (found)
+			return m_args[i]->pushJoinFilter(join, keyStreams);
+	}
+
+	return false;
+}
+
 bool NestedLoopJoin::fetchRecord(thread_db* tdbb, FB_SIZE_T n) const
 {
 	fb_assert(m_joinType == INNER_JOIN);
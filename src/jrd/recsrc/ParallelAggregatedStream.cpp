@@ -0,0 +1,1407 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.ibphoenix.com/main.nfs?a=ibphoenix&page=ibp_idpl.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created for the Firebird Open Source RDBMS project.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "firebird.h"
+#include "../common/Task.h"
+#include "../common/classes/Hash.h"
+#include "../jrd/jrd.h"
+#include "../jrd/req.h"
+#include "../jrd/tra.h"
+#include "../jrd/align.h"
+#include "../jrd/WorkerAttachment.h"
+#include "../dsql/BoolNodes.h"
+#include "../dsql/ExprNodes.h"
+#include "../dsql/AggNodes.h"
+#include "../jrd/RecordSourceNodes.h"
+#include "../jrd/dpm_proto.h"
+#include "../jrd/evl_proto.h"
+#include "../jrd/met_proto.h"
+#include "../jrd/mov_proto.h"
+#include "../jrd/rlck_proto.h"
+#include "../jrd/tra_proto.h"
+#include "../jrd/vio_proto.h"
+#include "../jrd/optimizer/Optimizer.h"
+
+#include "RecordSource.h"
+
+using namespace Firebird;
+using namespace Jrd;
+
+// --------------------------------------------
+// Data access: parallel aggregation of a table
+// --------------------------------------------
+
+// Groups above this budget make the workers give up, the regular aggregation is used instead
+static const ULONG MAX_GROUP_MEMORY = 32 * 1024 * 1024;	// 32MB
+
+static const ULONG INITIAL_BUCKETS = 1024;
+
+namespace
+{
+	// Data types which values are compared without the session context
+	// (collations, time zones) and thus the same way in any attachment
+	bool isComparableType(const dsc& desc)
+	{
+		switch (desc.dsc_dtype)
+		{
+			case dtype_short:
+			case dtype_long:
+			case dtype_int64:
+			case dtype_int128:
+			case dtype_real:
+			case dtype_double:
+			case dtype_sql_date:
+			case dtype_sql_time:
+			case dtype_timestamp:
+			case dtype_boolean:
+				return true;
+		}
+
+		return false;
+	}
+
+	// Comparable data types which every value has the only binary representation of
+	bool isExactType(const dsc& desc)
+	{
+		return isComparableType(desc) && !desc.isApprox();
+	}
+
+	bool isValue(const ValueExprNode* node)
+	{
+		return nodeIs<LiteralNode>(node) || nodeIs<ParameterNode>(node);
+	}
+
+	const FieldNode* getField(thread_db* tdbb, CompilerScratch* csb, StreamType stream,
+		ValueExprNode* node, dsc* desc)
+	{
+		FieldNode* const field = nodeAs<FieldNode>(node);
+
+		if (!field || field->fieldStream != stream || field->cursorNumber.has_value())
+			return nullptr;
+
+		field->getDesc(tdbb, csb, desc);
+		return field;
+	}
+
+	void decompose(BoolExprNode* boolean, HalfStaticArray<BoolExprNode*, OPT_STATIC_ITEMS>& conjuncts)
+	{
+		const auto binaryNode = nodeAs<BinaryBoolNode>(boolean);
+
+		if (binaryNode && binaryNode->blrOp == blr_and)
+		{
+			decompose(binaryNode->arg1, conjuncts);
+			decompose(binaryNode->arg2, conjuncts);
+		}
+		else
+			conjuncts.add(boolean);
+	}
+}
+
+
+namespace Jrd
+{
+
+// Hash table of the aggregated groups. Every group is allocated separately and never
+// moves, as the descriptors of the aggregate states point inside the states themselves.
+// The group header is followed by the aggregate states and the group key.
+
+class ParallelAggregatedStream::GroupTable : public PermanentStorage
+{
+	struct Header
+	{
+		Header* next;
+		ULONG hash;
+	};
+
+public:
+	GroupTable(MemoryPool& pool, ULONG keyLength, ULONG stateCount)
+		: PermanentStorage(pool),
+		  m_buckets(pool), m_groups(pool),
+		  m_keyLength(keyLength),
+		  m_statesOffset(FB_ALIGN(sizeof(Header), alignof(impure_value_ex))),
+		  m_keyOffset(m_statesOffset + stateCount * sizeof(impure_value_ex))
+	{
+		m_buckets.resize(INITIAL_BUCKETS, nullptr);
+	}
+
+	~GroupTable()
+	{
+		for (auto group : m_groups)
+			delete[] reinterpret_cast<UCHAR*>(group);
+	}
+
+	static ULONG getGroupLength(ULONG keyLength, ULONG stateCount)
+	{
+		return FB_ALIGN(sizeof(Header), alignof(impure_value_ex)) + stateCount * sizeof(impure_value_ex) + keyLength;
+	}
+
+	ULONG getCount() const
+	{
+		return m_groups.getCount();
+	}
+
+	impure_value_ex* getStates(ULONG group) const
+	{
+		return getStates(m_groups[group]);
+	}
+
+	const UCHAR* getKey(ULONG group) const
+	{
+		return reinterpret_cast<const UCHAR*>(m_groups[group]) + m_keyOffset;
+	}
+
+	impure_value_ex* find(ULONG hash, const UCHAR* key) const
+	{
+		const ULONG mask = m_buckets.getCount() - 1;
+
+		for (Header* group = m_buckets[hash & mask]; group; group = group->next)
+		{
+			if (group->hash == hash &&
+				!memcmp(reinterpret_cast<const UCHAR*>(group) + m_keyOffset, key, m_keyLength))
+			{
+				return getStates(group);
+			}
+		}
+
+		return nullptr;
+	}
+
+	// Add the group, its states are left zeroed
+	impure_value_ex* add(ULONG hash, const UCHAR* key)
+	{
+		const ULONG length = m_keyOffset + m_keyLength;
+
+		UCHAR* const data = FB_NEW_POOL(getPool()) UCHAR[length];
+		memset(data, 0, m_keyOffset);
+		memcpy(data + m_keyOffset, key, m_keyLength);
+
+		Header* const group = reinterpret_cast<Header*>(data);
+		group->hash = hash;
+		m_groups.add(group);
+
+		if (m_groups.getCount() > m_buckets.getCount())
+			rehash();
+		else
+		{
+			const ULONG slot = hash & (m_buckets.getCount() - 1);
+			group->next = m_buckets[slot];
+			m_buckets[slot] = group;
+		}
+
+		return getStates(group);
+	}
+
+private:
+	impure_value_ex* getStates(Header* group) const
+	{
+		return reinterpret_cast<impure_value_ex*>(reinterpret_cast<UCHAR*>(group) + m_statesOffset);
+	}
+
+	void rehash()
+	{
+		const ULONG size = m_buckets.getCount() * 2;
+
+		m_buckets.shrink(0);
+		m_buckets.resize(size, nullptr);
+
+		for (auto group : m_groups)
+		{
+			const ULONG slot = group->hash & (size - 1);
+			group->next = m_buckets[slot];
+			m_buckets[slot] = group;
+		}
+	}
+
+	Array<Header*> m_buckets;
+	Array<Header*> m_groups;
+	const ULONG m_keyLength;
+	const ULONG m_statesOffset;
+	const ULONG m_keyOffset;
+};
+
+
+class ParallelAggregatedStream::AggregateTask : public Task
+{
+public:
+	AggregateTask(thread_db* tdbb, jrd_tra* transaction, const ParallelAggregatedStream* stream,
+			const impure_value* values, CommitNumber snapshot) : Task(),
+		m_dbb(tdbb->getDatabase()),
+		m_pool(m_dbb->createPool()),
+		m_stream(stream),
+		m_values(values),
+		m_relId(stream->m_relation->rel_id),
+		m_relName(stream->m_relation->rel_name),
+		m_largeScan(false),
+		m_tpb(*m_pool),
+		m_items(*m_pool),
+		m_stop(false),
+		m_overflow(false),
+		m_countPP(0),
+		m_nextPP(0),
+		m_maxGroups(0)
+	{
+		Attachment* const att = tdbb->getAttachment();
+
+		// Every worker reads the table inside the snapshot of the current transaction
+
+		m_tpb.add(isc_tpb_version3);
+		m_tpb.add(isc_tpb_read);
+		m_tpb.add(isc_tpb_concurrency);
+
+		if (transaction->tra_flags & TRA_ignore_limbo)
+			m_tpb.add(isc_tpb_ignore_limbo);
+
+		m_tpb.add(isc_tpb_at_snapshot_number);
+		m_tpb.add(sizeof(CommitNumber));
+
+		for (unsigned i = 0; i < sizeof(CommitNumber); i++)
+			m_tpb.add((UCHAR) (snapshot >> (i * 8)));
+
+		m_countPP = DPM_pointer_pages(tdbb, stream->m_relation);
+		m_largeScan = (DPM_data_pages(tdbb, stream->m_relation) > m_dbb->dbb_bcb->bcb_count);
+
+		for (int i = 0; i < att->att_parallel_workers; i++)
+			m_items.add(FB_NEW_POOL(*m_pool) Item(this));
+
+		const ULONG groupLength =
+			GroupTable::getGroupLength(stream->m_keyLength, stream->m_aggregates.getCount());
+
+		m_maxGroups = MAX_GROUP_MEMORY / (m_items.getCount() * groupLength);
+		m_maxGroups = MAX(m_maxGroups, 1);
+	}
+
+	virtual ~AggregateTask()
+	{
+		for (Item** p = m_items.begin(); p < m_items.end(); p++)
+			delete *p;
+
+		m_dbb->deletePool(m_pool);
+	}
+
+	bool handler(WorkItem& _item);
+	bool getWorkItem(WorkItem** pItem);
+	bool getResult(IStatus* status);
+	int getMaxWorkers();
+
+	// Whether the workers gave up because of too many groups
+	bool isOverflow() const
+	{
+		return m_overflow;
+	}
+
+	void merge(thread_db* tdbb, GroupTable* table) const;
+
+	class Item : public Task::WorkItem
+	{
+	public:
+		Item(AggregateTask* task) : Task::WorkItem(task),
+			m_inuse(false),
+			m_tra(NULL),
+			m_ppSequence(0),
+			m_table(NULL),
+			m_key(*task->m_pool)
+		{
+			m_key.resize(FB_ALIGN(task->m_stream->m_keyLength, sizeof(FB_UINT64)) / sizeof(FB_UINT64) + 1);
+		}
+
+		virtual ~Item()
+		{
+			delete m_table;
+
+			if (!m_attStable)
+				return;
+
+			Attachment* att = NULL;
+			{
+				AttSyncLockGuard guard(*m_attStable->getSync(), FB_FUNCTION);
+
+				att = m_attStable->getHandle();
+				if (!att)
+					return;
+				fb_assert(att->att_use_count > 0);
+			}
+
+			FbLocalStatus status;
+			if (m_tra)
+			{
+				BackgroundContextHolder tdbb(att->att_database, att, &status, FB_FUNCTION);
+				TRA_commit(tdbb, m_tra, false);
+			}
+			WorkerAttachment::releaseAttachment(&status, m_attStable);
+		}
+
+		bool init(thread_db* tdbb)
+		{
+			FbStatusVector* status = tdbb->tdbb_status_vector;
+			Attachment* att = NULL;
+
+			if (!m_attStable.hasData())
+				m_attStable = WorkerAttachment::getAttachment(status, getTask()->m_dbb);
+
+			if (m_attStable)
+				att = m_attStable->getHandle();
+
+			if (!att)
+			{
+				if (!status->hasData())
+					Arg::Gds(isc_bad_db_handle).copyTo(status);
+
+				return false;
+			}
+
+			tdbb->setDatabase(att->att_database);
+			tdbb->setAttachment(att);
+
+			if (!m_tra)
+			{
+				const auto& tpb = getTask()->m_tpb;
+
+				try
+				{
+					WorkerContextHolder holder(tdbb, FB_FUNCTION);
+					m_tra = TRA_start(tdbb, tpb.getCount(), tpb.begin());
+				}
+				catch (const Exception& ex)
+				{
+					ex.stuffException(tdbb->tdbb_status_vector);
+					return false;
+				}
+			}
+
+			tdbb->setTransaction(m_tra);
+
+			return true;
+		}
+
+		AggregateTask* getTask() const
+		{
+			return reinterpret_cast<AggregateTask*> (m_task);
+		}
+
+		UCHAR* getKey()
+		{
+			return reinterpret_cast<UCHAR*>(m_key.begin());
+		}
+
+		bool m_inuse;
+		RefPtr<StableAttachmentPart> m_attStable;
+		jrd_tra* m_tra;
+		ULONG m_ppSequence;
+		GroupTable* m_table;		// groups aggregated by this worker
+		Array<FB_UINT64> m_key;		// group key of the current record
+	};
+
+private:
+	void setError(IStatus* status, bool stopTask)
+	{
+		const bool copyStatus = (m_status.isSuccess() && status && status->getState() == IStatus::STATE_ERRORS);
+		if (!copyStatus && (!stopTask || m_stop))
+			return;
+
+		MutexLockGuard guard(m_mutex, FB_FUNCTION);
+		if (m_status.isSuccess() && copyStatus)
+			m_status.save(status);
+		if (stopTask)
+			m_stop = true;
+	}
+
+	Database* const m_dbb;
+	MemoryPool* const m_pool;
+	const ParallelAggregatedStream* const m_stream;
+	const impure_value* const m_values;		// values of the predicates evaluated by the leader
+	const USHORT m_relId;
+	const MetaName m_relName;
+	bool m_largeScan;
+	HalfStaticArray<UCHAR, 32> m_tpb;
+
+	Mutex m_mutex;
+	HalfStaticArray<Item*, 8> m_items;
+	StatusHolder m_status;
+
+	volatile bool m_stop;
+	volatile bool m_overflow;
+	ULONG m_countPP;
+	ULONG m_nextPP;
+	ULONG m_maxGroups;			// per worker
+};
+
+bool ParallelAggregatedStream::AggregateTask::handler(WorkItem& _item)
+{
+	Item* item = reinterpret_cast<Item*>(&_item);
+
+	ThreadContextHolder tdbb(NULL);
+
+	if (!item->init(tdbb))
+	{
+		setError(tdbb->tdbb_status_vector, true);
+		return false;
+	}
+
+	record_param rpb;
+	jrd_rel* relation = NULL;
+
+	try
+	{
+		WorkerContextHolder holder(tdbb, FB_FUNCTION);
+
+		Database* dbb = tdbb->getDatabase();
+
+		relation = MET_lookup_relation_id(tdbb, m_relId, false);
+		if (!relation)
+			ERR_post(Arg::Gds(isc_relnotdef) << Arg::Str(m_relName));
+
+		rpb.rpb_relation = relation;
+		rpb.rpb_record = NULL;
+		rpb.rpb_stream_flags = m_stream->m_fetchData ? 0 : RPB_s_no_data;
+
+		if (m_largeScan)
+		{
+			rpb.getWindow(tdbb).win_flags = WIN_large_scan;
+			rpb.rpb_org_scans = relation->rel_scan_count++;
+		}
+
+		rpb.rpb_number.compose(dbb->dbb_max_records, dbb->dbb_dp_per_pp, 0, 0, item->m_ppSequence);
+		rpb.rpb_number.decrement();
+
+		RecordNumber lastRecNo;
+		lastRecNo.compose(dbb->dbb_max_records, dbb->dbb_dp_per_pp, 0, 0, item->m_ppSequence + 1);
+		lastRecNo.decrement();
+
+		if (!item->m_table)
+		{
+			item->m_table = FB_NEW_POOL(*m_pool)
+				GroupTable(*m_pool, m_stream->m_keyLength, m_stream->m_aggregates.getCount());
+		}
+
+		UCHAR* const key = item->getKey();
+
+		// Without the record data fetched, the pool is used for the back versions only
+
+		while (!m_stop &&
+			VIO_next_record(tdbb, &rpb, item->m_tra, relation->rel_pool, DPM_next_pointer_page, &lastRecNo))
+		{
+			JRD_reschedule(tdbb);
+
+			Record* const record = rpb.rpb_record;
+
+			if (!m_stream->checkRecord(tdbb, relation, record, m_values))
+				continue;
+
+			m_stream->makeKey(tdbb, relation, record, key);
+
+			impure_value_ex* const states = m_stream->findGroup(item->m_table, key, m_maxGroups);
+
+			if (!states)
+			{
+				m_overflow = true;
+				m_stop = true;
+				break;
+			}
+
+			m_stream->accumulate(tdbb, relation, record, states);
+		}
+
+		delete rpb.rpb_record;
+		rpb.rpb_record = NULL;
+
+		if (rpb.getWindow(tdbb).win_flags & WIN_large_scan)
+			--relation->rel_scan_count;
+	}
+	catch (const Exception& ex)
+	{
+		ex.stuffException(tdbb->tdbb_status_vector);
+
+		delete rpb.rpb_record;
+		if (relation && (rpb.getWindow(tdbb).win_flags & WIN_large_scan) && relation->rel_scan_count)
+			--relation->rel_scan_count;
+
+		setError(tdbb->tdbb_status_vector, true);
+		return false;
+	}
+
+	return !m_stop;
+}
+
+bool ParallelAggregatedStream::AggregateTask::getWorkItem(WorkItem** pItem)
+{
+	Item* item = reinterpret_cast<Item*> (*pItem);
+
+	MutexLockGuard guard(m_mutex, FB_FUNCTION);
+
+	if (m_stop)
+		return false;
+
+	if (item == NULL)
+	{
+		for (Item** p = m_items.begin(); p < m_items.end(); p++)
+			if (!(*p)->m_inuse)
+			{
+				(*p)->m_inuse = true;
+				*pItem = item = *p;
+				break;
+			}
+	}
+
+	if (!item)
+		return false;
+
+	item->m_inuse = (m_nextPP < m_countPP);
+
+	if (item->m_inuse)
+		item->m_ppSequence = m_nextPP++;
+
+	return item->m_inuse;
+}
+
+bool ParallelAggregatedStream::AggregateTask::getResult(IStatus* status)
+{
+	if (status)
+	{
+		status->init();
+		status->setErrors(m_status.getErrors());
+	}
+
+	return m_status.isSuccess();
+}
+
+int ParallelAggregatedStream::AggregateTask::getMaxWorkers()
+{
+	return MIN(m_items.getCount(), m_countPP);
+}
+
+// Merge the groups of all workers into the table
+void ParallelAggregatedStream::AggregateTask::merge(thread_db* tdbb, GroupTable* table) const
+{
+	for (const auto item : m_items)
+	{
+		const GroupTable* const source = item->m_table;
+
+		if (!source)
+			continue;
+
+		for (ULONG group = 0; group < source->getCount(); group++)
+		{
+			JRD_reschedule(tdbb);
+
+			impure_value_ex* const states = m_stream->findGroup(table, source->getKey(group), MAX_ULONG);
+			m_stream->mergeStates(tdbb, states, source->getStates(group));
+		}
+	}
+}
+
+} // namespace Jrd
+
+
+ParallelAggregatedStream::ParallelAggregatedStream(thread_db* tdbb, CompilerScratch* csb,
+			StreamType stream, RseNode* rse, SortNode* group, MapNode* map, RecordSource* next)
+	: RecordStream(csb, stream),
+	  m_next(next),
+	  m_map(map),
+	  m_relation(nullptr),
+	  m_predicates(csb->csb_pool),
+	  m_keys(csb->csb_pool),
+	  m_aggregates(csb->csb_pool),
+	  m_mappings(csb->csb_pool),
+	  m_keyLength(0),
+	  m_fetchData(false)
+{
+	fb_assert(m_next && m_map);
+
+	m_impure = csb->allocImpure<Impure>();
+	m_cardinality = next->getCardinality();
+
+	const auto relSource = nodeAs<RelationSourceNode>(rse->rse_relations[0]);
+	const StreamType relStream = relSource->getStream();
+	m_relation = relSource->relation;
+
+	if (rse->rse_boolean)
+	{
+		HalfStaticArray<BoolExprNode*, OPT_STATIC_ITEMS> conjuncts;
+		decompose(rse->rse_boolean, conjuncts);
+
+		for (const auto conjunct : conjuncts)
+		{
+			Predicate predicate;
+			const bool supported = getPredicate(tdbb, csb, relStream, conjunct, &predicate);
+			fb_assert(supported);
+			m_predicates.add(predicate);
+		}
+	}
+
+	// Group key values are aligned inside the key, every one is followed by its null flag
+
+	if (group)
+	{
+		for (auto& node : group->expressions)
+		{
+			Key key;
+			const FieldNode* const field = getField(tdbb, csb, relStream, node, &key.desc);
+			fb_assert(field);
+
+			m_keyLength = FB_ALIGN(m_keyLength, type_alignments[key.desc.dsc_dtype]);
+			key.desc.dsc_address = (UCHAR*)(IPTR) m_keyLength;
+			m_keyLength += key.desc.dsc_length;
+			key.nullOffset = m_keyLength++;
+			key.fieldId = field->fieldId;
+
+			m_keys.add(key);
+		}
+	}
+
+	NestConst<ValueExprNode>* const sourceEnd = map->sourceList.end();
+
+	for (NestConst<ValueExprNode>* source = map->sourceList.begin(),
+			*target = map->targetList.begin();
+		 source != sourceEnd;
+		 ++source, ++target)
+	{
+		Mapping mapping;
+		mapping.target = *target;
+		mapping.aggNode = nodeAs<AggNode>(*source);
+
+		if (mapping.aggNode)
+		{
+			Aggregate aggregate;
+			aggregate.aggNode = mapping.aggNode;
+			aggregate.fieldId = NO_FIELD;
+
+			if (const auto field = nodeAs<FieldNode>(mapping.aggNode->arg))
+				aggregate.fieldId = field->fieldId;
+
+			mapping.index = m_aggregates.getCount();
+			m_aggregates.add(aggregate);
+		}
+		else
+		{
+			const FieldNode* const field = nodeAs<FieldNode>(*source);
+			fb_assert(field);
+
+			for (mapping.index = 0; mapping.index < m_keys.getCount(); mapping.index++)
+			{
+				if (m_keys[mapping.index].fieldId == field->fieldId)
+					break;
+			}
+
+			fb_assert(mapping.index < m_keys.getCount());
+		}
+
+		m_mappings.add(mapping);
+	}
+
+	m_fetchData = m_predicates.hasData() || m_keys.hasData();
+
+	for (const auto& aggregate : m_aggregates)
+	{
+		if (aggregate.fieldId != NO_FIELD)
+			m_fetchData = true;
+	}
+}
+
+// Check whether the workers are able to evaluate the whole aggregation on their own
+bool ParallelAggregatedStream::isSupported(thread_db* tdbb, CompilerScratch* csb, RseNode* rse,
+	SortNode* group, MapNode* map)
+{
+	if (rse->rse_relations.getCount() != 1 || rse->rse_first || rse->rse_skip ||
+		(rse->rse_sorted && rse->rse_sorted != group) || rse->rse_projection ||
+		rse->rse_aggregate || rse->rse_plan)
+	{
+		return false;
+	}
+
+	const auto relSource = nodeAs<RelationSourceNode>(rse->rse_relations[0]);
+	const jrd_rel* const relation = relSource ? relSource->relation : NULL;
+
+	// Temporary tables are invisible to the worker attachments,
+	// other non-regular ones are not stored in the data pages
+
+	if (!relation || relation->isTemporary() || relation->isVirtual() ||
+		relation->isView() || relation->rel_file)
+	{
+		return false;
+	}
+
+	const StreamType stream = relSource->getStream();
+
+	// The workers split the table by its pointer pages, so it makes sense
+	// only if the optimizer has not found a better way to read the table
+
+	if (!(csb->csb_rpt[stream].csb_flags & csb_full_scan))
+		return false;
+
+	if (rse->rse_boolean)
+	{
+		HalfStaticArray<BoolExprNode*, OPT_STATIC_ITEMS> conjuncts;
+		decompose(rse->rse_boolean, conjuncts);
+
+		for (const auto conjunct : conjuncts)
+		{
+			Predicate predicate;
+
+			if (!getPredicate(tdbb, csb, stream, conjunct, &predicate))
+				return false;
+		}
+	}
+
+	if (group)
+	{
+		for (auto& node : group->expressions)
+		{
+			dsc desc;
+
+			if (!getField(tdbb, csb, stream, node, &desc) || !isExactType(desc))
+				return false;
+		}
+	}
+
+	if (map->sourceList.isEmpty())
+		return false;
+
+	for (auto& source : map->sourceList)
+	{
+		const auto aggNode = nodeAs<AggNode>(source);
+
+		if (!aggNode)
+		{
+			// Only the group keys are mapped as is
+
+			const auto field = nodeAs<FieldNode>(source);
+			bool found = false;
+
+			if (field && group)
+			{
+				for (auto& node : group->expressions)
+				{
+					const auto keyField = nodeAs<FieldNode>(node);
+
+					if (keyField->fieldStream == field->fieldStream && keyField->fieldId == field->fieldId)
+						found = true;
+				}
+			}
+
+			if (!found)
+				return false;
+
+			continue;
+		}
+
+		if (aggNode->distinct || aggNode->indexed)
+			return false;
+
+		const UCHAR blr = aggNode->aggInfo.blr;
+
+		if (blr == blr_agg_count2 && !aggNode->arg)
+			continue;
+
+		if (blr != blr_agg_count2 && blr != blr_agg_total && blr != blr_agg_min && blr != blr_agg_max)
+			return false;
+
+		dsc desc;
+
+		if (!getField(tdbb, csb, stream, aggNode->arg, &desc))
+			return false;
+
+		// SUM of exact numerics does not depend on the order of the values
+
+		if (blr == blr_agg_total && (!desc.isExact() || aggNode->dialect1))
+			return false;
+
+		if ((blr == blr_agg_min || blr == blr_agg_max) && !isExactType(desc))
+			return false;
+	}
+
+	return true;
+}
+
+// Recognize the field compared with a literal or parameter
+bool ParallelAggregatedStream::getPredicate(thread_db* tdbb, CompilerScratch* csb, StreamType stream,
+	BoolExprNode* conjunct, Predicate* predicate)
+{
+	ValueExprNode* field = nullptr;
+
+	predicate->value = nullptr;
+	predicate->upper = nullptr;
+	predicate->blrOp = 0;
+
+	if (const auto cmpNode = nodeAs<ComparativeBoolNode>(conjunct))
+	{
+		switch (cmpNode->blrOp)
+		{
+			case blr_eql:
+			case blr_neq:
+			case blr_gtr:
+			case blr_geq:
+			case blr_lss:
+			case blr_leq:
+				if (isValue(cmpNode->arg2))
+				{
+					field = cmpNode->arg1;
+					predicate->value = cmpNode->arg2;
+					predicate->blrOp = cmpNode->blrOp;
+				}
+				else if (isValue(cmpNode->arg1))
+				{
+					// Swap the arguments to have the field on the left side
+					static const UCHAR swappedOps[][2] =
+					{
+						{blr_eql, blr_eql}, {blr_neq, blr_neq},
+						{blr_gtr, blr_lss}, {blr_geq, blr_leq},
+						{blr_lss, blr_gtr}, {blr_leq, blr_geq}
+					};
+
+					field = cmpNode->arg2;
+					predicate->value = cmpNode->arg1;
+
+					for (const auto& ops : swappedOps)
+					{
+						if (ops[0] == cmpNode->blrOp)
+							predicate->blrOp = ops[1];
+					}
+				}
+				break;
+
+			case blr_between:
+				if (isValue(cmpNode->arg2) && isValue(cmpNode->arg3))
+				{
+					field = cmpNode->arg1;
+					predicate->value = cmpNode->arg2;
+					predicate->upper = cmpNode->arg3;
+					predicate->blrOp = cmpNode->blrOp;
+				}
+				break;
+		}
+	}
+	else if (const auto missingNode = nodeAs<MissingBoolNode>(conjunct))
+	{
+		field = missingNode->arg;
+		predicate->blrOp = blr_missing;
+	}
+	else if (const auto notNode = nodeAs<NotBoolNode>(conjunct))
+	{
+		if (const auto notMissingNode = nodeAs<MissingBoolNode>(notNode->arg))
+		{
+			field = notMissingNode->arg;
+			predicate->blrOp = blr_not;
+		}
+	}
+
+	dsc desc;
+	const FieldNode* const fieldNode = field ? getField(tdbb, csb, stream, field, &desc) : nullptr;
+
+	if (!fieldNode)
+		return false;
+
+	// IS [NOT] NULL checks only the null flag
+
+	if (predicate->value && !isComparableType(desc))
+		return false;
+
+	predicate->fieldId = fieldNode->fieldId;
+	return true;
+}
+
+void ParallelAggregatedStream::internalOpen(thread_db* tdbb) const
+{
+	Request* const request = tdbb->getRequest();
+	Impure* const impure = request->getImpure<Impure>(m_impure);
+
+	impure->irsb_flags = irsb_open;
+	impure->irsb_state = STATE_PENDING;
+	impure->irsb_position = 0;
+
+	delete impure->irsb_table;
+	impure->irsb_table = nullptr;
+
+	VIO_record(tdbb, &request->req_rpb[m_stream], m_format, tdbb->getDefaultPool());
+}
+
+void ParallelAggregatedStream::close(thread_db* tdbb) const
+{
+	Request* const request = tdbb->getRequest();
+
+	invalidateRecords(request);
+
+	Impure* const impure = request->getImpure<Impure>(m_impure);
+
+	if (impure->irsb_flags & irsb_open)
+	{
+		impure->irsb_flags &= ~irsb_open;
+
+		delete impure->irsb_table;
+		impure->irsb_table = nullptr;
+
+		m_next->close(tdbb);
+	}
+}
+
+bool ParallelAggregatedStream::internalGetRecord(thread_db* tdbb) const
+{
+	JRD_reschedule(tdbb);
+
+	Request* const request = tdbb->getRequest();
+	record_param* const rpb = &request->req_rpb[m_stream];
+	Impure* const impure = request->getImpure<Impure>(m_impure);
+
+	if (!(impure->irsb_flags & irsb_open))
+	{
+		rpb->rpb_number.setValid(false);
+		return false;
+	}
+
+	if (impure->irsb_state == STATE_PENDING)
+	{
+		if (aggregateParallel(tdbb, impure))
+			impure->irsb_state = STATE_OUTPUT;
+		else
+		{
+			impure->irsb_state = STATE_FALLBACK;
+			m_next->open(tdbb);
+		}
+	}
+
+	if (impure->irsb_state == STATE_FALLBACK)
+		return m_next->getRecord(tdbb);
+
+	GroupTable* const table = impure->irsb_table;
+
+	if (impure->irsb_position >= table->getCount())
+	{
+		rpb->rpb_number.setValid(false);
+		return false;
+	}
+
+	outputGroup(tdbb, request, table, impure->irsb_position++);
+
+	rpb->rpb_number.setValid(true);
+	return true;
+}
+
+bool ParallelAggregatedStream::refetchRecord(thread_db* tdbb) const
+{
+	Request* const request = tdbb->getRequest();
+	Impure* const impure = request->getImpure<Impure>(m_impure);
+
+	if (impure->irsb_state == STATE_FALLBACK)
+		return m_next->refetchRecord(tdbb);
+
+	return true;
+}
+
+WriteLockResult ParallelAggregatedStream::lockRecord(thread_db* /*tdbb*/) const
+{
+	status_exception::raise(Arg::Gds(isc_record_lock_not_supp));
+}
+
+void ParallelAggregatedStream::getLegacyPlan(thread_db* tdbb, string& plan, unsigned level) const
+{
+	m_next->getLegacyPlan(tdbb, plan, level);
+}
+
+void ParallelAggregatedStream::internalGetPlan(thread_db* tdbb, PlanEntry& planEntry, unsigned level, bool recurse) const
+{
+	planEntry.className = "ParallelAggregatedStream";
+
+	planEntry.lines.add().text = "Parallel Aggregate";
+	printOptInfo(planEntry.lines);
+
+	if (recurse)
+	{
+		++level;
+		m_next->getPlan(tdbb, planEntry.children.add(), level, recurse);
+	}
+}
+
+void ParallelAggregatedStream::markRecursive()
+{
+	m_next->markRecursive();
+}
+
+void ParallelAggregatedStream::invalidateRecords(Request* request) const
+{
+	m_next->invalidateRecords(request);
+}
+
+void ParallelAggregatedStream::findUsedStreams(StreamList& streams, bool expandAll) const
+{
+	RecordStream::findUsedStreams(streams);
+
+	if (expandAll)
+		m_next->findUsedStreams(streams, true);
+}
+
+// Aggregate the table using the parallel workers, if possible
+bool ParallelAggregatedStream::aggregateParallel(thread_db* tdbb, Impure* impure) const
+{
+	Database* const dbb = tdbb->getDatabase();
+	Attachment* const attachment = tdbb->getAttachment();
+	Request* const request = tdbb->getRequest();
+	jrd_tra* const transaction = request->req_transaction;
+
+	if (attachment->att_parallel_workers <= 1)
+		return false;
+
+	// Classic in single-user shutdown mode can't create additional worker attachments
+	if ((dbb->dbb_ast_flags & DBB_shutdown_single) && !(dbb->dbb_flags & DBB_shared))
+		return false;
+
+	// Workers cannot see the changes made by the current transaction
+
+	if ((transaction->tra_flags & (TRA_system | TRA_write)) || transaction->tra_commit_sub_trans)
+		return false;
+
+	CommitNumber snapshot = 0;
+
+	if (!(transaction->tra_flags & TRA_read_committed))
+		snapshot = transaction->tra_snapshot_number;
+	else if (transaction->tra_flags & TRA_read_consistency)
+	{
+		const Request* const snapshotRequest = request->req_snapshot.m_owner;
+
+		if (snapshotRequest && !(snapshotRequest->req_flags & req_update_conflict))
+			snapshot = snapshotRequest->req_snapshot.m_number;
+	}
+
+	// Read committed transactions without the statement level snapshot
+	// may see different data than any single snapshot does
+	if (!snapshot)
+		return false;
+
+	if (DPM_pointer_pages(tdbb, m_relation) <= 1)
+		return false;
+
+	// Evaluate the values the fields are compared with. A NULL value
+	// never satisfies the comparison, so no record is aggregated then.
+
+	HalfStaticArray<impure_value, 8> values;
+	values.resize(m_predicates.getCount() * 2);
+
+	bool empty = false;
+
+	for (FB_SIZE_T i = 0; i < m_predicates.getCount(); i++)
+	{
+		const Predicate& predicate = m_predicates[i];
+		const ValueExprNode* const nodes[2] = {predicate.value, predicate.upper};
+
+		for (unsigned j = 0; j < 2; j++)
+		{
+			if (!nodes[j])
+				continue;
+
+			const dsc* const desc = EVL_expr(tdbb, request, nodes[j]);
+
+			if (!desc || (request->req_flags & req_null))
+			{
+				request->req_flags &= ~req_null;
+				empty = true;
+				continue;
+			}
+
+			if (!isComparableType(*desc))
+				return false;
+
+			EVL_make_value(tdbb, desc, &values[i * 2 + j]);
+		}
+	}
+
+	GroupTable* const table = FB_NEW_POOL(*tdbb->getDefaultPool())
+		GroupTable(*tdbb->getDefaultPool(), m_keyLength, m_aggregates.getCount());
+	impure->irsb_table = table;
+
+	// Aggregation without grouping returns a single row even for no records
+
+	if (m_keys.isEmpty())
+	{
+		const UCHAR noKey = 0;
+		findGroup(table, &noKey, MAX_ULONG);
+	}
+
+	if (empty)
+		return true;
+
+	RLCK_reserve_relation(tdbb, transaction, m_relation, false);
+
+	AggregateTask task(tdbb, transaction, this, values.begin(), snapshot);
+
+	{
+		EngineCheckout cout(tdbb, FB_FUNCTION);
+
+		Coordinator coord(dbb->dbb_permanent);
+		coord.runSync(&task);
+	}
+
+	FbLocalStatus localStatus;
+
+	if (!task.getResult(&localStatus))
+		localStatus.raise();
+
+	if (task.isOverflow())
+	{
+		delete impure->irsb_table;
+		impure->irsb_table = nullptr;
+		return false;
+	}
+
+	task.merge(tdbb, table);
+	return true;
+}
+
+// Check whether the record satisfies all the predicates
+bool ParallelAggregatedStream::checkRecord(thread_db* tdbb, jrd_rel* relation, Record* record,
+	const impure_value* values) const
+{
+	for (FB_SIZE_T i = 0; i < m_predicates.getCount(); i++)
+	{
+		const Predicate& predicate = m_predicates[i];
+
+		dsc desc;
+		const bool isNull = !EVL_field(relation, record, predicate.fieldId, &desc);
+
+		if (predicate.blrOp == blr_missing || predicate.blrOp == blr_not)
+		{
+			if (isNull != (predicate.blrOp == blr_missing))
+				return false;
+
+			continue;
+		}
+
+		if (isNull)
+			return false;
+
+		const impure_value* const value = &values[i * 2];
+		const impure_value* const upper = &values[i * 2 + 1];
+
+		const int comparison = MOV_compare(tdbb, &desc, &value->vlu_desc);
+		bool result = false;
+
+		switch (predicate.blrOp)
+		{
+			case blr_eql:
+				result = (comparison == 0);
+				break;
+
+			case blr_neq:
+				result = (comparison != 0);
+				break;
+
+			case blr_gtr:
+				result = (comparison > 0);
+				break;
+
+			case blr_geq:
+				result = (comparison >= 0);
+				break;
+
+			case blr_lss:
+				result = (comparison < 0);
+				break;
+
+			case blr_leq:
+				result = (comparison <= 0);
+				break;
+
+			case blr_between:
+				result = (comparison >= 0 && MOV_compare(tdbb, &desc, &upper->vlu_desc) <= 0);
+				break;
+
+			default:
+				fb_assert(false);
+		}
+
+		if (!result)
+			return false;
+	}
+
+	return true;
+}
+
+// Store the group key values of the record in their binary form
+void ParallelAggregatedStream::makeKey(thread_db* tdbb, jrd_rel* relation, Record* record, UCHAR* key) const
+{
+	if (m_keys.isEmpty())
+		return;
+
+	memset(key, 0, m_keyLength);
+
+	for (const auto& item : m_keys)
+	{
+		dsc desc;
+
+		if (!EVL_field(relation, record, item.fieldId, &desc))
+		{
+			key[item.nullOffset] = 1;
+			continue;
+		}
+
+		// Records of the older formats may store the field in another data type
+
+		dsc to = item.desc;
+		to.dsc_address = key + (IPTR) item.desc.dsc_address;
+		MOV_move(tdbb, &desc, &to);
+	}
+}
+
+// Find the group of the key or create it, unless there are too many groups already
+impure_value_ex* ParallelAggregatedStream::findGroup(GroupTable* table, const UCHAR* key,
+	ULONG maxGroups) const
+{
+	const ULONG hash = InternalHash::hash(m_keyLength, key);
+	impure_value_ex* states = table->find(hash, key);
+
+	if (states)
+		return states;
+
+	if (table->getCount() >= maxGroups)
+		return nullptr;
+
+	states = table->add(hash, key);
+
+	// The same as aggInit() does
+
+	for (FB_SIZE_T i = 0; i < m_aggregates.getCount(); i++)
+	{
+		states[i].make_int64(0, m_aggregates[i].aggNode->nodScale);
+		states[i].vlux_count = 0;
+	}
+
+	return states;
+}
+
+// Pass the record fields to the aggregate states of its group
+void ParallelAggregatedStream::accumulate(thread_db* tdbb, jrd_rel* relation, Record* record,
+	impure_value_ex* states) const
+{
+	for (const auto& aggregate : m_aggregates)
+	{
+		impure_value_ex* const state = states++;
+
+		if (aggregate.fieldId == NO_FIELD)
+		{
+			++state->vlux_count;
+			continue;
+		}
+
+		dsc desc;
+
+		if (EVL_field(relation, record, aggregate.fieldId, &desc))
+			passValue(tdbb, aggregate.aggNode, state, &desc, 1);
+	}
+}
+
+// Add the partial aggregate states of a worker to the states of the same group
+void ParallelAggregatedStream::mergeStates(thread_db* tdbb, impure_value_ex* states,
+	const impure_value_ex* source) const
+{
+	for (const auto& aggregate : m_aggregates)
+	{
+		impure_value_ex* const state = states++;
+		const impure_value_ex* const partial = source++;
+
+		if (partial->vlux_count)
+			passValue(tdbb, aggregate.aggNode, state, &partial->vlu_desc, partial->vlux_count);
+	}
+}
+
+// Pass the value into the aggregate state, the same way the aggregate does.
+// The value may be the partial result of the same aggregate over "count" values.
+void ParallelAggregatedStream::passValue(thread_db* tdbb, const AggNode* aggNode, impure_value_ex* state,
+	const dsc* desc, SINT64 count) const
+{
+	switch (aggNode->aggInfo.blr)
+	{
+		case blr_agg_total:
+			ArithmeticNode::add2(tdbb, desc, state, aggNode, blr_add);
+			break;
+
+		case blr_agg_min:
+		case blr_agg_max:
+			if (state->vlux_count)
+			{
+				const int result = MOV_compare(tdbb, desc, &state->vlu_desc);
+
+				if (aggNode->aggInfo.blr == blr_agg_max ? result <= 0 : result >= 0)
+					break;
+			}
+
+			EVL_make_value(tdbb, desc, state);
+			break;
+	}
+
+	state->vlux_count += count;
+}
+
+// Assign the aggregated values of the group to the output record
+void ParallelAggregatedStream::outputGroup(thread_db* tdbb, Request* request, GroupTable* table,
+	ULONG group) const
+{
+	const UCHAR* const key = table->getKey(group);
+	impure_value_ex* const states = table->getStates(group);
+
+	for (const auto& mapping : m_mappings)
+	{
+		const FieldNode* const field = nodeAs<FieldNode>(mapping.target);
+		const USHORT id = field->fieldId;
+		Record* const record = request->req_rpb[field->fieldStream].rpb_record;
+
+		dsc* desc = nullptr;
+		dsc value;
+
+		if (const AggNode* const aggNode = mapping.aggNode)
+		{
+			// Produce the same values as the regular aggregation would do
+
+			const impure_value_ex* const state = &states[mapping.index];
+
+			aggNode->aggInit(tdbb, request);
+
+			if (aggNode->aggInfo.blr == blr_agg_count2)
+			{
+				impure_value_ex* const aggImpure = request->getImpure<impure_value_ex>(aggNode->impureOffset);
+
+				if (aggNode->dialect1)
+					aggImpure->vlu_misc.vlu_long = (SLONG) state->vlux_count;
+				else
+					aggImpure->vlu_misc.vlu_int64 = state->vlux_count;
+			}
+			else if (state->vlux_count)
+			{
+				// SUM adds the total to its zero, MIN and MAX take the value as is
+				aggNode->aggPass(tdbb, request, const_cast<dsc*>(&state->vlu_desc));
+			}
+
+			desc = aggNode->execute(tdbb, request);
+		}
+		else
+		{
+			const Key& item = m_keys[mapping.index];
+
+			if (!key[item.nullOffset])
+			{
+				value = item.desc;
+				value.dsc_address = const_cast<UCHAR*>(key) + (IPTR) item.desc.dsc_address;
+				desc = &value;
+			}
+		}
+
+		if (!desc || !desc->dsc_dtype)
+			record->setNull(id);
+		else
+		{
+			MOV_move(tdbb, desc, EVL_assign_to(tdbb, mapping.target));
+			record->clearNull(id);
+		}
+	}
+}
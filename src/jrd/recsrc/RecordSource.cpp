@@ -362,3 +362,19 @@ void RecordStream::nullRecords(thread_db* tdbb) const
 
 	record->fakeNulls();
 }
+
+bool RecordStream::acceptJoinFilter(const HashJoin* join, const StreamList& keyStreams)
+{
+	// Only one filter is accepted, it's enough for the innermost hash join
+
+	if (m_joinFilter || keyStreams.getCount() != 1 || keyStreams[0] != m_stream)
+		return false;
+
+	m_joinFilter = join;
+	return true;
+}
+
+bool RecordStream::checkJoinFilter(thread_db* tdbb) const
+{
+	return !m_joinFilter || m_joinFilter->checkFilter(tdbb);
+}
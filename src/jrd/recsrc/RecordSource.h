@@ -41,6 +41,7 @@ namespace Jrd
 	class jrd_prc;
 	class AggNode;
 	class BoolExprNode;
+	class FieldNode;
 	class DeclareLocalTableNode;
 	class Sort;
 	class CompilerScratch;
@@ -51,6 +52,7 @@ namespace Jrd
 	struct win;
 	class BaseBufferedStream;
 	class BufferedStream;
+	class HashJoin;
 	class PlanEntry;
 
 	enum JoinType { INNER_JOIN, OUTER_JOIN, SEMI_JOIN, ANTI_JOIN };
@@ -154,6 +156,13 @@ namespace Jrd
 			fb_assert(false);
 		}
 
+		// Accept the filter of the hash join led by this record source,
+		// if the join keys (referencing the given streams) can be checked here
+		virtual bool pushJoinFilter(const HashJoin* /*join*/, const StreamList& /*keyStreams*/)
+		{
+			return false;
+		}
+
 		static bool rejectDuplicate(const UCHAR* /*data1*/, const UCHAR* /*data2*/, void* /*userArg*/)
 		{
 			return true;
@@ -218,8 +227,12 @@ namespace Jrd
 		void nullRecords(thread_db* tdbb) const override;
 
 	protected:
+		bool acceptJoinFilter(const HashJoin* join, const StreamList& keyStreams);
+		bool checkJoinFilter(thread_db* tdbb) const;
+
 		const StreamType m_stream;
 		const Format* const m_format;
+		const HashJoin* m_joinFilter = nullptr;
 	};
 
 
@@ -242,6 +255,11 @@ namespace Jrd
 
 		void getLegacyPlan(thread_db* tdbb, Firebird::string& plan, unsigned level) const override;
 
+		bool pushJoinFilter(const HashJoin* join, const StreamList& keyStreams) override
+		{
+			return acceptJoinFilter(join, keyStreams);
+		}
+
 	protected:
 		void internalGetPlan(thread_db* tdbb, PlanEntry& planEntry, unsigned level, bool recurse) const override;
 		void internalOpen(thread_db* tdbb) const override;
@@ -269,6 +287,11 @@ namespace Jrd
 
 		void getLegacyPlan(thread_db* tdbb, Firebird::string& plan, unsigned level) const override;
 
+		bool pushJoinFilter(const HashJoin* join, const StreamList& keyStreams) override
+		{
+			return acceptJoinFilter(join, keyStreams);
+		}
+
 	protected:
 		void internalGetPlan(thread_db* tdbb, PlanEntry& planEntry, unsigned level, bool recurse) const override;
 		void internalOpen(thread_db* tdbb) const override;
@@ -311,6 +334,11 @@ namespace Jrd
 
 		void getLegacyPlan(thread_db* tdbb, Firebird::string& plan, unsigned level) const override;
 
+		bool pushJoinFilter(const HashJoin* join, const StreamList& keyStreams) override
+		{
+			return acceptJoinFilter(join, keyStreams);
+		}
+
 		void setInversion(InversionNode* inversion, BoolExprNode* condition)
 		{
 			fb_assert(!m_inversion && !m_condition);
@@ -600,6 +628,8 @@ namespace Jrd
 			m_ansiNot = ansiNot;
 		}
 
+		bool pushJoinFilter(const HashJoin* join, const StreamList& keyStreams) override;
+
 	protected:
 		void internalGetPlan(thread_db* tdbb, PlanEntry& planEntry, unsigned level, bool recurse) const override;
 		void internalOpen(thread_db* tdbb) const override;
@@ -608,11 +638,28 @@ namespace Jrd
 		bool m_invariant = false;
 
 	private:
+		// Comparison of a table field with a literal or parameter value,
+		// evaluated directly against the record buffer
+		struct FastPredicate
+		{
+			const BoolExprNode* node;		// original conjunct, used as a fallback
+			const FieldNode* field;
+			const ValueExprNode* value;
+			const ValueExprNode* upper;		// upper bound of BETWEEN
+			UCHAR blrOp;
+		};
+
 		bool evaluateBoolean(thread_db* tdbb) const;
+		bool evaluateConjuncts(thread_db* tdbb, Request* request) const;
+		bool evaluatePredicate(thread_db* tdbb, Request* request, const FastPredicate& predicate) const;
+		void preparePredicates(CompilerScratch* csb, BoolExprNode* boolean);
 
 		NestConst<RecordSource> m_next;
 		NestConst<BoolExprNode> const m_boolean;
 		NestConst<BoolExprNode> m_anyBoolean;
+		NestConst<BoolExprNode> m_residual;
+		Firebird::Array<FastPredicate> m_predicates;
+		const HashJoin* m_joinFilter = nullptr;
 		bool m_ansiAny;
 		bool m_ansiAll;
 		bool m_ansiNot;
@@ -724,6 +771,12 @@ namespace Jrd
 			return m_map->keyLength;
 		}
 
+		void setLimit(ValueExprNode* first, ValueExprNode* skip)
+		{
+			m_first = first;
+			m_skip = skip;
+		}
+
 		bool compareKeys(const UCHAR* p, const UCHAR* q) const;
 
 		UCHAR* getData(thread_db* tdbb) const;
@@ -752,6 +805,8 @@ namespace Jrd
 
 		NestConst<RecordSource> m_next;
 		const SortMap* const m_map;
+		NestConst<ValueExprNode> m_first;
+		NestConst<ValueExprNode> m_skip;
 	};
 
 	// Make moves in a window without going out of partition boundaries.
@@ -932,6 +987,211 @@ namespace Jrd
 		bool internalGetRecord(thread_db* tdbb) const override;
 	};
 
+	// Aggregation performed via hashing the group values, the input stream does not have to be sorted.
+	// Groups are returned in no particular order.
+
+	class HashAggregatedStream final : public RecordStream
+	{
+		class GroupTable;
+
+		enum State
+		{
+			STATE_INPUT,		// Aggregating the input stream
+			STATE_SPILLED,		// Aggregating the records spilled during the prior pass
+			STATE_OUTPUT,		// Returning the aggregated groups
+			STATE_EOF			// Everything is processed
+		};
+
+		struct Impure : public RecordSource::Impure
+		{
+			GroupTable* irsb_table;
+			TempSpace* irsb_input;		// spilled records being aggregated
+			TempSpace* irsb_spill;		// records spilled during the current pass
+			FB_UINT64 irsb_input_count;
+			FB_UINT64 irsb_spill_count;
+			ULONG irsb_position;
+			State irsb_state;
+		};
+
+		// Value to be computed for every input record and stored inside the tuple
+		struct Item
+		{
+			NestConst<ValueExprNode> node;
+			dsc desc;					// relative descriptor
+			ULONG nullOffset;			// offset of the null flag
+		};
+
+		// Map source assigned to the target
+		struct Mapping
+		{
+			NestConst<ValueExprNode> target;
+			const AggNode* aggNode;		// aggregate function, if any
+			ULONG item;					// index of the item with either the value or the argument
+		};
+
+		static const ULONG NO_ITEM = MAX_ULONG;
+
+	public:
+		HashAggregatedStream(thread_db* tdbb, CompilerScratch* csb, StreamType stream,
+			NestValueArray* group, MapNode* map, RecordSource* next);
+
+		static bool isSupported(thread_db* tdbb, CompilerScratch* csb,
+			NestValueArray* group, MapNode* map);
+
+		static unsigned maxCapacity();
+
+		void close(thread_db* tdbb) const override;
+
+		bool refetchRecord(thread_db* tdbb) const override;
+		WriteLockResult lockRecord(thread_db* tdbb) const override;
+
+		void getLegacyPlan(thread_db* tdbb, Firebird::string& plan, unsigned level) const override;
+
+		void markRecursive() override;
+		void invalidateRecords(Request* request) const override;
+
+		void findUsedStreams(StreamList& streams, bool expandAll = false) const override;
+
+	protected:
+		void internalGetPlan(thread_db* tdbb, PlanEntry& planEntry, unsigned level, bool recurse) const override;
+		void internalOpen(thread_db* tdbb) const override;
+		bool internalGetRecord(thread_db* tdbb) const override;
+
+	private:
+		void makeTuple(thread_db* tdbb, Request* request, UCHAR* tuple) const;
+		void processTuple(thread_db* tdbb, Request* request, Impure* impure, const UCHAR* tuple) const;
+		void saveStates(Request* request, UCHAR* states) const;
+		void loadStates(Request* request, const UCHAR* states) const;
+		void outputGroup(thread_db* tdbb, Request* request, ULONG group) const;
+		void releaseSpill(Impure* impure) const;
+
+		NestConst<RecordSource> m_next;
+		const NestValueArray* const m_group;
+		NestConst<MapNode> m_map;
+		Firebird::Array<ULONG> m_keyLengths;
+		Firebird::Array<Item> m_items;
+		Firebird::Array<Mapping> m_mappings;
+		Firebird::Array<const AggNode*> m_aggregates;
+		ULONG m_keyLength;			// length of the group key part of the tuple
+		ULONG m_tupleLength;		// length of the tuple
+		ULONG m_groupLength;		// length of the tuple plus aggregate states
+	};
+
+	// Aggregation of a single table scanned by the parallel workers. The table is split
+	// between the workers one pointer page at a time. Each of them reads its part inside
+	// the snapshot shared with the current transaction, filters the records and keeps
+	// the partial aggregates of every group. The leader merges them afterwards.
+	//
+	// The workers run in their own attachments and can't evaluate expressions compiled
+	// for the current request, so only the queries computed directly from the record
+	// fields are handled: a conjunction of the field comparisons with literals or
+	// parameters (their values are evaluated by the leader), grouping by fields of
+	// the exact data types, COUNT, SUM of exact numerics, MIN and MAX. If the parallel
+	// scan is not possible at runtime, the regular aggregation passed as "next" is used.
+
+	class ParallelAggregatedStream final : public RecordStream
+	{
+		class AggregateTask;
+		class GroupTable;
+
+		enum State
+		{
+			STATE_PENDING,		// The table is not scanned yet
+			STATE_OUTPUT,		// Returning the groups aggregated by the workers
+			STATE_FALLBACK		// Returning the groups of the regular aggregation
+		};
+
+		struct Impure : public RecordSource::Impure
+		{
+			GroupTable* irsb_table;
+			ULONG irsb_position;
+			State irsb_state;
+		};
+
+		// Field compared with a literal or parameter, IS [NOT] NULL has no value
+		struct Predicate
+		{
+			NestConst<ValueExprNode> value;
+			NestConst<ValueExprNode> upper;	// upper bound of BETWEEN
+			USHORT fieldId;
+			UCHAR blrOp;
+		};
+
+		// Field which the records are grouped by
+		struct Key
+		{
+			dsc desc;					// relative descriptor inside the group key
+			ULONG nullOffset;			// offset of the null flag
+			USHORT fieldId;
+		};
+
+		struct Aggregate
+		{
+			const AggNode* aggNode;
+			USHORT fieldId;				// argument, NO_FIELD for COUNT(*)
+		};
+
+		// Map source assigned to the target
+		struct Mapping
+		{
+			NestConst<ValueExprNode> target;
+			const AggNode* aggNode;		// aggregate function, if any
+			ULONG index;				// index of either the aggregate or the key
+		};
+
+		static const USHORT NO_FIELD = MAX_USHORT;
+
+	public:
+		ParallelAggregatedStream(thread_db* tdbb, CompilerScratch* csb, StreamType stream,
+			RseNode* rse, SortNode* group, MapNode* map, RecordSource* next);
+
+		static bool isSupported(thread_db* tdbb, CompilerScratch* csb, RseNode* rse,
+			SortNode* group, MapNode* map);
+
+		void close(thread_db* tdbb) const override;
+
+		bool refetchRecord(thread_db* tdbb) const override;
+		WriteLockResult lockRecord(thread_db* tdbb) const override;
+
+		void getLegacyPlan(thread_db* tdbb, Firebird::string& plan, unsigned level) const override;
+
+		void markRecursive() override;
+		void invalidateRecords(Request* request) const override;
+
+		void findUsedStreams(StreamList& streams, bool expandAll = false) const override;
+
+	protected:
+		void internalGetPlan(thread_db* tdbb, PlanEntry& planEntry, unsigned level, bool recurse) const override;
+		void internalOpen(thread_db* tdbb) const override;
+		bool internalGetRecord(thread_db* tdbb) const override;
+
+	private:
+		static bool getPredicate(thread_db* tdbb, CompilerScratch* csb, StreamType stream,
+			BoolExprNode* conjunct, Predicate* predicate);
+
+		bool aggregateParallel(thread_db* tdbb, Impure* impure) const;
+		bool checkRecord(thread_db* tdbb, jrd_rel* relation, Record* record,
+			const impure_value* values) const;
+		void makeKey(thread_db* tdbb, jrd_rel* relation, Record* record, UCHAR* key) const;
+		impure_value_ex* findGroup(GroupTable* table, const UCHAR* key, ULONG maxGroups) const;
+		void accumulate(thread_db* tdbb, jrd_rel* relation, Record* record,
+			impure_value_ex* states) const;
+		void mergeStates(thread_db* tdbb, impure_value_ex* states, const impure_value_ex* source) const;
+		void passValue(thread_db* tdbb, const AggNode* aggNode, impure_value_ex* state,
+			const dsc* desc, SINT64 count) const;
+		void outputGroup(thread_db* tdbb, Request* request, GroupTable* table, ULONG group) const;
+
+		NestConst<RecordSource> m_next;
+		NestConst<MapNode> m_map;
+		jrd_rel* m_relation;
+		Firebird::Array<Predicate> m_predicates;
+		Firebird::Array<Key> m_keys;
+		Firebird::Array<Aggregate> m_aggregates;
+		Firebird::Array<Mapping> m_mappings;
+		ULONG m_keyLength;
+		bool m_fetchData;			// whether the record data is needed, not just the record count
+	};
+
 	class WindowedStream : public RecordSource
 	{
 	public:
@@ -1016,6 +1276,8 @@ namespace Jrd
 			SINT64 locateFrameRange(thread_db* tdbb, Request* request, Impure* impure,
 				const Frame* frame, const dsc* offsetDesc, SINT64 position) const;
 
+			bool aggUnpass(thread_db* tdbb, Request* request) const;
+
 		private:
 			NestConst<SortNode> m_order;
 			const MapNode* m_windowMap;
@@ -1025,6 +1287,7 @@ namespace Jrd
 			NestValueArray m_winPassSources, m_winPassTargets;
 			Exclusion m_exclusion;
 			UCHAR m_invariantOffsets;	// 0x1 | 0x2 bitmask
+			bool m_invertible;			// all aggregates may remove rows from the window
 		};
 
 	public:
@@ -1152,6 +1415,8 @@ namespace Jrd
 		void findUsedStreams(StreamList& streams, bool expandAll = false) const override;
 		void nullRecords(thread_db* tdbb) const override;
 
+		bool pushJoinFilter(const HashJoin* join, const StreamList& keyStreams) override;
+
 	protected:
 		void internalGetPlan(thread_db* tdbb, PlanEntry& planEntry, unsigned level, bool recurse) const override;
 		void internalOpen(thread_db* tdbb) const override;
@@ -1220,7 +1485,10 @@ namespace Jrd
 	public:
 		HashJoin(thread_db* tdbb, CompilerScratch* csb, FB_SIZE_T count,
 				 RecordSource* const* args, NestValueArray* const* keys,
-				 double selectivity = 0);
+				 double selectivity = 0, bool ordered = false);
+		HashJoin(thread_db* tdbb, CompilerScratch* csb, JoinType joinType,
+				 RecordSource* outer, RecordSource* inner, NestValueArray* const* keys,
+				 BoolExprNode* boolean, BoolExprNode* residual, bool ordered = false);
 
 		void close(thread_db* tdbb) const override;
 
@@ -1235,6 +1503,10 @@ namespace Jrd
 		void findUsedStreams(StreamList& streams, bool expandAll = false) const override;
 		void nullRecords(thread_db* tdbb) const override;
 
+		bool pushJoinFilter(const HashJoin* join, const StreamList& keyStreams) override;
+
+		bool checkFilter(thread_db* tdbb) const;
+
 		static unsigned maxCapacity();
 
 	protected:
@@ -1243,12 +1515,23 @@ namespace Jrd
 		bool internalGetRecord(thread_db* tdbb) const override;
 
 	private:
+		void init(thread_db* tdbb, CompilerScratch* csb, FB_SIZE_T count,
+				  RecordSource* const* args, NestValueArray* const* keys,
+				  double selectivity, bool ordered);
+		void buildHashTable(thread_db* tdbb, Impure* impure) const;
+		bool fetchLeader(thread_db* tdbb, Impure* impure) const;
 		ULONG computeHash(thread_db* tdbb, Request* request,
 						  const SubStream& sub, UCHAR* buffer) const;
 		bool fetchRecord(thread_db* tdbb, Impure* impure, FB_SIZE_T stream) const;
+		bool getOuterRecord(thread_db* tdbb, Impure* impure) const;
 
+		const JoinType m_joinType;
 		SubStream m_leader;
+		NestConst<BufferedStream> m_leaderBuffer;
+		bool m_filtered;
 		Firebird::Array<SubStream> m_args;
+		NestConst<BoolExprNode> const m_boolean;
+		NestConst<BoolExprNode> const m_residual;
 	};
 
 	class MergeJoin : public RecordSource
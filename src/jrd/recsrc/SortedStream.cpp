@@ -46,7 +46,9 @@ using namespace Jrd;
 SortedStream::SortedStream(CompilerScratch* csb, RecordSource* next, SortMap* map)
 	: RecordSource(csb),
 	  m_next(next),
-	  m_map(map)
+	  m_map(map),
+	  m_first(nullptr),
+	  m_skip(nullptr)
 {
 	fb_assert(m_next && m_map);
 
@@ -186,6 +188,32 @@ Sort* SortedStream::init(thread_db* tdbb) const
 
 	m_next->open(tdbb);
 
+	// If only the first rows are going to be fetched from the sort,
+	// ask it to keep just that many records, so that the sort is performed
+	// in memory and the remaining records are discarded as early as possible.
+
+	FB_UINT64 maxRecords = 0;
+
+	if (m_first)
+	{
+		const dsc* desc = EVL_expr(tdbb, request, m_first);
+		const SINT64 first = (desc && !(request->req_flags & req_null)) ?
+			MOV_get_int64(tdbb, desc, 0) : 0;
+
+		SINT64 skip = 0;
+
+		if (m_skip)
+		{
+			desc = EVL_expr(tdbb, request, m_skip);
+			skip = (desc && !(request->req_flags & req_null)) ? MOV_get_int64(tdbb, desc, 0) : 0;
+		}
+
+		// Invalid values are reported by FirstRowsStream / SkipRowsStream
+
+		if (first > 0 && skip >= 0 && first <= MAX_SINT64 - skip)
+			maxRecords = first + skip;
+	}
+
 	// Initialize for sort. If this is really a project operation,
 	// establish a callback routine to reject duplicate records.
 
@@ -193,7 +221,7 @@ Sort* SortedStream::init(thread_db* tdbb) const
 		Sort(tdbb->getDatabase(), &request->req_sorts,
 			 m_map->length, m_map->keyItems.getCount(), m_map->keyItems.getCount(),
 			 m_map->keyItems.begin(),
-			 ((m_map->flags & FLAG_PROJECT) ? rejectDuplicate : nullptr), 0));
+			 ((m_map->flags & FLAG_PROJECT) ? rejectDuplicate : nullptr), 0, maxRecords));
 
 	// Pump the input stream dry while pushing records into sort. For
 	// each record, map all fields into the sort record. The reverse
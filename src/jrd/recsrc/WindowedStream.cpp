@@ -465,7 +465,8 @@ WindowedStream::WindowStream::WindowStream(thread_db* tdbb, CompilerScratch* csb
 	  m_winPassSources(csb->csb_pool),
 	  m_winPassTargets(csb->csb_pool),
 	  m_exclusion(exclusion),
-	  m_invariantOffsets(0)
+	  m_invariantOffsets(0),
+	  m_invertible(true)
 {
 	// Separate nodes that requires the winPass call.
 
@@ -486,6 +487,9 @@ WindowedStream::WindowStream::WindowStream(thread_db* tdbb, CompilerScratch* csb
 			{
 				m_aggSources.add(*source);
 				m_aggTargets.add(*target);
+
+				if (!(capabilities & AggNode::CAP_SUPPORTS_AGG_UNPASS))
+					m_invertible = false;
 			}
 
 			if (capabilities & AggNode::CAP_WANTS_WIN_PASS_CALL)
@@ -801,10 +805,41 @@ bool WindowedStream::WindowStream::internalGetRecord(thread_db* tdbb) const
 			//
 			// This may be incompatible with some function like LIST, but currently LIST cannot
 			// be used in ordered windows anyway.
+			//
+			// If the window slides forward, the rows left behind are removed from the
+			// aggregation, unless some aggregate cannot do that or it's cheaper to start over.
 
-			if (!lastWindow.isValid() ||
-				impure->windowBlock.startPosition > lastWindow.startPosition ||
-				impure->windowBlock.endPosition < lastWindow.endPosition)
+			bool reuse = lastWindow.isValid() &&
+				impure->windowBlock.endPosition >= lastWindow.endPosition;
+
+			if (reuse && impure->windowBlock.startPosition > lastWindow.startPosition)
+			{
+				const SINT64 removed = impure->windowBlock.startPosition - lastWindow.startPosition;
+				const SINT64 added = impure->windowBlock.endPosition - lastWindow.endPosition;
+
+				reuse = m_invertible &&
+					removed + added <= impure->windowBlock.endPosition - impure->windowBlock.startPosition;
+
+				if (reuse)
+				{
+					m_next->locate(tdbb, lastWindow.startPosition);
+					SINT64 pending = removed;
+
+					while (pending-- > 0)
+					{
+						if (!m_next->getRecord(tdbb))
+							fb_assert(false);
+
+						if (!aggUnpass(tdbb, request))
+						{
+							reuse = false;
+							break;
+						}
+					}
+				}
+			}
+
+			if (!reuse)
 			{
 				aggInit(tdbb, request, m_windowMap);
 				m_next->locate(tdbb, impure->windowBlock.startPosition);
@@ -973,6 +1008,18 @@ void WindowedStream::WindowStream::getFrameValue(thread_db* tdbb, Request* reque
 	}
 }
 
+// Remove the current row from all the aggregates of the window.
+bool WindowedStream::WindowStream::aggUnpass(thread_db* tdbb, Request* request) const
+{
+	for (const auto& source : m_aggSources)
+	{
+		if (!nodeAs<AggNode>(source)->aggUnpass(tdbb, request))
+			return false;
+	}
+
+	return true;
+}
+
 SINT64 WindowedStream::WindowStream::locateFrameRange(thread_db* tdbb, Request* request, Impure* impure,
 	const Frame* frame, const dsc* offsetDesc, SINT64 position) const
 {
@@ -33,12 +33,16 @@
 #include <string.h>
 #include "../jrd/jrd.h"
 #include "../jrd/sort.h"
+#include "../jrd/Attachment.h"
 #include "iberror.h"
 #include "../jrd/intl.h"
 #include "../common/TimeZoneUtil.h"
 #include "../common/gdsassert.h"
+#include "../common/Task.h"
+#include "../common/StatusHolder.h"
 #include "../jrd/req.h"
 #include "../jrd/val.h"
+#include "../jrd/sqz.h"
 #include "../jrd/err_proto.h"
 #include "../yvalve/gds_proto.h"
 
@@ -79,6 +83,18 @@ using namespace Firebird;
 const ULONG MAX_SORT_BUFFER_SIZE = 1024 * 128;	// 128KB
 const ULONG MIN_RECORDS_TO_ALLOC = 8;
 
+// Smaller buffers are sorted faster than the worker threads are started
+const ULONG MIN_PARALLEL_SORT_RECORDS = 32768;
+const unsigned MAX_PARALLEL_SORT_PARTS = 32;
+
+// Short keys (numbers, dates and timestamps with their null flags) are
+// radix sorted, longer ones are left for the comparison based quicksort
+const ULONG MAX_RADIX_KEY_LONGS = 4;
+const ULONG MIN_RADIX_SORT_RECORDS = 256;
+
+// Runs written to the work file are compressed by frames of about this size
+const ULONG RUN_FRAME_SIZE = 1024 * 64;	// 64KB
+
 // the size of sr_bckptr (everything before sort_record) in bytes
 #define SIZEOF_SR_BCKPTR offsetof(sr, sr_sort_record)
 // the size of sr_bckptr in # of 32 bit longwords
@@ -150,6 +166,303 @@ namespace
 } // namespace
 
 
+namespace Jrd {
+
+// Sort the buffer of record pointers using the parallel workers. The buffer
+// is split into the chunks which are sorted independently. Then the sorted
+// chunks are merged back into the buffer, every worker producing its own
+// key range of the result.
+
+class ParallelSortTask : public Task
+{
+public:
+	ParallelSortTask(MemoryPool& pool, SORTP** pointers, ULONG count, ULONG longs, ULONG keyLongs,
+			unsigned parts) : Task(),
+		m_pointers(pointers),
+		m_longs(longs),
+		m_keyLongs(keyLongs),
+		m_parts(parts),
+		m_items(pool),
+		m_chunks(pool),
+		m_buffer(pool),
+		m_scratch(pool),
+		m_bounds(pool),
+		m_offsets(pool),
+		m_merge(false),
+		m_stop(false),
+		m_next(0)
+	{
+		fb_assert(parts > 1 && parts <= MAX_PARALLEL_SORT_PARTS);
+
+		// Every chunk is surrounded with the low and high key guards
+		m_buffer.grow(count + 2 * parts);
+		m_bounds.grow(parts * (parts + 1));
+		m_offsets.grow(parts + 1);
+
+		if (Sort::useRadix(count / parts, keyLongs))
+			m_scratch.grow(count);
+
+		ULONG start = 0;
+
+		for (unsigned i = 0; i < parts; i++)
+		{
+			Chunk& chunk = m_chunks.add();
+			chunk.start = start;
+			chunk.count = (count - start) / (parts - i);
+			start += chunk.count;
+
+			m_items.add(FB_NEW_POOL(pool) Item(this, i));
+		}
+	}
+
+	virtual ~ParallelSortTask()
+	{
+		for (Item** p = m_items.begin(); p < m_items.end(); p++)
+			delete *p;
+	}
+
+	bool handler(WorkItem& _item);
+	bool getWorkItem(WorkItem** pItem);
+
+	bool getResult(IStatus* status)
+	{
+		if (status)
+		{
+			status->init();
+			status->setErrors(m_status.getErrors());
+		}
+
+		return m_status.isSuccess();
+	}
+
+	int getMaxWorkers()
+	{
+		return m_parts;
+	}
+
+	void startMerge();
+
+	class Item : public Task::WorkItem
+	{
+	public:
+		Item(ParallelSortTask* task, unsigned index) : Task::WorkItem(task),
+			m_index(index)
+		{}
+
+		const unsigned m_index;
+	};
+
+private:
+	struct Chunk
+	{
+		ULONG start;	// position of the first pointer in the buffer
+		ULONG count;	// number of pointers
+	};
+
+	SORTP** getChunk(unsigned i)
+	{
+		return m_buffer.begin() + m_chunks[i].start + 2 * i + 1;
+	}
+
+	ULONG& getBound(unsigned chunk, unsigned range)
+	{
+		return m_bounds[chunk * (m_parts + 1) + range];
+	}
+
+	// Same comparison as used by Sort::quick
+	bool lessThan(const SORTP* p, const SORTP* q) const
+	{
+		ULONG tl = m_longs - 1;
+		while (tl && *p == *q)
+		{
+			p++;
+			q++;
+			tl--;
+		}
+
+		return tl && *p < *q;
+	}
+
+	ULONG lowerBound(unsigned chunk, const SORTP* key);
+	void sortChunk(unsigned chunk);
+	void mergeRange(unsigned range);
+	void setError(IStatus* status);
+
+	SORTP** const m_pointers;
+	const ULONG m_longs;
+	const ULONG m_keyLongs;
+	const unsigned m_parts;
+
+	Mutex m_mutex;
+	HalfStaticArray<Item*, 8> m_items;
+	HalfStaticArray<Chunk, 8> m_chunks;
+	Array<SORTP*> m_buffer;
+	Array<SORTP*> m_scratch;	// radix sort output, if used
+	Array<ULONG> m_bounds;		// range bounds inside every chunk
+	Array<ULONG> m_offsets;		// range positions inside the result
+	StatusHolder m_status;		// first error raised by a worker
+	bool m_merge;
+	volatile bool m_stop;
+	unsigned m_next;
+};
+
+bool ParallelSortTask::handler(WorkItem& _item)
+{
+	const Item* const item = reinterpret_cast<Item*>(&_item);
+
+	try
+	{
+		if (m_merge)
+			mergeRange(item->m_index);
+		else
+			sortChunk(item->m_index);
+	}
+	catch (const Exception& ex)
+	{
+		FbLocalStatus status;
+		ex.stuffException(&status);
+		setError(&status);
+		return false;
+	}
+
+	return true;
+}
+
+bool ParallelSortTask::getWorkItem(WorkItem** pItem)
+{
+	MutexLockGuard guard(m_mutex, FB_FUNCTION);
+
+	if (m_stop || m_next >= m_parts)
+		return false;
+
+	*pItem = m_items[m_next++];
+	return true;
+}
+
+// Prepare the merge phase once all the chunks are sorted
+void ParallelSortTask::startMerge()
+{
+	// Pick the range splitters from the largest chunk. Every range
+	// contains the keys not less than its own splitter and less than
+	// the splitter of the next range.
+
+	unsigned largest = 0;
+
+	for (unsigned i = 1; i < m_parts; i++)
+	{
+		if (m_chunks[i].count > m_chunks[largest].count)
+			largest = i;
+	}
+
+	SORTP** const splitters = getChunk(largest);
+	const ULONG splitCount = m_chunks[largest].count;
+
+	for (unsigned i = 0; i < m_parts; i++)
+	{
+		getBound(i, 0) = 0;
+
+		for (unsigned range = 1; range < m_parts; range++)
+		{
+			const ULONG split = (ULONG) ((FB_UINT64) splitCount * range / m_parts);
+			getBound(i, range) = lowerBound(i, splitters[split]);
+		}
+
+		getBound(i, m_parts) = m_chunks[i].count;
+	}
+
+	for (unsigned range = 0; range <= m_parts; range++)
+	{
+		m_offsets[range] = 0;
+
+		for (unsigned i = 0; i < m_parts; i++)
+			m_offsets[range] += getBound(i, range);
+	}
+
+	m_merge = true;
+	m_next = 0;
+}
+
+// Find the first pointer of the sorted chunk not less than the given key
+ULONG ParallelSortTask::lowerBound(unsigned chunk, const SORTP* key)
+{
+	SORTP** const pointers = getChunk(chunk);
+	ULONG lower = 0, upper = m_chunks[chunk].count;
+
+	while (lower < upper)
+	{
+		const ULONG middle = (lower + upper) / 2;
+
+		if (lessThan(pointers[middle], key))
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+
+	return lower;
+}
+
+void ParallelSortTask::sortChunk(unsigned chunk)
+{
+	SORTP** const pointers = getChunk(chunk);
+	const ULONG count = m_chunks[chunk].count;
+
+	pointers[-1] = reinterpret_cast<SORTP*>(low_key);
+	memcpy(pointers, m_pointers + m_chunks[chunk].start, count * sizeof(SORTP*));
+	pointers[count] = reinterpret_cast<SORTP*>(high_key);
+
+	SORTP** const scratch = m_scratch.hasData() ? m_scratch.begin() + m_chunks[chunk].start : NULL;
+	Sort::sortPointers(pointers, count, m_longs, m_keyLongs, scratch);
+}
+
+void ParallelSortTask::setError(IStatus* status)
+{
+	MutexLockGuard guard(m_mutex, FB_FUNCTION);
+
+	if (m_status.isSuccess())
+		m_status.save(status);
+
+	m_stop = true;
+}
+
+void ParallelSortTask::mergeRange(unsigned range)
+{
+	SORTP** chunks[MAX_PARALLEL_SORT_PARTS];
+	SORTP** ends[MAX_PARALLEL_SORT_PARTS];
+
+	for (unsigned i = 0; i < m_parts; i++)
+	{
+		SORTP** const pointers = getChunk(i);
+		chunks[i] = pointers + getBound(i, range);
+		ends[i] = pointers + getBound(i, range + 1);
+	}
+
+	SORTP** output = m_pointers + m_offsets[range];
+
+	while (true)
+	{
+		unsigned best = m_parts;
+
+		for (unsigned i = 0; i < m_parts; i++)
+		{
+			if (chunks[i] < ends[i] && (best == m_parts || lessThan(*chunks[i], *chunks[best])))
+				best = i;
+		}
+
+		if (best == m_parts)
+			break;
+
+		// Records must point back to their final place in the buffer
+		*output = *chunks[best]++;
+		((SORTP***) (*output))[BACK_OFFSET] = output;
+		output++;
+	}
+
+	fb_assert(output == m_pointers + m_offsets[range + 1]);
+}
+
+} // namespace Jrd
+
+
 Sort::Sort(Database* dbb,
 		   SortOwner* owner,
 		   ULONG record_length,
@@ -163,7 +476,8 @@ Sort::Sort(Database* dbb,
 	  m_last_record(NULL), m_next_pointer(NULL), m_records(0),
 	  m_runs(NULL), m_merge(NULL), m_free_runs(NULL),
 	  m_flags(0), m_merge_pool(NULL),
-	  m_description(m_owner->getPool(), keys)
+	  m_description(m_owner->getPool(), keys),
+	  m_packed(m_owner->getPool())
 {
 /**************************************
  *
@@ -197,6 +511,15 @@ Sort::Sort(Database* dbb,
 		m_min_alloc_size = record_size * MIN_RECORDS_TO_ALLOC;
 		m_max_alloc_size = MAX(m_min_alloc_size, MAX_SORT_BUFFER_SIZE);
 
+		// Frames of the compressed runs hold whole records, the back pointers
+		// are not stored in the work file
+
+		const ULONG run_record_size = record_size - SIZEOF_SR_BCKPTR;
+		m_frame_length = MAX(RUN_FRAME_SIZE / run_record_size, 1) * run_record_size;
+
+		if (m_dbb && m_dbb->dbb_config->getSortRunCompression())
+			m_flags |= scb_pack_runs;
+
 		m_dup_callback = call_back;
 		m_dup_callback_arg = user_arg;
 		m_max_records = max_records;
@@ -279,6 +602,7 @@ Sort::~Sort()
 		m_runs = run->run_next;
 		if (run->run_buff_alloc)
 			delete[] run->run_buffer;
+		delete[] run->run_frame;
 		delete run;
 	}
 
@@ -289,6 +613,7 @@ Sort::~Sort()
 		m_free_runs = run->run_next;
 		if (run->run_buff_alloc)
 			delete[] run->run_buffer;
+		delete[] run->run_frame;
 		delete run;
 	}
 
@@ -359,24 +684,29 @@ void Sort::put(thread_db* tdbb, ULONG** record_address)
 		// Check that we are not at the beginning of the buffer in addition
 		// to checking for space for the record. This avoids the pointer
 		// record from underflowing in the second condition.
+		// If only a limited number of records is requested, just discard the
+		// unnecessary ones instead.
 		if ((UCHAR*) record < m_memory + m_longs ||
 			(UCHAR*) NEXT_RECORD(record) <= (UCHAR*) (m_next_pointer + 1))
 		{
-			putRun(tdbb);
-			while (true)
+			if (!truncateBuffer(tdbb))
 			{
-				run_control* run = m_runs;
-				const USHORT depth = run->run_depth;
-				if (depth == MAX_MERGE_LEVEL)
-					break;
-				USHORT count = 1;
-				while ((run = run->run_next) && run->run_depth == depth)
-					count++;
-				if (count < RUN_GROUP)
-					break;
-				mergeRuns(count);
+				putRun(tdbb);
+				while (true)
+				{
+					run_control* run = m_runs;
+					const USHORT depth = run->run_depth;
+					if (depth == MAX_MERGE_LEVEL)
+						break;
+					USHORT count = 1;
+					while ((run = run->run_next) && run->run_depth == depth)
+						count++;
+					if (count < RUN_GROUP)
+						break;
+					mergeRuns(count);
+				}
+				init();
 			}
-			init();
 			record = m_last_record;
 		}
 
@@ -431,6 +761,23 @@ void Sort::sort(thread_db* tdbb)
 		if (!m_runs)
 		{
 			sortBuffer(tdbb);
+
+			// Return no more records than requested
+
+			if (m_max_records)
+			{
+				sort_record** ptr = m_first_pointer + 1;
+				FB_UINT64 count = 0;
+
+				while (ptr < m_next_pointer && count < m_max_records)
+				{
+					if (*ptr++)
+						count++;
+				}
+
+				m_records = ptr - (m_first_pointer + 1);
+			}
+
 			m_next_pointer = m_first_pointer + 1;
 			m_flags |= scb_sorted;
 			return;
@@ -1220,7 +1567,19 @@ sort_record* Sort::getMerge(merge_control* merge)
 			}
 
 			// There are records remaining, but the buffer is full.
-			// Read a buffer full.
+			// Read a buffer full, or the next frame of the compressed run.
+
+			if (run->run_packed)
+			{
+				readFrame(run);
+
+				record = run->run_record;
+				run->run_record =
+					reinterpret_cast<sort_record*>(NEXT_RUN_RECORD(record));
+				--run->run_records;
+
+				continue;
+			}
 
 			l = (ULONG) (run->run_end_buffer - run->run_buffer);
 			n = run->run_records * m_longs * sizeof(ULONG);
@@ -1461,6 +1820,21 @@ ULONG Sort::allocate(ULONG n, ULONG chunkSize, bool useFreeSpace)
 	{
 		run->run_buffer = NULL;
 
+		// Compressed run is read frame by frame into its own buffer
+
+		if (run->run_packed)
+		{
+			if (!run->run_frame)
+				run->run_frame = FB_NEW_POOL(m_owner->getPool()) UCHAR[m_frame_length];
+
+			run->run_buffer = run->run_frame;
+			run->run_record = reinterpret_cast<sort_record*>(run->run_frame);
+			run->run_end_buffer = run->run_frame;
+			run->run_buff_cache = false;
+			allocated++;
+			continue;
+		}
+
 		UCHAR* const mem = m_space->inMemory(run->run_seek, run->run_size);
 
 		if (mem)
@@ -1588,7 +1962,7 @@ void Sort::mergeRuns(USHORT n)
 				run->run_record = reinterpret_cast<sort_record*>(run->run_end_buffer);
 			}
 		}
-		temp_run.run_size += run->run_size;
+		temp_run.run_size += (FB_UINT64) run->run_records * rec_size;
 	}
 	temp_run.run_record = reinterpret_cast<sort_record*>(buffer);
 	temp_run.run_buffer = reinterpret_cast<UCHAR*>(temp_run.run_record);
@@ -1635,10 +2009,23 @@ void Sort::mergeRuns(USHORT n)
 	// Merge records into run
 	CHECK_FILE(NULL);
 
+	// Compress the new run unless it's going to stay in memory
+
+	const FB_UINT64 run_length = temp_run.run_size;
+
+	if (m_flags & scb_pack_runs)
+	{
+		const ULONG buffer_length = (ULONG) (temp_run.run_end_buffer - temp_run.run_buffer);
+		temp_run.run_size = packedSpace(run_length, buffer_length);
+	}
+
 	sort_record* q = reinterpret_cast<sort_record*>(temp_run.run_buffer);
 	FB_UINT64 seek = temp_run.run_seek = m_space->allocateSpace(temp_run.run_size);
 	temp_run.run_records = 0;
 
+	temp_run.run_packed = (m_flags & scb_pack_runs) &&
+		!m_space->inMemory(temp_run.run_seek, run_length);
+
 	CHECK_FILE(&temp_run);
 
 	const sort_record* p;
@@ -1647,7 +2034,9 @@ void Sort::mergeRuns(USHORT n)
 		if (q >= (sort_record*) temp_run.run_end_buffer)
 		{
 			size = (UCHAR*) q - temp_run.run_buffer;
-			seek = writeBlock(m_space, seek, temp_run.run_buffer, size);
+			seek = temp_run.run_packed ?
+				writeFrames(seek, temp_run.run_buffer, size) :
+				writeBlock(m_space, seek, temp_run.run_buffer, size);
 			q = reinterpret_cast<sort_record*>(temp_run.run_buffer);
 		}
 		ULONG longs_count = m_longs;
@@ -1660,10 +2049,14 @@ void Sort::mergeRuns(USHORT n)
 	// Write the tail of the new run and return any unused space
 
 	if ( (size = (UCHAR*) q - temp_run.run_buffer) )
-		seek = writeBlock(m_space, seek, temp_run.run_buffer, size);
+	{
+		seek = temp_run.run_packed ?
+			writeFrames(seek, temp_run.run_buffer, size) :
+			writeBlock(m_space, seek, temp_run.run_buffer, size);
+	}
 
 	// If the records did not fill the allocated run (such as when duplicates are
-	// rejected), then free the remainder and diminish the size of the run accordingly
+	// rejected or the run is compressed), then free the remainder and diminish the size of the run accordingly
 
 	if (seek - temp_run.run_seek < temp_run.run_size)
 	{
@@ -1698,6 +2091,10 @@ void Sort::mergeRuns(USHORT n)
 		}
 		run->run_buffer = NULL;
 
+		delete[] run->run_frame;
+		run->run_frame = NULL;
+		run->run_packed = false;
+
 		// Add run descriptor to list of unused run descriptor blocks
 
 		run->run_next = m_free_runs;
@@ -1857,6 +2254,89 @@ void Sort::quick(SLONG size, SORTP** pointers, ULONG length)
 }
 
 
+void Sort::radix(SORTP** pointers, ULONG count, ULONG keyLongs, SORTP** scratch)
+{
+/**************************************
+ *
+ * Sort an array of record pointers by their keys using the LSD radix
+ * sort, a byte of the key longword per pass, starting from the least
+ * significant byte of the last key longword. Unlike quick(), records
+ * with equal keys are not ordered by their non-key data.
+ *
+ **************************************/
+	SORTP** from = pointers;
+	SORTP** to = scratch;
+
+	for (ULONG word = keyLongs; word-- > 0;)
+	{
+		for (unsigned shift = 0; shift < 32; shift += 8)
+		{
+			ULONG counts[256];
+			memset(counts, 0, sizeof(counts));
+
+			for (ULONG i = 0; i < count; i++)
+				counts[(from[i][word] >> shift) & 0xFF]++;
+
+			// Skip the pass if all records have the same digit,
+			// e.g. null flags or high bytes of small numbers
+
+			if (counts[(from[0][word] >> shift) & 0xFF] == count)
+				continue;
+
+			ULONG position = 0;
+			for (unsigned digit = 0; digit < 256; digit++)
+			{
+				const ULONG n = counts[digit];
+				counts[digit] = position;
+				position += n;
+			}
+
+			for (ULONG i = 0; i < count; i++)
+				to[counts[(from[i][word] >> shift) & 0xFF]++] = from[i];
+
+			SORTP** const temp = from;
+			from = to;
+			to = temp;
+		}
+	}
+
+	if (from != pointers)
+		memcpy(pointers, from, count * sizeof(SORTP*));
+
+	// Records must point back to their new place
+	for (ULONG i = 0; i < count; i++)
+		((SORTP***) (pointers[i]))[BACK_OFFSET] = pointers + i;
+}
+
+
+bool Sort::useRadix(ULONG count, ULONG keyLongs)
+{
+	return (count >= MIN_RADIX_SORT_RECORDS && keyLongs <= MAX_RADIX_KEY_LONGS);
+}
+
+
+void Sort::sortPointers(SORTP** pointers, ULONG count, ULONG longs, ULONG keyLongs, SORTP** scratch)
+{
+/**************************************
+ *
+ * Sort an array of record pointers, using the radix sort if the
+ * scratch space is provided for it, otherwise the quicksort.
+ * The latter expects the guard records around the array.
+ *
+ **************************************/
+	if (scratch)
+	{
+		fb_assert(useRadix(count, keyLongs));
+		radix(pointers, count, keyLongs, scratch);
+	}
+	else
+	{
+		quick(count, pointers, longs);
+		orderPairs(pointers, count, longs);
+	}
+}
+
+
 ULONG Sort::order()
 {
 /**************************************
@@ -1973,8 +2453,13 @@ void Sort::orderAndSave(thread_db* tdbb)
 	}
 
 	const ULONG key_length = (m_longs - SIZEOF_SR_BCKPTR_IN_LONGS) * sizeof(ULONG);
-	run->run_size = run->run_records * key_length;
-	run->run_seek = m_space->allocateSpace(run->run_size);
+	run->run_size = (FB_UINT64) run->run_records * key_length;
+
+	// Reserve the space for the frame headers in case the run is compressed
+
+	const FB_UINT64 space = (m_flags & scb_pack_runs) ?
+		packedSpace(run->run_size, (ULONG) run->run_size) : run->run_size;
+	run->run_seek = m_space->allocateSpace(space);
 
 	UCHAR* mem = m_space->inMemory(run->run_seek, run->run_size);
 
@@ -1996,11 +2481,115 @@ void Sort::orderAndSave(thread_db* tdbb)
 			mem += key_length;
 		}
 	}
+	else if (m_flags & scb_pack_runs)
+	{
+		order();
+		const FB_UINT64 seek = writeFrames(run->run_seek, (UCHAR*) m_last_record, run->run_size);
+		run->run_size = seek - run->run_seek;
+		run->run_packed = true;
+	}
 	else
 	{
 		order();
 		writeBlock(m_space, run->run_seek, (UCHAR*) m_last_record, run->run_size);
 	}
+
+	// Return the space not used by the run
+
+	if (space > run->run_size)
+		m_space->releaseSpace(run->run_seek + run->run_size, space - run->run_size);
+}
+
+
+FB_UINT64 Sort::packedSpace(FB_UINT64 length, ULONG chunk) const
+{
+/**************************************
+ *
+ * Return the work file space required in the worst case to store
+ * the run of the given length, written in chunks of the given size,
+ * as the compressed frames.
+ *
+ **************************************/
+	const ULONG frame = MIN(m_frame_length, MAX(chunk, 1));
+	const FB_UINT64 frames = length / frame + length / MAX(chunk, 1) + 2;
+
+	return length + frames * sizeof(run_frame_header);
+}
+
+
+FB_UINT64 Sort::writeFrames(FB_UINT64 seek, const UCHAR* data, FB_UINT64 length)
+{
+/**************************************
+ *
+ * Write a part of the run into the work file as the compressed
+ * frames. The part must consist of the whole records. Frames that
+ * cannot be compressed are stored as is.
+ *
+ **************************************/
+	MemoryPool& pool = m_owner->getPool();
+
+	while (length)
+	{
+		run_frame_header header;
+		header.rfh_length = (ULONG) MIN(length, m_frame_length);
+
+		const Compressor dcc(pool, true, true, header.rfh_length, data);
+		const ULONG packed = dcc.getPackedLength();
+
+		if (dcc.isPacked() && packed < header.rfh_length)
+		{
+			header.rfh_packed = packed;
+
+			UCHAR* const buffer = m_packed.getBuffer(sizeof(header) + packed);
+			memcpy(buffer, &header, sizeof(header));
+			dcc.pack(data, buffer + sizeof(header));
+			seek = writeBlock(m_space, seek, buffer, sizeof(header) + packed);
+		}
+		else
+		{
+			header.rfh_packed = header.rfh_length;
+
+			seek = writeBlock(m_space, seek, (UCHAR*) &header, sizeof(header));
+			seek = writeBlock(m_space, seek, const_cast<UCHAR*>(data), header.rfh_length);
+		}
+
+		data += header.rfh_length;
+		length -= header.rfh_length;
+	}
+
+	return seek;
+}
+
+
+void Sort::readFrame(run_control* run)
+{
+/**************************************
+ *
+ * Read the next frame of the compressed run into the frame buffer.
+ *
+ **************************************/
+	run_frame_header header;
+	run->run_seek = readBlock(m_space, run->run_seek, (UCHAR*) &header, sizeof(header));
+
+	if (header.rfh_length > m_frame_length || header.rfh_packed > header.rfh_length)
+		BUGCHECK(179);	// msg 179 decompression overran buffer
+
+	if (header.rfh_packed == header.rfh_length)
+		run->run_seek = readBlock(m_space, run->run_seek, run->run_frame, header.rfh_length);
+	else
+	{
+		UCHAR* const buffer = m_packed.getBuffer(header.rfh_packed);
+		run->run_seek = readBlock(m_space, run->run_seek, buffer, header.rfh_packed);
+
+		if (Compressor::unpack(header.rfh_packed, buffer, header.rfh_length, run->run_frame) !=
+			run->run_frame + header.rfh_length)
+		{
+			BUGCHECK(179);	// msg 179 decompression overran buffer
+		}
+	}
+
+	run->run_record = reinterpret_cast<sort_record*>(run->run_frame);
+	run->run_end_buffer = run->run_frame + header.rfh_length;
 }
 
 
@@ -2051,6 +2640,11 @@ void Sort::sortBuffer(thread_db* tdbb)
  * been requested, detect and handle them.
  *
  **************************************/
+	// Worker attachments are already a part of some parallel task
+	const Attachment* const attachment = tdbb->getAttachment();
+	const int workers = (attachment && !attachment->isWorker()) ?
+		attachment->att_parallel_workers : 1;
+
 	EngineCheckout cout(tdbb, FB_FUNCTION);
 
 	// First, insert a pointer to the high key
@@ -2063,29 +2657,12 @@ void Sort::sortBuffer(thread_db* tdbb)
 	SORTP** j = (SORTP**) (m_first_pointer) + 1;
 	const ULONG n = (SORTP**) (m_next_pointer) - j;	// calculate # of records
 
-	quick(n, j, m_longs);
-
-	// Scream through and correct any out of order pairs
-	// hvlad: don't compare user keys against high_key
-	while (j < (SORTP**) m_next_pointer - 1)
+	if (!sortParallel(workers, j, n))
 	{
-		SORTP** i = j;
-		j++;
-		if (**i >= **j)
-		{
-			const SORTP* p = *i;
-			const SORTP* q = *j;
-			ULONG tl = m_longs - 1;
-			while (tl && *p == *q)
-			{
-				p++;
-				q++;
-				tl--;
-			}
-			if (tl && *p > *q) {
-				swap(i, j);
-			}
-		}
+		Array<SORTP*> scratch(m_owner->getPool());
+
+		sortPointers(j, n, m_longs, m_key_length,
+			useRadix(n, m_key_length) ? scratch.getBuffer(n) : NULL);
 	}
 
 	// If duplicate handling hasn't been requested, we're done
@@ -2134,6 +2711,144 @@ void Sort::sortBuffer(thread_db* tdbb)
 }
 
 
+void Sort::orderPairs(SORTP** pointers, ULONG count, ULONG length)
+{
+/**************************************
+ *
+ * Quicksort, by design, doesn't order partitions of length 2,
+ * so scream through and correct any out of order pairs.
+ *
+ **************************************/
+	SORTP** j = pointers;
+
+	// hvlad: don't compare user keys against high_key
+	while (j < pointers + count - 1)
+	{
+		SORTP** i = j;
+		j++;
+		if (**i >= **j)
+		{
+			const SORTP* p = *i;
+			const SORTP* q = *j;
+			ULONG tl = length - 1;
+			while (tl && *p == *q)
+			{
+				p++;
+				q++;
+				tl--;
+			}
+			if (tl && *p > *q) {
+				swap(i, j);
+			}
+		}
+	}
+}
+
+
+bool Sort::sortParallel(int workers, SORTP** pointers, ULONG count)
+{
+/**************************************
+ *
+ * Sort a large buffer of record pointers using the parallel
+ * workers. Return false if the buffer is too small to bother,
+ * so the caller sorts it on its own.
+ *
+ **************************************/
+	ULONG parts = MIN((ULONG) MAX(workers, 1), count / MIN_PARALLEL_SORT_RECORDS);
+	parts = MIN(parts, MAX_PARALLEL_SORT_PARTS);
+
+	if (parts < 2)
+		return false;
+
+	ParallelSortTask task(m_owner->getPool(), pointers, count, m_longs, m_key_length, parts);
+	Coordinator coord(m_dbb->dbb_permanent);
+
+	FbLocalStatus local_status;
+
+	coord.runSync(&task);
+
+	if (!task.getResult(&local_status))
+		local_status.raise();
+
+	task.startMerge();
+	coord.runSync(&task);
+
+	if (!task.getResult(&local_status))
+		local_status.raise();
+
+	return true;
+}
+
+
+bool Sort::truncateBuffer(thread_db* tdbb)
+{
+/**************************************
+ *
+ * Memory has been exhausted, but only the first m_max_records
+ * records are going to be returned. Sort what we have, keep the
+ * leading records and discard the others, thus freeing the memory
+ * for the incoming records instead of writing a run to the scratch
+ * file. This way the top-N sort is performed in memory, with the
+ * amortized cost being linear to the number of input records.
+ * Return false if that is not possible or makes no sense.
+ *
+ **************************************/
+	if (!m_max_records || m_runs)
+		return false;
+
+	// Do not bother if the requested records occupy more than a half of the buffer
+
+	const FB_UINT64 count = m_next_pointer - (m_first_pointer + 1);
+
+	if (m_max_records > count / 2)
+		return false;
+
+	sortBuffer(tdbb);
+
+	// Copy the leading records aside, then re-initialize the buffer and put them back.
+	// Their keys are already diddled, so they remain in this form.
+
+	const ULONG length = m_longs - SIZEOF_SR_BCKPTR_IN_LONGS;
+
+	Array<ULONG> buffer(m_owner->getPool());
+	ULONG* const keys = buffer.getBuffer(m_max_records * length);
+
+	ULONG* ptr = keys;
+	FB_UINT64 kept = 0;
+
+	for (sort_record** next = m_first_pointer + 1;
+		next < m_next_pointer && kept < m_max_records; next++)
+	{
+		if (*next)
+		{
+			memcpy(ptr, *next, length * sizeof(ULONG));
+			ptr += length;
+			kept++;
+		}
+	}
+
+	init();
+
+	ptr = keys;
+
+	for (FB_UINT64 i = 0; i < kept; i++)
+	{
+		SR* const record = NEXT_RECORD(m_last_record);
+
+		m_last_record = record;
+		record->sr_bckptr = m_next_pointer;
+		*m_next_pointer++ = reinterpret_cast<sort_record*>(record->sr_sort_record.sort_record_key);
+
+		memcpy(record->sr_sort_record.sort_record_key, ptr, length * sizeof(ULONG));
+		ptr += length;
+	}
+
+	m_records = kept;
+
+	return true;
+}
+
+
 void Sort::sortRunsBySeek(int n)
 {
 /**************************************
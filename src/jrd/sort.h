@@ -242,6 +242,17 @@ struct run_control
 	bool			run_buff_cache;		// run buffer is already in cache
 	FB_UINT64		run_mem_seek;		// position of run's buffer in in-memory part of sort file
 	ULONG			run_mem_size;		// size of run's buffer in in-memory part of sort file
+	bool			run_packed;			// run is stored as the compressed frames
+	UCHAR*			run_frame;			// ALLOC: buffer for the unpacked frame
+};
+
+// Header of the compressed run frame. Frame is stored uncompressed
+// if its packed length is equal to the unpacked one.
+
+struct run_frame_header
+{
+	ULONG			rfh_packed;			// Length of frame data in work file
+	ULONG			rfh_length;			// Length of unpacked frame data
 };
 
 // Merge control block
@@ -272,10 +283,12 @@ typedef bool (*FPTR_REJECT_DUP_CALLBACK)(const UCHAR*, const UCHAR*, void*);
 
 const int scb_sorted		= 1;	// stream has been sorted
 const int scb_reuse_buffer	= 2;	// reuse buffer if possible
+const int scb_pack_runs		= 4;	// compress runs stored in the work file
 
 class Sort
 {
 	friend class PartitionedSort;
+	friend class ParallelSortTask;
 public:
 	Sort(Database*, SortOwner*,
 		 ULONG, FB_SIZE_T, FB_SIZE_T, const sort_key_def*,
@@ -319,13 +332,22 @@ private:
 	void orderAndSave(Jrd::thread_db*);
 	void putRun(Jrd::thread_db*);
 	void sortBuffer(Jrd::thread_db*);
+	bool sortParallel(int, SORTP**, ULONG);
+	bool truncateBuffer(Jrd::thread_db*);
 	void sortRunsBySeek(int);
+	FB_UINT64 packedSpace(FB_UINT64, ULONG) const;
+	FB_UINT64 writeFrames(FB_UINT64, const UCHAR*, FB_UINT64);
+	void readFrame(run_control*);
 
 #ifdef DEV_BUILD
 	void checkFile(const run_control*);
 #endif
 
 	static void quick(SLONG, SORTP**, ULONG);
+	static void orderPairs(SORTP**, ULONG, ULONG);
+	static void radix(SORTP**, ULONG, ULONG, SORTP**);
+	static void sortPointers(SORTP**, ULONG, ULONG, ULONG, SORTP**);
+	static bool useRadix(ULONG, ULONG);
 
 	Database* m_dbb;							// Database
 	SortOwner* m_owner;							// Sort owner
@@ -339,7 +361,7 @@ private:
 	ULONG m_key_length;							// Key length
 	ULONG m_unique_length;						// Unique key length, used when duplicates eliminated
 	FB_UINT64 m_records;						// Number of records
-	FB_UINT64 m_max_records;					// Maximum number of records to store, assigned but unused.
+	FB_UINT64 m_max_records;					// Maximum number of records to return, zero if unlimited
 	TempSpace* m_space;							// temporary space for scratch file
 	run_control* m_runs;						// ALLOC: Run on scratch file, if any
 	merge_control* m_merge;						// Top level merge block
@@ -352,7 +374,10 @@ private:
 	ULONG m_min_alloc_size;						// MIN and MAX values
 	ULONG m_max_alloc_size;						// for the run buffer size
 
+	ULONG m_frame_length;						// Unpacked length of the run frame
+
 	Firebird::Array<sort_key_def> m_description;
+	Firebird::Array<UCHAR> m_packed;			// Buffer for the packed run frame
 };
 
 
@@ -0,0 +1,170 @@
+#include "firebird.h"
+#include "boost/test/unit_test.hpp"
+#include "iberror.h"
+#include "../common/StatusArg.h"
+#include "../jrd/evl_string.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace Firebird;
+
+BOOST_AUTO_TEST_SUITE(EngineSuite)
+BOOST_AUTO_TEST_SUITE(EvlStringSuite)
+
+
+namespace
+{
+	const unsigned ROUNDS = 20000;
+
+	template <typename CharType>
+	using Text = std::vector<CharType>;
+
+	template <typename CharType>
+	Text<CharType> randomText(std::mt19937& random, const char* alphabet, unsigned maxLength)
+	{
+		const unsigned alphabetLength = (unsigned) strlen(alphabet);
+		Text<CharType> text(random() % (maxLength + 1));
+
+		for (auto& c : text)
+			c = (CharType) (UCHAR) alphabet[random() % alphabetLength];
+
+		return text;
+	}
+
+	// Feed the text in chunks of random length, stopping as soon as the evaluator
+	// reports that more data cannot change its result
+	template <typename Evaluator, typename CharType>
+	bool evaluate(Evaluator& evaluator, const Text<CharType>& text, std::mt19937& random)
+	{
+		evaluator.reset();
+
+		for (size_t pos = 0; pos < text.size(); )
+		{
+			const size_t chunk = 1 + random() % 5;
+			const size_t length = MIN(chunk, text.size() - pos);
+
+			if (!evaluator.processNextChunk(text.data() + pos, (SLONG) length))
+				break;
+
+			pos += length;
+		}
+
+		return evaluator.getResult();
+	}
+
+	template <typename CharType>
+	bool referenceStarts(const Text<CharType>& pattern, const Text<CharType>& text)
+	{
+		return pattern.size() <= text.size() &&
+			std::equal(pattern.begin(), pattern.end(), text.begin());
+	}
+
+	template <typename CharType>
+	bool referenceContains(const Text<CharType>& pattern, const Text<CharType>& text)
+	{
+		return pattern.empty() ||
+			std::search(text.begin(), text.end(), pattern.begin(), pattern.end()) != text.end();
+	}
+
+	template <typename CharType>
+	bool referenceLike(const Text<CharType>& pattern, const Text<CharType>& text)
+	{
+		// matched[j] - pattern prefix processed so far matches the first j characters of text
+		std::vector<bool> matched(text.size() + 1, false);
+		matched[0] = true;
+
+		for (const auto p : pattern)
+		{
+			std::vector<bool> next(text.size() + 1, false);
+
+			for (size_t j = 0; j <= text.size(); j++)
+			{
+				if (p == '%')
+					next[j] = matched[j] || (j > 0 && next[j - 1]);
+				else if (j > 0 && matched[j - 1])
+					next[j] = (p == '_' || p == text[j - 1]);
+			}
+
+			matched.swap(next);
+		}
+
+		return matched[text.size()];
+	}
+
+	template <typename CharType>
+	void testStarts()
+	{
+		auto& pool = *getDefaultMemoryPool();
+		std::mt19937 random(1);
+
+		for (unsigned round = 0; round < ROUNDS; round++)
+		{
+			const auto pattern = randomText<CharType>(random, "ab", 4);
+			const auto text = randomText<CharType>(random, "ab", 12);
+
+			StartsEvaluator<CharType> evaluator(pool, pattern.data(), (SLONG) pattern.size());
+			BOOST_TEST(evaluate(evaluator, text, random) == referenceStarts(pattern, text));
+		}
+	}
+
+	template <typename CharType>
+	void testContains()
+	{
+		auto& pool = *getDefaultMemoryPool();
+		std::mt19937 random(2);
+
+		for (unsigned round = 0; round < ROUNDS; round++)
+		{
+			const auto pattern = randomText<CharType>(random, "abc", 5);
+			const auto text = randomText<CharType>(random, "abc", 24);
+
+			ContainsEvaluator<CharType> evaluator(pool, pattern.data(), (SLONG) pattern.size());
+			BOOST_TEST(evaluate(evaluator, text, random) == referenceContains(pattern, text));
+		}
+	}
+
+	template <typename CharType>
+	void testLike()
+	{
+		auto& pool = *getDefaultMemoryPool();
+		std::mt19937 random(3);
+
+		for (unsigned round = 0; round < ROUNDS; round++)
+		{
+			const auto pattern = randomText<CharType>(random, "abc%_", 8);
+			const auto text = randomText<CharType>(random, "abc", 24);
+
+			LikeEvaluator<CharType> evaluator(pool, pattern.data(), (SLONG) pattern.size(),
+				0, false, '%', '_');
+			BOOST_TEST(evaluate(evaluator, text, random) == referenceLike(pattern, text));
+		}
+	}
+}
+
+
+BOOST_AUTO_TEST_SUITE(EvlStringTests)
+
+BOOST_AUTO_TEST_CASE(StartsTest)
+{
+	testStarts<UCHAR>();
+	testStarts<ULONG>();
+}
+
+BOOST_AUTO_TEST_CASE(ContainsTest)
+{
+	testContains<UCHAR>();
+	testContains<ULONG>();
+}
+
+BOOST_AUTO_TEST_CASE(LikeTest)
+{
+	testLike<UCHAR>();
+	testLike<ULONG>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()	// EvlStringTests
+
+
+BOOST_AUTO_TEST_SUITE_END()	// EvlStringSuite
+BOOST_AUTO_TEST_SUITE_END()	// EngineSuite
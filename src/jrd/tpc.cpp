@@ -89,7 +89,7 @@ bool TipCache::SnapshotsInitializer::initialize(SharedMemoryBase* sm, bool initF
 	initHeader(header);
 
 	header->slots_used.store(0, std::memory_order_relaxed);
-	header->min_free_slot = 0;
+	header->min_free_slot.store(0, std::memory_order_relaxed);
 	const ULONG dataSize = sm->sh_mem_length_mapped - offsetof(SnapshotList, slots[0]);
 	header->slots_allocated.store(dataSize / sizeof(SnapshotData), std::memory_order_relaxed);
 
@@ -118,6 +118,11 @@ TipCache::TipCache(Database* dbb)
 	  globalTpcInitializer(this), snapshotsInitializer(this), memBlockInitializer(this),
 	  m_blocks_memory(*dbb->dbb_permanent)
 {
+	for (ULONG i = 0; i < BLOCK_SLOTS; i++)
+	{
+		m_block_slots[i].number.store(NO_BLOCK, std::memory_order_relaxed);
+		m_block_slots[i].block.store(NULL, std::memory_order_relaxed);
+	}
 }
 
 TipCache::~TipCache()
@@ -153,6 +158,7 @@ void TipCache::finalizeTpc(thread_db* tdbb)
 		do
 		{
 			StatusBlockData* cur = m_blocks_memory.current();
+			unpublishTransactionStatusBlock(cur->blockNumber);
 			delete cur;
 		} while (m_blocks_memory.getNext());
 	}
@@ -223,7 +229,7 @@ CommitNumber TipCache::cacheState(TraNumber number)
 	// Barrier is not needed here when we are reading state from cache
 	// because all callers of this function are prepared to handle
 	// slightly out-dated information and will take slow path if necessary
-	CommitNumber state = block->data[offset];
+	CommitNumber state = block->data[offset].load(std::memory_order_relaxed);
 
 	return state;
 }
@@ -495,13 +501,40 @@ TipCache::TransactionStatusBlock* TipCache::createTransactionStatusBlock(ULONG b
 
 	m_blocks_memory.add(blockData);
 
-	return blockData->memory->getHeader();
+	TransactionStatusBlock* const block = blockData->memory->getHeader();
+	publishTransactionStatusBlock(blockNumber, block);
+
+	return block;
+}
+
+void TipCache::publishTransactionStatusBlock(TpcBlockNumber blockNumber, TransactionStatusBlock* block)
+{
+	fb_assert(m_sync_status.ourExclusiveLock());
+
+	BlockSlot& slot = m_block_slots[blockNumber % BLOCK_SLOTS];
+
+	slot.number.store(NO_BLOCK, std::memory_order_release);
+	slot.block.store(block, std::memory_order_release);
+	slot.number.store(blockNumber, std::memory_order_release);
+}
+
+void TipCache::unpublishTransactionStatusBlock(TpcBlockNumber blockNumber)
+{
+	// Called under exclusive m_sync_status or from the blocking AST. In the
+	// latter case do not touch the slot if it was already reused for another block.
+	BlockSlot& slot = m_block_slots[blockNumber % BLOCK_SLOTS];
+
+	slot.number.compare_exchange_strong(blockNumber, NO_BLOCK, std::memory_order_acq_rel);
 }
 
 TipCache::TransactionStatusBlock* TipCache::getTransactionStatusBlock(GlobalTpcHeader* header, TpcBlockNumber blockNumber)
 {
+	// Fast path: block is already mapped and present in the lock-free index
+	TransactionStatusBlock* block = findTransactionStatusBlock(blockNumber);
+	if (block)
+		return block;
+
 	// This is a double-checked locking pattern. SyncLockGuard uses atomic ops internally and should be cheap
-	TransactionStatusBlock* block = NULL;
 	{
 		SyncLockGuard sync(&m_sync_status, SYNC_SHARED, "TipCache::getTransactionStatusBlock");
 		BlocksMemoryMap::ConstAccessor acc(&m_blocks_memory);
@@ -514,7 +547,11 @@ TipCache::TransactionStatusBlock* TipCache::getTransactionStatusBlock(GlobalTpcH
 		SyncLockGuard sync(&m_sync_status, SYNC_EXCLUSIVE, "TipCache::getTransactionStatusBlock");
 		BlocksMemoryMap::ConstAccessor acc(&m_blocks_memory);
 		if (acc.locate(blockNumber))
+		{
+			// Block was mapped before but its slot was reused for another one
 			block = acc.current()->memory->getHeader();
+			publishTransactionStatusBlock(blockNumber, block);
+		}
 		else
 		{
 			// Check if block might be too old to be created.
@@ -749,6 +786,7 @@ int TipCache::tpc_block_blocking_ast(void* arg)
 		// Release shared memory
 		if (data->memory)
 		{
+			cache->unpublishTransactionStatusBlock(data->blockNumber);
 			delete data->memory;
 			data->memory = NULL;
 		}
@@ -808,6 +846,7 @@ void TipCache::releaseSharedMemory(thread_db* tdbb, TraNumber oldest_old, TraNum
 		{
 			StatusBlockData* block = m_blocks_memory.current();
 			m_blocks_memory.fastRemove();
+			unpublishTransactionStatusBlock(blockNumber);
 			delete block;
 		}
 
@@ -829,81 +868,118 @@ void TipCache::releaseSharedMemory(thread_db* tdbb, TraNumber oldest_old, TraNum
 	}
 }
 
-SnapshotHandle TipCache::allocateSnapshotSlot()
+ULONG TipCache::getMappedSnapshots() const
 {
-	// Try finding available slot
-	SnapshotList* snapshots = m_snapshots->getHeader();
+	return static_cast<ULONG>(
+		(m_snapshots->sh_mem_length_mapped - offsetof(SnapshotList, slots[0])) / sizeof(SnapshotData));
+}
 
-	// Scan previously used slots first
-	SnapshotHandle slotNumber;
+void TipCache::lockSnapshots(Sync& sync)
+{
+	sync.lock(SYNC_SHARED);
 
-	ULONG slots_used = snapshots->slots_used.load(std::memory_order_relaxed);
-	for (slotNumber = snapshots->min_free_slot; slotNumber < slots_used; slotNumber++)
+	while (m_snapshots->getHeader()->slots_allocated.load(std::memory_order_acquire) != getMappedSnapshots())
 	{
-		if (!snapshots->slots[slotNumber].attachment_id.load(std::memory_order_relaxed))
-			return slotNumber;
-	}
+		sync.unlock();
 
-	// See if we have some space left in the snapshots block
-	if (slotNumber < snapshots->slots_allocated.load(std::memory_order_relaxed))
-	{
-		snapshots->slots_used.store(slotNumber + 1, std::memory_order_release);
-		return slotNumber;
+		{	// scope
+			SyncLockGuard exGuard(&m_sync_snapshots, SYNC_EXCLUSIVE, "TipCache::lockSnapshots");
+			SharedMutexGuard guard(m_snapshots);
+
+			const ULONG slotsAllocated =
+				m_snapshots->getHeader()->slots_allocated.load(std::memory_order_relaxed);
+
+			if (slotsAllocated != getMappedSnapshots())
+			{
+				LocalStatus ls;
+				CheckStatusWrapper localStatus(&ls);
+				if (!m_snapshots->remapFile(&localStatus,
+					static_cast<ULONG>(slotsAllocated * sizeof(SnapshotData) + offsetof(SnapshotList, slots[0])),
+					false))
+				{
+					status_exception::raise(&localStatus);
+				}
+			}
+		}
+
+		sync.lock(SYNC_SHARED);
 	}
+}
+
+void TipCache::growSnapshots(Sync& sync, ULONG allocatedSlots)
+{
+	sync.unlock();
+
+	{	// scope
+		SyncLockGuard exGuard(&m_sync_snapshots, SYNC_EXCLUSIVE, "TipCache::growSnapshots");
+		SharedMutexGuard guard(m_snapshots);
 
+		// Someone else could grow the list already, lockSnapshots() below will remap it
+		if (m_snapshots->getHeader()->slots_allocated.load(std::memory_order_relaxed) == allocatedSlots)
+		{
 #ifdef HAVE_OBJECT_MAP
-	LocalStatus ls;
-	CheckStatusWrapper localStatus(&ls);
-	if (!m_snapshots->remapFile(&localStatus, m_snapshots->sh_mem_length_mapped * 2, true))
-	{
-		status_exception::raise(&localStatus);
-	}
+			LocalStatus ls;
+			CheckStatusWrapper localStatus(&ls);
+			if (!m_snapshots->remapFile(&localStatus, m_snapshots->sh_mem_length_mapped * 2, true))
+			{
+				status_exception::raise(&localStatus);
+			}
 
-	snapshots = m_snapshots->getHeader();
-	snapshots->slots_allocated.store(
-		static_cast<ULONG>((m_snapshots->sh_mem_length_mapped - offsetof(SnapshotList, slots[0])) / sizeof(SnapshotData)),
-		std::memory_order_release);
+			m_snapshots->getHeader()->slots_allocated.store(getMappedSnapshots(), std::memory_order_release);
 #else
-	// NS: I do not intend to assign a code to this condition, because I think that we do not
-	// support platforms without HAVE_OBJECT_MAP capability, and the code below needs to be cleaned out
-	// sooner or later. And even if need to support such a platform suddenly appears we shall make it
-	// fail in remapFile code and not here.
-	(Arg::Gds(isc_random) <<
-		"Snapshots shared memory block is full on a platform that does not support shared memory remapping").raise();
+			// NS: I do not intend to assign a code to this condition, because I think that we do not
+			// support platforms without HAVE_OBJECT_MAP capability, and the code below needs to be cleaned out
+			// sooner or later. And even if need to support such a platform suddenly appears we shall make it
+			// fail in remapFile code and not here.
+			(Arg::Gds(isc_random) <<
+				"Snapshots shared memory block is full on a platform that does not support shared memory remapping").raise();
 #endif
+		}
+	}
 
-	fb_assert(slotNumber < snapshots->slots_allocated.load(std::memory_order_relaxed));
-	snapshots->slots_used.store(slotNumber + 1, std::memory_order_release);
-	return slotNumber;
+	lockSnapshots(sync);
 }
 
-void TipCache::remapSnapshots(bool sync)
+SnapshotHandle TipCache::allocateSnapshotSlot(Sync& sync, AttNumber attachmentId)
 {
-	// Can only be called on initialized TipCache
-	fb_assert(m_tpcHeader);
+	// Called with m_sync_snapshots locked shared.
+	// Note, that this function might remap memory and thus invalidate pointers.
 
-	SnapshotList* snapshots = m_snapshots->getHeader();
-
-	if (snapshots->slots_allocated.load(std::memory_order_acquire) !=
-		(m_snapshots->sh_mem_length_mapped - offsetof(SnapshotList, slots[0])) / sizeof(SnapshotData))
+	while (true)
 	{
-		SharedMutexGuard guard(m_snapshots, false);
-		if (sync)
-			guard.lock();
-
-		LocalStatus ls;
-		CheckStatusWrapper localStatus(&ls);
-		if (!m_snapshots->remapFile(&localStatus,
-			static_cast<ULONG>(
-				snapshots->slots_allocated.load(std::memory_order_relaxed) * sizeof(SnapshotData) +
-					offsetof(SnapshotList, slots[0])), false))
+		// Another process could grow the list already, but we can't look past our mapping
+		SnapshotList* const snapshots = m_snapshots->getHeader();
+		const ULONG slotsAllocated = getMappedSnapshots();
+
+		// Start from the first slot likely to be free and wrap around
+		ULONG slotNumber = snapshots->min_free_slot.load(std::memory_order_relaxed);
+
+		for (ULONG n = 0; n < slotsAllocated; n++, slotNumber++)
 		{
-			status_exception::raise(&localStatus);
+			if (slotNumber >= slotsAllocated)
+				slotNumber = 0;
+
+			SnapshotData* const slot = snapshots->slots + slotNumber;
+			AttNumber expected = 0;
+
+			if (slot->attachment_id.load(std::memory_order_relaxed) == 0 &&
+				slot->attachment_id.compare_exchange_strong(expected, attachmentId))
+			{
+				// Make the slot visible to the scanners of the list
+				ULONG slotsUsed = snapshots->slots_used.load(std::memory_order_relaxed);
+				while (slotsUsed <= slotNumber &&
+					!snapshots->slots_used.compare_exchange_weak(slotsUsed, slotNumber + 1))
+				{}
+
+				snapshots->min_free_slot.store(slotNumber + 1, std::memory_order_relaxed);
+				return slotNumber;
+			}
 		}
+
+		growSnapshots(sync, slotsAllocated);
 	}
 }
 
-
 SnapshotHandle TipCache::beginSnapshot(thread_db* tdbb, AttNumber attachmentId, CommitNumber& commitNumber)
 {
 	// Can only be called on initialized TipCache
@@ -912,23 +988,39 @@ SnapshotHandle TipCache::beginSnapshot(thread_db* tdbb, AttNumber attachmentId,
 
 	fb_assert(attachmentId);
 
-	// Lock mutex
-	SharedMutexGuard guard(m_snapshots);
+	Sync sync(&m_sync_snapshots, "TipCache::beginSnapshot");
+	lockSnapshots(sync);
 
-	// Remap snapshot list if it has been grown by someone else
-	remapSnapshots(false);
+	const SnapshotHandle slotNumber = allocateSnapshotSlot(sync, attachmentId);
 
-	SnapshotList* snapshots = m_snapshots->getHeader();
+	// Store snapshot commit number. The slot is already claimed, thus anyone
+	// who reads the latest commit number after us will see the slot as used.
+	SnapshotList* const snapshots = m_snapshots->getHeader();
+	SnapshotData* const slot = snapshots->slots + slotNumber;
+
+	const bool useExisting = (commitNumber != 0);
+
+	if (!useExisting)
+		commitNumber = header->latest_commit_number.load(std::memory_order_acquire);
+
+	slot->snapshot.store(commitNumber, std::memory_order_release);
 
-	if (commitNumber != 0)
+	if (useExisting)
 	{
-		ULONG slotsUsed = snapshots->slots_used.load(std::memory_order_relaxed);
+		// Our snapshot is published already, so it's enough to make sure the one
+		// we are sharing is still alive now. If so, garbage collector could not
+		// miss both of them.
+
+		const ULONG slotsUsed = snapshots->slots_used.load(std::memory_order_acquire);
 		bool found = false;
 
-		for (SnapshotHandle slotNumber = 0; slotNumber < slotsUsed; ++slotNumber)
+		for (SnapshotHandle other = 0; other < slotsUsed; ++other)
 		{
-			if (snapshots->slots[slotNumber].attachment_id.load(std::memory_order_relaxed) != 0 &&
-				snapshots->slots[slotNumber].snapshot.load(std::memory_order_relaxed) == commitNumber)
+			const AttNumber otherAttachment =
+				snapshots->slots[other].attachment_id.load(std::memory_order_acquire);
+
+			if (other != slotNumber && otherAttachment != 0 && otherAttachment != RELEASING_ATTACHMENT &&
+				snapshots->slots[other].snapshot.load(std::memory_order_acquire) == commitNumber)
 			{
 				found = true;
 				break;
@@ -936,55 +1028,82 @@ SnapshotHandle TipCache::beginSnapshot(thread_db* tdbb, AttNumber attachmentId,
 		}
 
 		if (!found)
+		{
+			deallocateSnapshotSlot(slotNumber);
 			ERR_post(Arg::Gds(isc_tra_snapshot_does_not_exist));
+		}
 	}
 
-	SnapshotHandle slotNumber = allocateSnapshotSlot();
+	return slotNumber;
+}
 
-	// Note, that allocateSnapshotSlot might remap memory and thus invalidate pointers
-	snapshots = m_snapshots->getHeader();
+void TipCache::deallocateSnapshotSlot(SnapshotHandle slotNumber)
+{
+	// Note: callers of this function assume that it cannot remap
+	// shared memory (as they keep shared memory pointers).
+	// Slot shall belong either to the caller or to a dead attachment,
+	// in the latter case it shall be marked with RELEASING_ATTACHMENT.
 
-	// Store snapshot commit number and return handle
+	SnapshotList* snapshots = m_snapshots->getHeader();
 	SnapshotData* slot = snapshots->slots + slotNumber;
 
-	if (commitNumber == 0)
-		commitNumber = header->latest_commit_number.load(std::memory_order_acquire);
+	// Snapshot is reset first, so slot with zero attachment_id is always ready for reuse
+	slot->snapshot.store(0, std::memory_order_release);
+	slot->attachment_id.store(0, std::memory_order_release);
 
-	slot->snapshot.store(commitNumber, std::memory_order_release);
+	// Make slot available for allocator. This is only a hint, so races are harmless.
+	if (snapshots->min_free_slot.load(std::memory_order_relaxed) > slotNumber)
+		snapshots->min_free_slot.store(slotNumber, std::memory_order_relaxed);
+}
 
-	// Only assign attachment_id after we completed all other work
-	slot->attachment_id.store(attachmentId, std::memory_order_release);
+void TipCache::releaseDeadSnapshotSlot(SnapshotHandle slotNumber, AttNumber attachmentId)
+{
+	// Slot could be released by someone else since it was found dead and even
+	// claimed by a live attachment then. Attachment numbers are never reused,
+	// so the slot is ours to release only if it still has the dead one.
 
-	// And now move allocator watermark position after we used slot for sure
-	snapshots->min_free_slot = slotNumber + 1;
+	SnapshotData* const slot = m_snapshots->getHeader()->slots + slotNumber;
+	AttNumber expected = attachmentId;
 
-	return slotNumber;
+	if (slot->attachment_id.compare_exchange_strong(expected, RELEASING_ATTACHMENT))
+		deallocateSnapshotSlot(slotNumber);
 }
 
-void TipCache::deallocateSnapshotSlot(SnapshotHandle slotNumber)
+bool TipCache::isAttachmentDead(thread_db* tdbb, AttNumber attachmentId)
 {
-	// Note: callers of this function assume that it cannot remap
-	// shared memory (as they keep shared memory pointers).
+	ThreadStatusGuard temp_status(tdbb);
+	Lock temp_lock(tdbb, sizeof(AttNumber), LCK_attachment);
+	temp_lock.setKey(attachmentId);
 
-	SnapshotList* snapshots = m_snapshots->getHeader();
+	const bool dead = LCK_lock(tdbb, &temp_lock, LCK_EX, LCK_NO_WAIT);
+	if (dead)
+		LCK_release(tdbb, &temp_lock);
 
-	// At first, make slot available for allocator (this is always safe)
-	if (snapshots->min_free_slot > slotNumber)
-		snapshots->min_free_slot = slotNumber;
+	return dead;
+}
 
-	SnapshotData* slot = snapshots->slots + slotNumber;
+CommitNumber TipCache::waitSnapshot(thread_db* tdbb, SnapshotHandle slotNumber, AttNumber attachmentId)
+{
+	// Slot is claimed but its snapshot is not stored yet. Owner does it right
+	// after the claim, and no other number could stand for it safely, so wait.
+	// Returns zero if the slot was released meanwhile or its owner is dead.
 
-	slot->snapshot.store(0, std::memory_order_release);
-	slot->attachment_id.store(0, std::memory_order_release);
+	SnapshotData* const slot = m_snapshots->getHeader()->slots + slotNumber;
 
-	// After we completed deallocation, update used slots count, if necessary
-	if (slotNumber == snapshots->slots_used.load(std::memory_order_relaxed) - 1)
+	for (unsigned n = 1; ; n++)
 	{
-		do {
-			slot--;
-		} while (slot >= snapshots->slots && slot->attachment_id.load(std::memory_order_relaxed) == 0);
+		const CommitNumber snapshot = slot->snapshot.load(std::memory_order_acquire);
+		if (snapshot)
+			return snapshot;
 
-		snapshots->slots_used.store(static_cast<ULONG>(slot - snapshots->slots + 1), std::memory_order_release);
+		if (slot->attachment_id.load(std::memory_order_acquire) != attachmentId)
+			return 0;
+
+		// Owner could die before storing the snapshot
+		if (n % SNAPSHOT_WAIT_CHECK == 0 && isAttachmentDead(tdbb, attachmentId))
+			return 0;
+
+		Thread::yield();
 	}
 }
 
@@ -994,12 +1113,10 @@ void TipCache::endSnapshot(thread_db* tdbb, SnapshotHandle handle, AttNumber att
 	fb_assert(m_tpcHeader);
 	GlobalTpcHeader* header = m_tpcHeader->getHeader();
 
-	// Lock mutex
-	SharedMutexGuard guard(m_snapshots);
-
 	// We don't care to perform remap here, because we release a slot that was
 	// allocated by this process and we do not access any data past it during
 	// deallocation.
+	SyncLockGuard sync(&m_sync_snapshots, SYNC_SHARED, "TipCache::endSnapshot");
 
 	// Perform some sanity checks on a handle
 	SnapshotList* snapshots = m_snapshots->getHeader();
@@ -1028,6 +1145,14 @@ void TipCache::updateActiveSnapshots(thread_db* tdbb, ActiveSnapshots* activeSna
 
 	// This function is quite tricky as it reads snapshots list without locks (using atomics)
 
+	// Slots claimed after the list was mapped are skipped. Make sure the
+	// list is scanned again the next time in this case.
+	bool incomplete = false;
+
+	// Remap snapshot list if it has been grown by someone else
+	Sync sync(&m_sync_snapshots, "TipCache::updateActiveSnapshots");
+	lockSnapshots(sync);
+
 	SnapshotList* snapshots = m_snapshots->getHeader();
 
 	if (activeSnapshots->m_lastCommit == CN_ACTIVE)
@@ -1040,56 +1165,30 @@ void TipCache::updateActiveSnapshots(thread_db* tdbb, ActiveSnapshots* activeSna
 		// If new slots are allocated past this value - we don't care as we preserved
 		// lastCommit and new snapshots will have numbers >= lastCommit and we don't
 		// GC them anyways
-		ULONG slots_used_org = snapshots->slots_used.load(std::memory_order_acquire);
-
-		// Remap snapshot list if it has been grown by someone else
-		remapSnapshots(true);
-
-		snapshots = m_snapshots->getHeader();
+		const ULONG slots_used_org =
+			MIN(snapshots->slots_used.load(std::memory_order_acquire), getMappedSnapshots());
 
 		GenericMap<Pair<NonPooled<AttNumber, bool> > > att_states;
 
-		// We modify snapshots list only while holding a mutex
-		SharedMutexGuard guard(m_snapshots, false);
-
 		activeSnapshots->m_snapshots.clear();
 		for (ULONG slotNumber = 0; slotNumber < slots_used_org; slotNumber++)
 		{
 			SnapshotData* slot = snapshots->slots + slotNumber;
 			AttNumber slot_attachment_id = slot->attachment_id.load(std::memory_order_acquire);
-			if (slot_attachment_id)
+			if (slot_attachment_id && slot_attachment_id != RELEASING_ATTACHMENT)
 			{
-				bool isAttachmentDead;
-				if (!att_states.get(slot_attachment_id, isAttachmentDead))
+				bool isDead;
+				if (!att_states.get(slot_attachment_id, isDead))
 				{
-					ThreadStatusGuard temp_status(tdbb);
-					Lock temp_lock(tdbb, sizeof(AttNumber), LCK_attachment);
-					temp_lock.setKey(slot_attachment_id);
-					if ((isAttachmentDead = LCK_lock(tdbb, &temp_lock, LCK_EX, LCK_NO_WAIT)))
-						LCK_release(tdbb, &temp_lock);
-					att_states.put(slot_attachment_id, isAttachmentDead);
+					isDead = isAttachmentDead(tdbb, slot_attachment_id);
+					att_states.put(slot_attachment_id, isDead);
 				}
 
-				if (isAttachmentDead)
-				{
-					if (!guard.isLocked())
-					{
-						guard.lock();
-
-						// Check if slot was reused while we waited for the mutex
-						AttNumber slot_attachment_id2 = slot->attachment_id.load(std::memory_order_acquire);
-						if (slot_attachment_id != slot_attachment_id2)
-						{
-							slotNumber--;
-							continue;
-						}
-					}
-
-					deallocateSnapshotSlot(slotNumber);
-				}
+				if (isDead)
+					releaseDeadSnapshotSlot(slotNumber, slot_attachment_id);
 				else
 				{
-					CommitNumber slot_snapshot = slot->snapshot.load(std::memory_order_acquire);
+					CommitNumber slot_snapshot = waitSnapshot(tdbb, slotNumber, slot_attachment_id);
 					if (slot_snapshot)
 						activeSnapshots->m_snapshots.set(slot_snapshot);
 				}
@@ -1123,25 +1222,30 @@ void TipCache::updateActiveSnapshots(thread_db* tdbb, ActiveSnapshots* activeSna
 		activeSnapshots->m_slots_used = slots_used_org;
 		activeSnapshots->m_releaseCount = release_count;
 
-		// Remap snapshot list if it has been grown by someone else
-		remapSnapshots(true);
-
-		snapshots = m_snapshots->getHeader();
+		// Slots past the mapped part of the list are claimed after we locked it,
+		// look at them the next time
+		if (slots_used_org > getMappedSnapshots())
+		{
+			slots_used_org = getMappedSnapshots();
+			incomplete = true;
+		}
 
 		activeSnapshots->m_snapshots.clear();
-		for (SnapshotData* slot = snapshots->slots,
-				*end = snapshots->slots + slots_used_org;
-			 slot < end;
-			 slot++)
+		for (ULONG slotNumber = 0; slotNumber < slots_used_org; slotNumber++)
 		{
-			if (slot->attachment_id.load(std::memory_order_acquire))
+			SnapshotData* slot = snapshots->slots + slotNumber;
+			const AttNumber slot_attachment_id = slot->attachment_id.load(std::memory_order_acquire);
+			if (slot_attachment_id && slot_attachment_id != RELEASING_ATTACHMENT)
 			{
-				CommitNumber slot_snapshot = slot->snapshot.load(std::memory_order_acquire);
+				CommitNumber slot_snapshot = waitSnapshot(tdbb, slotNumber, slot_attachment_id);
 				if (slot_snapshot)
 					activeSnapshots->m_snapshots.set(slot_snapshot);
 			}
 		}
 	}
+
+	if (incomplete)
+		activeSnapshots->m_slots_used = MAX_ULONG;
 }
 
 TraNumber TipCache::generateTransactionId()
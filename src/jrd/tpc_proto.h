@@ -197,12 +197,19 @@ private:
 	// Note: when maintaining this structure, we are extra careful
 	// to keep it consistent at all times, so that the process using it
 	// can be killed at any time without adverse consequences.
+	//
+	// Slots are claimed and released without the mutex: slot is claimed by
+	// setting its attachment_id from zero and released by resetting snapshot
+	// and then attachment_id to zero. Slot of the dead attachment is switched
+	// to RELEASING_ATTACHMENT first, so only one process resets it and a live
+	// attachment claiming it meanwhile is not affected. The mutex is taken
+	// only to grow the list.
 	class SnapshotList : public Firebird::MemoryHeader
 	{
 	public:
 		std::atomic<ULONG> slots_allocated;
-		std::atomic<ULONG> slots_used;
-		ULONG min_free_slot; // Position where to start looking for free space
+		std::atomic<ULONG> slots_used; // High-water mark of used slots, never decreases
+		std::atomic<ULONG> min_free_slot; // Position where to start looking for free space
 		SnapshotData slots[1];
 	};
 
@@ -281,8 +288,26 @@ private:
 
 	typedef Firebird::BePlusTree<StatusBlockData*, TpcBlockNumber, Firebird::MemoryPool, StatusBlockData> BlocksMemoryMap;
 
-	static const ULONG TPC_VERSION = 2;
+	// Slot of the lock-free index of mapped blocks. Slot is changed under
+	// exclusive m_sync_status only: number is reset first, then block is set,
+	// then number is set. Reader checks that number did not change while
+	// block was read. Mapping of the block is never changed during its life
+	// and the block is unmapped only when it's older than oldest transaction
+	// by SAFETY_GAP_BLOCKS, thus pointer read from the slot is safe to use.
+	struct BlockSlot
+	{
+		std::atomic<TpcBlockNumber> number;
+		std::atomic<TransactionStatusBlock*> block;
+	};
+
+	static const ULONG TPC_VERSION = 3;
 	static const int SAFETY_GAP_BLOCKS = 1;
+	static const ULONG BLOCK_SLOTS = 64;
+	static const TpcBlockNumber NO_BLOCK = MAX_UINT64;
+	// Marks the slot of the dead attachment while it's being released
+	static const AttNumber RELEASING_ATTACHMENT = MAX_UINT64;
+	// How many times to yield waiting for the snapshot before checking its owner
+	static const unsigned SNAPSHOT_WAIT_CHECK = 1024;
 
 	Firebird::SharedMemory<GlobalTpcHeader>* m_tpcHeader; // final
 	Firebird::SharedMemory<SnapshotList>* m_snapshots; // final
@@ -300,6 +325,14 @@ private:
 
 	Firebird::SyncObject m_sync_status;
 
+	// Protects mapping of m_snapshots within the process. Taken shared to work
+	// with the snapshot list and exclusive to remap it.
+	Firebird::SyncObject m_sync_snapshots;
+
+	// Direct-mapped index of the blocks in m_blocks_memory, looked up
+	// without locks before falling back to the tree
+	BlockSlot m_block_slots[BLOCK_SLOTS];
+
 	// Attach to shared memory objects and populate process-local structures.
 	// If shared memory area did not exist - populate initial TIP by reading cache
 	// from disk.
@@ -313,6 +346,27 @@ private:
 	// Returns NULL if requested block is too old and is no longer cached.
 	TransactionStatusBlock* getTransactionStatusBlock(GlobalTpcHeader* header, TpcBlockNumber blockNumber);
 
+	// Lock-free lookup of already mapped block.
+	// Returns NULL if block is not found in the index.
+	TransactionStatusBlock* findTransactionStatusBlock(TpcBlockNumber blockNumber)
+	{
+		BlockSlot& slot = m_block_slots[blockNumber % BLOCK_SLOTS];
+
+		if (slot.number.load(std::memory_order_acquire) != blockNumber)
+			return NULL;
+
+		TransactionStatusBlock* const block = slot.block.load(std::memory_order_acquire);
+
+		if (slot.number.load(std::memory_order_acquire) != blockNumber)
+			return NULL;
+
+		return block;
+	}
+
+	// Put mapped block into the lock-free index and remove it from there
+	void publishTransactionStatusBlock(TpcBlockNumber blockNumber, TransactionStatusBlock* block);
+	void unpublishTransactionStatusBlock(TpcBlockNumber blockNumber);
+
 	// Map shared memory for a block
 	TransactionStatusBlock* createTransactionStatusBlock(ULONG blockSize, TpcBlockNumber blockNumber);
 
@@ -328,9 +382,22 @@ private:
 
 	static int tpc_block_blocking_ast(void* arg);
 
-	SnapshotHandle allocateSnapshotSlot();
+	SnapshotHandle allocateSnapshotSlot(Firebird::Sync& sync, AttNumber attachmentId);
 	void deallocateSnapshotSlot(SnapshotHandle slotNumber);
-	void remapSnapshots(bool sync);
+	void releaseDeadSnapshotSlot(SnapshotHandle slotNumber, AttNumber attachmentId);
+	CommitNumber waitSnapshot(thread_db* tdbb, SnapshotHandle slotNumber, AttNumber attachmentId);
+	static bool isAttachmentDead(thread_db* tdbb, AttNumber attachmentId);
+
+	// Number of slots accessible via the current mapping of the snapshot list
+	ULONG getMappedSnapshots() const;
+
+	// Lock m_sync_snapshots shared, remap the snapshot list before
+	// if it has been grown by someone else
+	void lockSnapshots(Firebird::Sync& sync);
+
+	// Grow the snapshot list if it still has allocatedSlots slots.
+	// Called with m_sync_snapshots locked shared, returns with it locked again.
+	void growSnapshots(Firebird::Sync& sync, ULONG allocatedSlots);
 };
 
 
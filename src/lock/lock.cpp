@@ -1786,37 +1786,95 @@ bool LockManager::create_process(CheckStatusWrapper* statusVector)
 }
 
 
-void LockManager::deadlock_clear()
+void LockManager::deadlock_blockers(const lrq* request, bool* maybe_deadlock,
+									HalfStaticArray<SRQ_PTR, 16>& owners)
 {
 /**************************************
  *
- *	d e a d l o c k _ c l e a r
+ *	d e a d l o c k _ b l o c k e r s
  *
  **************************************
  *
  * Functional description
- *	Clear deadlock and scanned bits for pending requests
- *	in preparation for a deadlock scan.
+ *	Collect the owners of the requests blocking the given
+ *	waiting request.
  *
  **************************************/
 	ASSERT_ACQUIRED;
-	srq* lock_srq;
-	SRQ_LOOP(m_sharedMemory->getHeader()->lhb_owners, lock_srq)
+
+	// Check if this is a conversion request
+
+	const bool conversion = (request->lrq_state > LCK_null);
+
+	// Find the parent lock of the request
+
+	const lbl* const lock = (lbl*) SRQ_ABS_PTR(request->lrq_lock);
+
+	// Loop thru the requests granted against the lock looking for
+	// the ones blocking the request we're handling
+
+	const srq* lock_srq;
+	SRQ_LOOP(lock->lbl_requests, lock_srq)
 	{
-		own* const owner = (own*) ((UCHAR*) lock_srq - offsetof(own, own_lhb_owners));
+		const lrq* const block = (lrq*) ((UCHAR*) lock_srq - offsetof(lrq, lrq_lbl_requests));
+
+		if (conversion)
+		{
+			// Don't pursue our own lock-request again
+
+			if (request == block)
+				continue;
+
+			// Since lock conversions can't follow the fairness rules (to avoid
+			// deadlocks), only granted lock requests need to be examined.
+			// If lock-ordering is turned off (opening the door for starvation),
+			// only granted requests can block our request.
+
+			if (compatibility[request->lrq_requested][block->lrq_state])
+				continue;
+		}
+		else
+		{
+			// Don't pursue our own lock-request again.  In addition, don't look
+			// at requests that arrived after our request because lock-ordering
+			// is in effect.
+
+			if (request == block)
+				break;
+
+			// Since lock ordering is in effect, granted locks and waiting
+			// requests that arrived before our request could block us
+
+			const UCHAR max_state = MAX(block->lrq_state, block->lrq_requested);
+
+			if (compatibility[request->lrq_requested][max_state])
+			{
+				continue;
+			}
+		}
+
+		// Don't pursue lock owners that still have to finish processing their AST.
+		// If the blocking queue is not empty, then the owner still has some
+		// AST's to process (or lock reposts).
+		// hvlad: also lock maybe just granted to owner and blocked owners have no
+		// time to send blocking AST
+		// Remember this fact because they still might be part of a deadlock.
+
+		const own* const owner = (own*) SRQ_ABS_PTR(block->lrq_owner);
 
-		srq* lock_srq2;
-		SRQ_LOOP(owner->own_pending, lock_srq2)
+		if ((owner->own_flags & (OWN_signaled | OWN_wakeup)) || !SRQ_EMPTY((owner->own_blocks)) ||
+			(block->lrq_flags & LRQ_just_granted))
 		{
-			lrq* const request = (lrq*) ((UCHAR*) lock_srq2 - offsetof(lrq, lrq_own_pending));
-			fb_assert(request->lrq_flags & LRQ_pending);
-			request->lrq_flags &= ~(LRQ_deadlock | LRQ_scanned);
+			*maybe_deadlock = true;
+			continue;
 		}
+
+		owners.add(block->lrq_owner);
 	}
 }
 
 
-lrq* LockManager::deadlock_scan(own* owner, lrq* request)
+lrq* LockManager::deadlock_scan(SRQ_PTR owner_offset, SRQ_PTR request_offset)
 {
 /**************************************
  *
@@ -1830,30 +1888,56 @@ lrq* LockManager::deadlock_scan(own* owner, lrq* request)
  *	the address of a pending lock request in the deadlock request.
  *	If no deadlock is found, return null.
  *
+ *	The wait-for graph is copied out of the lock table and searched
+ *	for a cycle with the table released, so other lock operations are
+ *	not stalled by a long walk.  The cycle found is checked against the
+ *	lock table once more after it's acquired again.
+ *
  **************************************/
-	LOCK_TRACE(("deadlock_scan: owner %ld request %ld\n", SRQ_REL_PTR(owner),
-			   SRQ_REL_PTR(request)));
+	LOCK_TRACE(("deadlock_scan: owner %ld request %ld\n", owner_offset, request_offset));
 
 	ASSERT_ACQUIRED;
 	++(m_sharedMemory->getHeader()->lhb_scans);
-	post_history(his_scan, request->lrq_owner, request->lrq_lock, SRQ_REL_PTR(request), true);
-	deadlock_clear();
+
+	lrq* request = (lrq*) SRQ_ABS_PTR(request_offset);
+	post_history(his_scan, request->lrq_owner, request->lrq_lock, request_offset, true);
 
 #ifdef VALIDATE_LOCK_TABLE
 	validate_lhb(m_sharedMemory->getHeader());
 #endif
 
-	bool maybe_deadlock = false;
-	lrq* victim = deadlock_walk(request, &maybe_deadlock);
+	WaitGraph graph(*getDefaultMemoryPool());
+	deadlock_snapshot(request_offset, graph);
+
+	WaitCycle cycle;
+	bool found;
+
+	{ // checkout scope
+		LockTableCheckout checkout(this, FB_FUNCTION);
+		found = graph.findCycle(cycle);
+	}
+
+	// Our request could be resolved while the lock table was released
+
+	request = (lrq*) SRQ_ABS_PTR(request_offset);
+	if (!(request->lrq_flags & LRQ_pending))
+		return NULL;
+
+	lrq* const victim = found ? deadlock_validate(graph, cycle) : NULL;
 
 	// Only when it is certain that this request is not part of a deadlock do we
 	// mark this request as 'scanned' so that we will not check this request again.
 	// Note that this request might be part of multiple deadlocks.
+	// The cycle which is not confirmed by the current lock table will be
+	// looked for again by the next scan.
 
-	if (!victim && !maybe_deadlock)
+	if (!victim && !found && !graph.maybeDeadlock)
+	{
+		own* const owner = (own*) SRQ_ABS_PTR(owner_offset);
 		owner->own_flags |= OWN_scanned;
+	}
 #ifdef DEBUG_LM
-	else if (!victim && maybe_deadlock)
+	else if (!victim)
 		DEBUG_MSG(0, ("deadlock_scan: not marking due to maybe_deadlock\n"));
 #endif
 
@@ -1861,148 +1945,196 @@ lrq* LockManager::deadlock_scan(own* owner, lrq* request)
 }
 
 
-lrq* LockManager::deadlock_walk(lrq* request, bool* maybe_deadlock)
+void LockManager::deadlock_snapshot(SRQ_PTR request_offset, WaitGraph& graph)
 {
 /**************************************
  *
- *	d e a d l o c k _ w a l k
+ *	d e a d l o c k _ s n a p s h o t
  *
  **************************************
  *
  * Functional description
- *	Given a request that is waiting, determine whether a deadlock has
- *	occurred.
+ *	Copy the part of the wait-for graph reachable from the given
+ *	waiting request.  Every waiting request is a node and it's
+ *	connected with the pending requests of the owners blocking it.
  *
  **************************************/
+	ASSERT_ACQUIRED;
 
-	// If this request was scanned for deadlock earlier than don't visit it again
+	HalfStaticArray<SRQ_PTR, 16> owners;
 
-	if (request->lrq_flags & LRQ_scanned)
-		return NULL;
+	graph.addNode(request_offset);
 
-	// If this request has been seen already during this deadlock-walk, then we
-	// detected a circle in the wait-for graph.  Return "deadlock".
+	// Nodes are appended while the graph is traversed breadth first
 
-	if (request->lrq_flags & LRQ_deadlock)
+	for (FB_SIZE_T i = 0; i < graph.nodes.getCount(); i++)
 	{
-#ifdef DEBUG_TRACE_DEADLOCKS
-		const own* owner = (own*) SRQ_ABS_PTR(request->lrq_owner);
-		const prc* proc = (prc*) SRQ_ABS_PTR(owner->own_process);
-		gds__log("deadlock chain: OWNER BLOCK %6" SLONGFORMAT"\tProcess id: %6d\tFlags: 0x%02X ",
-			request->lrq_owner, proc->prc_process_id, owner->own_flags);
-#endif
-		return request;
-	}
+		const lrq* const request = (lrq*) SRQ_ABS_PTR(graph.nodes[i].request);
+		const FB_SIZE_T firstEdge = graph.edges.getCount();
 
-	// Remember that this request is part of the wait-for graph
+		owners.clear();
+		deadlock_blockers(request, &graph.maybeDeadlock, owners);
 
-	request->lrq_flags |= LRQ_deadlock;
+		for (const auto owner_offset : owners)
+		{
+			const own* const owner = (own*) SRQ_ABS_PTR(owner_offset);
 
-	// Check if this is a conversion request
+			const srq* lock_srq;
+			SRQ_LOOP(owner->own_pending, lock_srq)
+			{
+				const lrq* const target = (lrq*) ((UCHAR*) lock_srq - offsetof(lrq, lrq_own_pending));
+				fb_assert(target->lrq_flags & LRQ_pending);
 
-	const bool conversion = (request->lrq_state > LCK_null);
+				// hvlad: don't pursue requests that are waiting with a timeout
+				// as such a circle in the wait-for graph will be broken automatically
+				// when the permitted timeout expires
 
-	// Find the parent lock of the request
+				if (target->lrq_flags & LRQ_wait_timeout)
+					continue;
 
-	lbl* lock = (lbl*) SRQ_ABS_PTR(request->lrq_lock);
+				graph.edges.add(graph.addNode(SRQ_REL_PTR(target)));
+			}
+		}
 
-	// Loop thru the requests granted against the lock.  If any granted request is
-	// blocking the request we're handling, recurse to find what's blocking him.
+		graph.nodes[i].firstEdge = firstEdge;
+		graph.nodes[i].edgeCount = graph.edges.getCount() - firstEdge;
+	}
+}
 
-	srq* lock_srq;
-	SRQ_LOOP(lock->lbl_requests, lock_srq)
+
+lrq* LockManager::deadlock_validate(const WaitGraph& graph, const WaitCycle& cycle)
+{
+/**************************************
+ *
+ *	d e a d l o c k _ v a l i d a t e
+ *
+ **************************************
+ *
+ * Functional description
+ *	Check that the cycle found in the snapshot of the wait-for
+ *	graph still exists.  Return the request to be rejected or
+ *	null if the cycle was broken meanwhile.
+ *
+ **************************************/
+	ASSERT_ACQUIRED;
+
+	HalfStaticArray<SRQ_PTR, 16> owners;
+
+	for (FB_SIZE_T i = 0; i < cycle.getCount(); i++)
 	{
-		lrq* block = (lrq*) ((UCHAR*) lock_srq - offsetof(lrq, lrq_lbl_requests));
+		const lrq* const request = (lrq*) SRQ_ABS_PTR(graph.nodes[cycle[i]].request);
+		const FB_SIZE_T next = cycle[(i + 1) % cycle.getCount()];
+		const lrq* const target = (lrq*) SRQ_ABS_PTR(graph.nodes[next].request);
 
-		if (conversion)
+		if (request->lrq_type != type_lrq || !(request->lrq_flags & LRQ_pending) ||
+			target->lrq_type != type_lrq || !(target->lrq_flags & LRQ_pending) ||
+			(target->lrq_flags & LRQ_wait_timeout))
 		{
-			// Don't pursue our own lock-request again
+			return NULL;
+		}
 
-			if (request == block)
-				continue;
+		bool maybe_deadlock = false;
+		owners.clear();
+		deadlock_blockers(request, &maybe_deadlock, owners);
 
-			// Since lock conversions can't follow the fairness rules (to avoid
-			// deadlocks), only granted lock requests need to be examined.
-			// If lock-ordering is turned off (opening the door for starvation),
-			// only granted requests can block our request.
+		if (!owners.exist(target->lrq_owner))
+			return NULL;
 
-			if (compatibility[request->lrq_requested][block->lrq_state])
-				continue;
-		}
-		else
-		{
-			// Don't pursue our own lock-request again.  In addition, don't look
-			// at requests that arrived after our request because lock-ordering
-			// is in effect.
+#ifdef DEBUG_TRACE_DEADLOCKS
+		const own* const owner = (own*) SRQ_ABS_PTR(request->lrq_owner);
+		const prc* const proc = (prc*) SRQ_ABS_PTR(owner->own_process);
+		gds__log("deadlock chain: OWNER BLOCK %6" SLONGFORMAT"\tProcess id: %6d\tFlags: 0x%02X ",
+			request->lrq_owner, proc->prc_process_id, owner->own_flags);
+#endif
+	}
 
-			if (request == block)
-				break;
+	return (lrq*) SRQ_ABS_PTR(graph.nodes[cycle[0]].request);
+}
 
-			// Since lock ordering is in effect, granted locks and waiting
-			// requests that arrived before our request could block us
 
-			const UCHAR max_state = MAX(block->lrq_state, block->lrq_requested);
+FB_SIZE_T LockManager::WaitGraph::addNode(SRQ_PTR request)
+{
+	FB_SIZE_T* const pos = index.get(request);
+	if (pos)
+		return *pos;
 
-			if (compatibility[request->lrq_requested][max_state])
-			{
-				continue;
-			}
-		}
+	const FB_SIZE_T node = nodes.getCount();
 
-		// Don't pursue lock owners that still have to finish processing their AST.
-		// If the blocking queue is not empty, then the owner still has some
-		// AST's to process (or lock reposts).
-		// hvlad: also lock maybe just granted to owner and blocked owners have no
-		// time to send blocking AST
-		// Remember this fact because they still might be part of a deadlock.
+	WaitNode& item = nodes.add();
+	item.request = request;
+
+	index.put(request, node);
+	return node;
+}
 
-		own* const owner = (own*) SRQ_ABS_PTR(block->lrq_owner);
 
-		if ((owner->own_flags & (OWN_signaled | OWN_wakeup)) || !SRQ_EMPTY((owner->own_blocks)) ||
-			(block->lrq_flags & LRQ_just_granted))
+bool LockManager::WaitGraph::findCycle(WaitCycle& cycle) const
+{
+/**************************************
+ *
+ * Walk the graph depth first starting from the first node. If a node
+ * still being walked is met again, the nodes on the path from it form
+ * a cycle, the first of them is the request to be rejected.
+ *
+ **************************************/
+	const UCHAR NODE_UNSEEN = 0;
+	const UCHAR NODE_ON_PATH = 1;
+	const UCHAR NODE_DONE = 2;
+
+	HalfStaticArray<UCHAR, 64> state;
+	state.grow(nodes.getCount());	// zero filled, i.e. NODE_UNSEEN
+
+	// Stack of the nodes on the current path with the next edge to follow
+
+	HalfStaticArray<WaitNode, 64> path;
+
+	WaitNode& root = path.add();
+	root.request = 0;
+	root.firstEdge = nodes[0].firstEdge;
+	root.edgeCount = nodes[0].edgeCount;
+	state[0] = NODE_ON_PATH;
+
+	// Here WaitNode::request keeps the node index
+
+	while (path.hasData())
+	{
+		WaitNode& top = path.back();
+
+		if (!top.edgeCount)
 		{
-			*maybe_deadlock = true;
+			state[top.request] = NODE_DONE;
+			path.pop();
 			continue;
 		}
 
-		// YYY: Note: can the below code be moved to the
-		// start of this block?  Before the OWN_signaled check?
+		const FB_SIZE_T next = edges[top.firstEdge++];
+		top.edgeCount--;
+
+		if (state[next] == NODE_DONE)
+			continue;
 
-		srq* lock_srq2;
-		SRQ_LOOP(owner->own_pending, lock_srq2)
+		if (state[next] == NODE_ON_PATH)
 		{
-			lrq* target = (lrq*) ((UCHAR*) lock_srq2 - offsetof(lrq, lrq_own_pending));
-			fb_assert(target->lrq_flags & LRQ_pending);
+			FB_SIZE_T start = 0;
+			while (path[start].request != (SRQ_PTR) next)
+				start++;
 
-			// hvlad: don't pursue requests that are waiting with a timeout
-			// as such a circle in the wait-for graph will be broken automatically
-			// when the permitted timeout expires
+			cycle.clear();
+			for (FB_SIZE_T i = start; i < path.getCount(); i++)
+				cycle.add(path[i].request);
 
-			if (target->lrq_flags & LRQ_wait_timeout) {
-				continue;
-			}
+			return true;
+		}
 
-			// Check who is blocking the request whose owner is blocking the input request
+		state[next] = NODE_ON_PATH;
 
-			if (target = deadlock_walk(target, maybe_deadlock))
-			{
-#ifdef DEBUG_TRACE_DEADLOCKS
-				const own* const owner2 = (own*) SRQ_ABS_PTR(request->lrq_owner);
-				const prc* const proc = (prc*) SRQ_ABS_PTR(owner2->own_process);
-				gds__log("deadlock chain: OWNER BLOCK %6" SLONGFORMAT"\tProcess id: %6d\tFlags: 0x%02X ",
-					request->lrq_owner, proc->prc_process_id, owner2->own_flags);
-#endif
-				return target;
-			}
-		}
+		WaitNode& item = path.add();
+		item.request = next;
+		item.firstEdge = nodes[next].firstEdge;
+		item.edgeCount = nodes[next].edgeCount;
 	}
 
-	// This branch of the wait-for graph is exhausted, the current waiting
-	// request is not part of a deadlock
-
-	request->lrq_flags &= ~LRQ_deadlock;
-	request->lrq_flags |= LRQ_scanned;
-	return NULL;
+	return false;
 }
 
 
@@ -3653,17 +3785,14 @@ void LockManager::validate_request(const SRQ_PTR lrq_ptr, USHORT freed, USHORT r
 
 	// Check that no invalid flag bit is set
 	CHECK(!(request->lrq_flags &
-		   		~(LRQ_blocking | LRQ_pending | LRQ_rejected | LRQ_deadlock | LRQ_repost |
-					 LRQ_scanned | LRQ_blocking_seen | LRQ_just_granted | LRQ_wait_timeout)));
+		   		~(LRQ_blocking | LRQ_pending | LRQ_rejected | LRQ_repost |
+					 LRQ_blocking_seen | LRQ_just_granted | LRQ_wait_timeout)));
 
 	// Once a request is rejected, it CAN'T be pending any longer
 	if (request->lrq_flags & LRQ_rejected) {
 		CHECK(!(request->lrq_flags & LRQ_pending));
 	}
 
-	// Can't both be scanned & marked for deadlock walk
-	CHECK((request->lrq_flags & (LRQ_deadlock | LRQ_scanned)) != (LRQ_deadlock | LRQ_scanned));
-
 	CHECK(request->lrq_requested < LCK_max);
 	CHECK(request->lrq_state < LCK_max);
 
@@ -3926,10 +4055,23 @@ void LockManager::wait_for_request(thread_db* tdbb, lrq* request, SSHORT lck_wai
 		// If we've not previously been scanned for a deadlock and going to wait
 		// forever, go do a deadlock scan
 
-		lrq* blocking_request;
+		lrq* blocking_request = NULL;
 		if (!(owner->own_flags & OWN_scanned) &&
-			!(request->lrq_flags & LRQ_wait_timeout) &&
-			(blocking_request = deadlock_scan(owner, request)))
+			!(request->lrq_flags & LRQ_wait_timeout))
+		{
+			// The scan releases the lock table for a while
+
+			blocking_request = deadlock_scan(owner_offset, request_offset);
+
+			owner = (own*) SRQ_ABS_PTR(owner_offset);
+			request = (lrq*) SRQ_ABS_PTR(request_offset);
+			lock = (lbl*) SRQ_ABS_PTR(lock_offset);
+
+			if (!(request->lrq_flags & LRQ_pending))
+				break;
+		}
+
+		if (blocking_request)
 		{
 			// Something has been selected for rejection to prevent a
 			// deadlock. Clean things up and go on. We still have to
@@ -93,7 +93,7 @@ const UCHAR type_lpr	= 7;
 
 // Version number of the lock table.
 // Must be increased every time the shmem layout is changed.
-const USHORT BASE_LHB_VERSION = 19;
+const USHORT BASE_LHB_VERSION = 20;
 const USHORT PLATFORM_LHB_VERSION = 128;	// 64-bit target
 
 #if SIZEOF_VOID_P == 8
@@ -200,9 +200,7 @@ struct lrq
 const USHORT LRQ_blocking		= 1;		// Request is blocking
 const USHORT LRQ_pending		= 2;		// Request is pending
 const USHORT LRQ_rejected		= 4;		// Request is rejected
-const USHORT LRQ_deadlock		= 8;		// Request has been seen by the deadlock-walk
 const USHORT LRQ_repost			= 16;		// Request block used for repost
-const USHORT LRQ_scanned		= 32;		// Request already scanned for deadlock
 const USHORT LRQ_blocking_seen	= 64;		// Blocking notification received by owner
 const USHORT LRQ_just_granted	= 128;		// Request is just granted and blocked owners still have not sent blocking AST
 const USHORT LRQ_wait_timeout	= 256;		// Request is being waited on with a timeout
@@ -388,6 +386,34 @@ class LockManager final : public Firebird::GlobalStorage, public Firebird::IpcOb
 	};
 #undef FB_LOCKED_FROM
 
+	// Part of the wait-for graph reachable from a waiting request. It's copied
+	// out of the lock table to search for a cycle without holding the table.
+
+	struct WaitNode
+	{
+		SRQ_PTR request;		// pending request
+		FB_SIZE_T firstEdge;	// position of its first blocker in the edge list
+		FB_SIZE_T edgeCount;	// number of pending requests blocking it
+	};
+
+	typedef Firebird::HalfStaticArray<FB_SIZE_T, 16> WaitCycle;
+
+	class WaitGraph
+	{
+	public:
+		explicit WaitGraph(Firebird::MemoryPool& pool)
+			: nodes(pool), edges(pool), index(pool), maybeDeadlock(false)
+		{}
+
+		FB_SIZE_T addNode(SRQ_PTR request);
+		bool findCycle(WaitCycle& cycle) const;
+
+		Firebird::HalfStaticArray<WaitNode, 64> nodes;
+		Firebird::HalfStaticArray<FB_SIZE_T, 64> edges;		// indices of the blocking nodes
+		Firebird::NonPooledMap<SRQ_PTR, FB_SIZE_T> index;	// request to node index
+		bool maybeDeadlock;		// some blocking owner is still processing its ASTs
+	};
+
 	const int PID;
 
 public:
@@ -423,9 +449,10 @@ private:
 	void bug_assert(const TEXT*, ULONG);
 	SRQ_PTR create_owner(Firebird::CheckStatusWrapper*, LOCK_OWNER_T, UCHAR);
 	bool create_process(Firebird::CheckStatusWrapper*);
-	void deadlock_clear();
-	lrq* deadlock_scan(own*, lrq*);
-	lrq* deadlock_walk(lrq*, bool*);
+	void deadlock_blockers(const lrq*, bool*, Firebird::HalfStaticArray<SRQ_PTR, 16>&);
+	lrq* deadlock_scan(SRQ_PTR, SRQ_PTR);
+	void deadlock_snapshot(SRQ_PTR, WaitGraph&);
+	lrq* deadlock_validate(const WaitGraph&, const WaitCycle&);
 	void debug_delay(ULONG);
 	lbl* find_lock(USHORT, const UCHAR*, USHORT, USHORT*);
 	lrq* get_request(SRQ_PTR);